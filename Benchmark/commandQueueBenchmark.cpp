@@ -0,0 +1,179 @@
+#include "microBenchmarks.h"
+
+#include "timer.h"
+#include "ringBuffer.h"
+#include "renderCommandQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+// Small enough that the rings wrap many times per iteration and producers regularly find them full
+static constexpr uint32_t RING_CAPACITY = 4096;
+
+// Runs producerCount threads that push elementCount commands in total while the calling thread pops them. The
+// producers are started before the timer and released together, so thread creation isn't measured.
+// push(producer, index) pushes the command for index and returns false when the ring is full, pop() returns the
+// popped command's target or UINT32_MAX when the ring is empty.
+static MicroBenchmarkResult RunVariant(const std::string& name, uint32_t producerCount, uint32_t elementCount, uint32_t warmupIterations, uint32_t iterations,
+	const std::function<bool(uint32_t)>& push, const std::function<uint32_t()>& pop)
+{
+	MicroBenchmarkResult result{ name, {}, elementCount };
+	result.m_samples.reserve(iterations);
+
+	Timer timer;
+	for (uint32_t iteration = 0; iteration < warmupIterations + iterations; iteration++)
+	{
+		std::atomic<bool> isReleased = false;
+
+		std::vector<std::thread> producers;
+		for (uint32_t producer = 0; producer < producerCount; producer++)
+		{
+			producers.emplace_back([&, producer]()
+				{
+					while (!isReleased.load(std::memory_order_acquire))
+					{
+						std::this_thread::yield();
+					}
+
+					// Interleaved ranges, every producer pushes every producerCount-th index
+					for (uint32_t i = producer; i < elementCount; i += producerCount)
+					{
+						while (!push(i))
+						{
+							std::this_thread::yield();
+						}
+					}
+				});
+		}
+
+		timer.GetDeltaTime(Unit::MILLI);
+		isReleased.store(true, std::memory_order_release);
+
+		uint64_t checksum = 0;
+		for (uint32_t received = 0; received < elementCount;)
+		{
+			const uint32_t target = pop();
+			if (target == UINT32_MAX)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			checksum += target;
+			received++;
+		}
+		const float time = timer.GetDeltaTime(Unit::MILLI);
+
+		for (std::thread& producer : producers)
+		{
+			producer.join();
+		}
+
+		// Every index exactly once, lost or duplicated commands change the sum
+		const uint64_t expectedChecksum = static_cast<uint64_t>(elementCount) * (elementCount - 1) / 2;
+		if (checksum != expectedChecksum)
+		{
+			throw std::runtime_error("Variant " + name + " lost or duplicated commands");
+		}
+
+		if (iteration >= warmupIterations)
+		{
+			result.m_samples.push_back(time);
+		}
+	}
+
+	return result;
+}
+
+std::vector<MicroBenchmarkResult> RunCommandQueueBenchmark(uint32_t elementCount, uint32_t warmupIterations, uint32_t iterations)
+{
+	// hardware_concurrency may return 0, at least one producer either way
+	const uint32_t producerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+	RenderCommand transformCommand{};
+	transformCommand.m_type = RenderCommandType::UPDATE_TRANSFORM;
+	RenderCommand::EncodeModel(glm::mat4(1.f), transformCommand.m_transform.m_model);
+
+	std::vector<MicroBenchmarkResult> results;
+
+	{
+		SpscRingBuffer<RenderCommand> ring(RING_CAPACITY);
+		results.push_back(RunVariant("spsc", 1, elementCount, warmupIterations, iterations,
+			[&](uint32_t index)
+			{
+				RenderCommand command = transformCommand;
+				command.m_target = index;
+				return ring.TryPush(command);
+			},
+			[&]()
+			{
+				RenderCommand command;
+				return ring.TryPop(command) ? command.m_target : UINT32_MAX;
+			}));
+	}
+
+	{
+		MpscRingBuffer<RenderCommand> ring(RING_CAPACITY);
+		results.push_back(RunVariant("mpsc_1", 1, elementCount, warmupIterations, iterations,
+			[&](uint32_t index)
+			{
+				RenderCommand command = transformCommand;
+				command.m_target = index;
+				return ring.TryPush(command);
+			},
+			[&]()
+			{
+				RenderCommand command;
+				return ring.TryPop(command) ? command.m_target : UINT32_MAX;
+			}));
+	}
+
+	{
+		// The full path gameplay code takes, including encoding the matrix. Consume pops everything that's there,
+		// pops are counted through a running checksum instead.
+		RenderCommandQueue queue(RING_CAPACITY, 1, 0, 0);
+		const glm::mat4 model = glm::mat4(1.f);
+
+		// The queue only accepts ids it handed out, the spawns are drained before anything is measured
+		for (RenderableId renderable = INVALID_RENDERABLE; renderable == INVALID_RENDERABLE || renderable + 1 < elementCount; )
+		{
+			renderable = queue.SpawnRenderable(0, model);
+			if (renderable == INVALID_RENDERABLE)
+			{
+				queue.Consume([](const RenderCommand&) {});
+			}
+		}
+		queue.Consume([](const RenderCommand&) {});
+
+		std::vector<uint32_t> popped;
+		popped.reserve(RING_CAPACITY);
+		size_t nextPopped = 0;
+
+		results.push_back(RunVariant("queue_" + std::to_string(producerCount), producerCount, elementCount, warmupIterations, iterations,
+			[&](uint32_t index)
+			{
+				return queue.UpdateTransform(index, model);
+			},
+			[&]()
+			{
+				if (nextPopped == popped.size())
+				{
+					popped.clear();
+					nextPopped = 0;
+					queue.Consume([&](const RenderCommand& command) { popped.push_back(command.m_target); });
+
+					if (popped.empty())
+					{
+						return UINT32_MAX;
+					}
+				}
+
+				return popped[nextPopped++];
+			}));
+	}
+
+	return results;
+}
@@ -0,0 +1,164 @@
+#include "microBenchmarks.h"
+
+#include "timer.h"
+#include "transform.h"
+#include "transformSystem.h"
+#include "jobSystem.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <array>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+// Ranges are small enough to keep every thread busy with few transforms, but cost far more than scheduling them
+static constexpr uint32_t MIN_SPHERES_PER_JOB = 1024;
+
+// Roots with children, children of a root are one level deeper so they're updated after all roots
+static void CreateHierarchy(entt::registry& registry, TransformSystem& transformSystem, uint32_t elementCount, std::vector<entt::entity>& roots)
+{
+	constexpr uint32_t CHILDREN_PER_ROOT = 3;
+
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> positionDistribution(-100.f, 100.f);
+
+	entt::entity root = entt::null;
+	for (uint32_t i = 0; i < elementCount; i++)
+	{
+		const entt::entity entity = registry.create();
+		registry.emplace<Transform>(entity, glm::vec3(positionDistribution(random), 0.f, positionDistribution(random)), glm::vec3(1.f), glm::identity<glm::quat>());
+
+		if (i % (CHILDREN_PER_ROOT + 1) == 0)
+		{
+			root = entity;
+			roots.push_back(root);
+			transformSystem.SetParent(entity, entt::null);
+		}
+		else
+		{
+			transformSystem.SetParent(entity, root);
+		}
+	}
+}
+
+// Planes point inwards, a sphere is visible unless it's completely behind one of them
+static std::array<glm::vec4, 6> ExtractFrustumPlanes(const glm::mat4& viewProjection)
+{
+	const glm::mat4 rows = glm::transpose(viewProjection);
+
+	std::array<glm::vec4, 6> planes =
+	{
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[2], rows[3] - rows[2],
+	};
+
+	for (glm::vec4& plane : planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return planes;
+}
+
+std::vector<MicroBenchmarkResult> RunJobScalingBenchmark(uint32_t elementCount, uint32_t warmupIterations, uint32_t iterations)
+{
+	const uint32_t maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	const glm::mat4 projection = glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 1000.f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.f, 50.f, -150.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+	const std::array<glm::vec4, 6> planes = ExtractFrustumPlanes(projection * view);
+
+	std::vector<MicroBenchmarkResult> results;
+	uint32_t referenceVisibleCount = UINT32_MAX;
+
+	for (uint32_t threadCount = 1; threadCount <= maxThreadCount; threadCount++)
+	{
+		JobSystem jobSystem(threadCount - 1);
+
+		entt::registry registry;
+		TransformSystem transformSystem(registry);
+		std::vector<entt::entity> roots;
+		CreateHierarchy(registry, transformSystem, elementCount, roots);
+
+		// Culling reads the transforms' world matrices in entity order, like extraction does
+		std::vector<Transform*> transforms;
+		transforms.reserve(elementCount);
+		std::vector<uint8_t> visibility(elementCount);
+
+		MicroBenchmarkResult transformResult{ "transforms_" + std::to_string(threadCount), {} };
+		MicroBenchmarkResult cullingResult{ "culling_" + std::to_string(threadCount), {} };
+		transformResult.m_samples.reserve(iterations);
+		cullingResult.m_samples.reserve(iterations);
+
+		const glm::quat step = glm::angleAxis(0.01f, glm::vec3(0.f, 1.f, 0.f));
+
+		Timer timer;
+		for (uint32_t iteration = 0; iteration < warmupIterations + iterations; iteration++)
+		{
+			// Rotating the roots moves every child too, the whole hierarchy is recomputed
+			for (entt::entity root : roots)
+			{
+				Transform& transform = registry.get<Transform>(root);
+				transform.SetRotation(step * transform.GetRotation());
+			}
+
+			timer.GetDeltaTime(Unit::MILLI);
+			transformSystem.Update(jobSystem);
+			const float transformTime = timer.GetDeltaTime(Unit::MILLI);
+
+			// The hierarchy sort in the first update reorders the storage, the pointers are taken after it
+			if (transforms.empty())
+			{
+				for (auto [entity, transform] : registry.view<Transform>().each())
+				{
+					transforms.push_back(&transform);
+				}
+			}
+
+			timer.GetDeltaTime(Unit::MILLI);
+			jobSystem.ParallelFor(elementCount, MIN_SPHERES_PER_JOB, [&](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t i = begin; i < end; i++)
+					{
+						const glm::vec4 center = transforms[i]->World()[3];
+						const float radius = 1.f;
+
+						bool isVisible = true;
+						for (const glm::vec4& plane : planes)
+						{
+							isVisible &= glm::dot(glm::vec3(plane), glm::vec3(center)) + plane.w > -radius;
+						}
+
+						visibility[i] = isVisible ? 1 : 0;
+					}
+				});
+			const float cullingTime = timer.GetDeltaTime(Unit::MILLI);
+
+			if (iteration >= warmupIterations)
+			{
+				transformResult.m_samples.push_back(transformTime);
+				cullingResult.m_samples.push_back(cullingTime);
+			}
+		}
+
+		// Every thread count works on the same scene, they all have to agree on what's visible
+		uint32_t visibleCount = 0;
+		for (uint8_t isVisible : visibility)
+		{
+			visibleCount += isVisible;
+		}
+
+		if (referenceVisibleCount != UINT32_MAX && visibleCount != referenceVisibleCount)
+		{
+			throw std::runtime_error("Culling with " + std::to_string(threadCount) + " threads found a different number of visible entities");
+		}
+		referenceVisibleCount = visibleCount;
+
+		results.push_back(std::move(transformResult));
+		results.push_back(std::move(cullingResult));
+	}
+
+	return results;
+}
@@ -0,0 +1,407 @@
+#include "engine.h"
+#include "vkDevice.h"
+#include "vkRender.h"
+
+#include "timer.h"
+#include "transform.h"
+#include "renderComponents.h"
+
+#include "fileIO.h"
+
+#include "microBenchmarks.h"
+
+#include <filesystem>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// Headless frame benchmark: renders a scripted camera path and reports frame time percentiles as JSON.
+// --micro runs a micro benchmark instead, without rendering frames. It reuses --frames and --warmup as iteration counts
+// and --objects as the number of elements.
+// Usage: Benchmark [--frames N] [--warmup N] [--objects N] [--micro transforms|jobs|commands|uploads] [--output file.json] [--working-dir path]
+
+struct BenchmarkSettings
+{
+	uint32_t m_frameCount = 1000;
+	uint32_t m_warmupFrames = 100;
+	uint32_t m_objectCount = 1;
+	std::string m_microBenchmark;
+	std::string m_outputPath;
+	std::string m_workingDirectory;
+};
+
+struct Percentiles
+{
+	float m_min = 0.f;
+	float m_avg = 0.f;
+	float m_p50 = 0.f;
+	float m_p95 = 0.f;
+	float m_p99 = 0.f;
+	float m_max = 0.f;
+};
+
+static void SetWorkingDirectory(const std::string& overridePath)
+{
+	if (!overridePath.empty())
+	{
+		std::filesystem::current_path(overridePath);
+		return;
+	}
+
+	// Vulkan\Benchmark\$(platform)\$(config)\benchmark.exe
+	std::filesystem::path executablePath = GetExecutablePath();
+
+	// Vulkan\Benchmark, engine assets are referenced relative to it ("../Engine/...")
+	auto benchmarkFolderPath = executablePath.parent_path().parent_path().parent_path();
+
+	std::filesystem::current_path(benchmarkFolderPath);
+}
+
+static bool ParseArguments(int argc, char** argv, BenchmarkSettings& settings)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (argument == "--frames" && hasValue)
+		{
+			settings.m_frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (argument == "--warmup" && hasValue)
+		{
+			settings.m_warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (argument == "--objects" && hasValue)
+		{
+			settings.m_objectCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (argument == "--micro" && hasValue)
+		{
+			settings.m_microBenchmark = argv[++i];
+		}
+		else if (argument == "--output" && hasValue)
+		{
+			settings.m_outputPath = argv[++i];
+		}
+		else if (argument == "--working-dir" && hasValue)
+		{
+			settings.m_workingDirectory = argv[++i];
+		}
+		else
+		{
+			std::cerr << "Unknown argument: " << argument << "\n";
+			std::cerr << "Usage: Benchmark [--frames N] [--warmup N] [--objects N] [--micro transforms|jobs|commands|uploads] [--output file.json] [--working-dir path]" << std::endl;
+			return false;
+		}
+	}
+
+	return settings.m_frameCount > 0;
+}
+
+// Nearest rank percentile, samples have to be sorted
+static float Percentile(const std::vector<float>& sortedSamples, float percentile)
+{
+	const size_t rank = static_cast<size_t>(std::ceil(percentile / 100.f * static_cast<float>(sortedSamples.size())));
+	const size_t index = std::clamp<size_t>(rank, 1, sortedSamples.size()) - 1;
+
+	return sortedSamples[index];
+}
+
+static Percentiles ComputePercentiles(std::vector<float> samples)
+{
+	Percentiles result{};
+	if (samples.empty())
+	{
+		return result;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	result.m_min = samples.front();
+	result.m_max = samples.back();
+	result.m_avg = static_cast<float>(std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size()));
+	result.m_p50 = Percentile(samples, 50.f);
+	result.m_p95 = Percentile(samples, 95.f);
+	result.m_p99 = Percentile(samples, 99.f);
+
+	return result;
+}
+
+static void WritePercentiles(std::ostream& stream, const char* name, const Percentiles& percentiles, bool last = false)
+{
+	stream << "\t\t\"" << name << "\": { "
+		<< "\"min\": " << percentiles.m_min << ", "
+		<< "\"avg\": " << percentiles.m_avg << ", "
+		<< "\"p50\": " << percentiles.m_p50 << ", "
+		<< "\"p95\": " << percentiles.m_p95 << ", "
+		<< "\"p99\": " << percentiles.m_p99 << ", "
+		<< "\"max\": " << percentiles.m_max << " }"
+		<< (last ? "\n" : ",\n");
+}
+
+static bool WriteOutput(const BenchmarkSettings& settings, const std::string& json)
+{
+	if (settings.m_outputPath.empty())
+	{
+		std::cout << json;
+		return true;
+	}
+
+	std::ofstream file(settings.m_outputPath);
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to open " << settings.m_outputPath << std::endl;
+		return false;
+	}
+
+	file << json;
+	return true;
+}
+
+static int RunMicroBenchmark(const BenchmarkSettings& settings)
+{
+	std::vector<MicroBenchmarkResult> results;
+
+	try
+	{
+		if (settings.m_microBenchmark == "transforms")
+		{
+			results = RunTransformBenchmark(settings.m_objectCount, settings.m_warmupFrames, settings.m_frameCount);
+		}
+		else if (settings.m_microBenchmark == "jobs")
+		{
+			results = RunJobScalingBenchmark(settings.m_objectCount, settings.m_warmupFrames, settings.m_frameCount);
+		}
+		else if (settings.m_microBenchmark == "commands")
+		{
+			results = RunCommandQueueBenchmark(settings.m_objectCount, settings.m_warmupFrames, settings.m_frameCount);
+		}
+		else if (settings.m_microBenchmark == "uploads")
+		{
+			// The renderer loads its assets during initialization, relative to the working directory
+			SetWorkingDirectory(settings.m_workingDirectory);
+			Core::engine.Initialize(true);
+
+			try
+			{
+				results = RunUploadBenchmark(settings.m_objectCount, settings.m_warmupFrames, settings.m_frameCount);
+			}
+			catch (...)
+			{
+				Core::engine.ShutDown();
+				throw;
+			}
+
+			Core::engine.ShutDown();
+		}
+		else
+		{
+			std::cerr << "Unknown micro benchmark: " << settings.m_microBenchmark << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "\t\"micro\": \"" << settings.m_microBenchmark << "\",\n";
+	json << "\t\"iterations\": " << settings.m_frameCount << ",\n";
+	json << "\t\"warmupIterations\": " << settings.m_warmupFrames << ",\n";
+	json << "\t\"elements\": " << settings.m_objectCount << ",\n";
+	json << "\t\"unit\": \"ms\",\n";
+	json << "\t\"results\": {\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		WritePercentiles(json, results[i].m_name.c_str(), ComputePercentiles(results[i].m_samples), i + 1 == results.size());
+	}
+
+	// Items per second over the average iteration
+	std::vector<std::pair<std::string, double>> throughputs;
+	for (const MicroBenchmarkResult& result : results)
+	{
+		const float averageTime = ComputePercentiles(result.m_samples).m_avg;
+		if (result.m_itemsPerIteration > 0 && averageTime > 0.f)
+		{
+			throughputs.emplace_back(result.m_name, static_cast<double>(result.m_itemsPerIteration) * 1000.0 / averageTime);
+		}
+	}
+
+	if (throughputs.empty())
+	{
+		json << "\t}\n";
+	}
+	else
+	{
+		json << "\t},\n";
+		json << "\t\"throughputUnit\": \"items/s\",\n";
+		json << "\t\"throughput\": {\n";
+		for (size_t i = 0; i < throughputs.size(); i++)
+		{
+			json << "\t\t\"" << throughputs[i].first << "\": " << std::fixed << std::setprecision(0) << throughputs[i].second << (i + 1 == throughputs.size() ? "\n" : ",\n");
+		}
+		json << "\t}\n";
+	}
+	json << "}\n";
+
+	return WriteOutput(settings, json.str()) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Copies of the model on a square grid, the first one at the spot a single model is rendered at
+static void CreateScene(entt::registry& registry, uint32_t objectCount)
+{
+	const uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(objectCount))));
+	const float spacing = 2.5f;
+
+	// The model is Z-up, it's rotated to stand upright
+	const glm::quat rotation = glm::angleAxis(glm::radians(90.f), glm::vec3(0.f, 1.f, 0.f)) * glm::angleAxis(glm::radians(90.f), glm::vec3(-1.f, 0.f, 0.f));
+
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		const glm::vec3 offset = glm::vec3(static_cast<float>(i % gridSize), 0.f, static_cast<float>(i / gridSize)) * spacing;
+
+		auto entity = registry.create();
+		registry.emplace<MeshRenderer>(entity);
+		Transform& transform = registry.emplace<Transform>(entity);
+		transform.SetTranslation(glm::vec3(1.f, 2.f, 5.f) + offset);
+		transform.SetRotation(rotation);
+	}
+}
+
+// Deterministic orbit around the model so every run renders the exact same frames
+static void UpdateCameraPath(Transform& cameraTransform, uint32_t frame, uint32_t frameCount)
+{
+	const float t = static_cast<float>(frame) / static_cast<float>(frameCount);
+	const float angle = t * glm::two_pi<float>();
+	const float radius = 2.5f;
+
+	const glm::vec3 position = glm::vec3(std::sin(angle) * radius, 1.f + 0.5f * std::sin(2.f * angle), std::cos(angle) * radius);
+	const glm::vec3 forward = glm::normalize(glm::vec3(0.f, 0.25f, 0.f) - position);
+
+	cameraTransform.SetTranslation(position);
+	cameraTransform.SetRotation(glm::rotation(glm::vec3(0.f, 0.f, 1.f), forward));
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkSettings settings{};
+	if (!ParseArguments(argc, argv, settings))
+	{
+		return EXIT_FAILURE;
+	}
+
+	if (!settings.m_microBenchmark.empty())
+	{
+		return RunMicroBenchmark(settings);
+	}
+
+	std::vector<float> cpuFrameTimes;
+	std::vector<float> recordTimes;
+	std::vector<float> submitTimes;
+	std::vector<float> gpuTimes;
+	bool hasGpuTimes = false;
+	// Draw and state call counts don't change with the camera, the last frame's are reported
+	FrameStatistics lastStatistics{};
+
+	Core::Engine& engine = Core::engine;
+
+	try
+	{
+		SetWorkingDirectory(settings.m_workingDirectory);
+
+		INIT_WRAPPER("engine",
+			{
+				engine.Initialize(true);
+			});
+
+		// Every frame renders from its own camera, otherwise the camera could be a frame ahead depending on timing
+		engine.SetCameraLatching(false);
+
+		auto& registry = engine.GetRegistry();
+		auto entity = registry.create();
+		Camera& camera = registry.emplace<Camera>(entity);
+
+		auto extent = engine.GetDevice().GetExtent();
+		float aspectRatio = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+		camera.projection = glm::perspective(45.f, aspectRatio, 0.1f, 1000.f);
+		camera.projection[1][1] *= -1;
+
+		Transform& cameraTransform = registry.emplace<Transform>(entity);
+
+		CreateScene(registry, settings.m_objectCount);
+
+		const Renderer& renderer = engine.GetRenderer();
+		hasGpuTimes = renderer.SupportsGpuTimestamps();
+
+		cpuFrameTimes.reserve(settings.m_frameCount);
+		recordTimes.reserve(settings.m_frameCount);
+		submitTimes.reserve(settings.m_frameCount);
+		gpuTimes.reserve(settings.m_frameCount);
+
+		const uint32_t totalFrames = settings.m_warmupFrames + settings.m_frameCount;
+
+		Timer deltaTimer;
+		Timer frameTimer;
+		for (uint32_t frame = 0; frame < totalFrames; frame++)
+		{
+			UpdateCameraPath(cameraTransform, frame, totalFrames);
+
+			frameTimer.GetDeltaTime(Unit::MILLI);
+			engine.Update(deltaTimer.GetDeltaTime(Unit::SECONDS));
+			engine.Render();
+			const float frameTime = frameTimer.GetDeltaTime(Unit::MILLI);
+
+			if (frame < settings.m_warmupFrames)
+			{
+				continue;
+			}
+
+			// The render thread finished the previous frame before Render handed this one over, these are its statistics
+			const FrameStatistics statistics = renderer.GetFrameStatistics();
+			cpuFrameTimes.push_back(frameTime);
+			recordTimes.push_back(statistics.m_recordTimeMs);
+			submitTimes.push_back(statistics.m_submitTimeMs);
+			gpuTimes.push_back(statistics.m_gpuTimeMs);
+			lastStatistics = statistics;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	engine.ShutDown();
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "\t\"frames\": " << settings.m_frameCount << ",\n";
+	json << "\t\"warmupFrames\": " << settings.m_warmupFrames << ",\n";
+	json << "\t\"objects\": " << settings.m_objectCount << ",\n";
+	json << "\t\"draws\": " << lastStatistics.m_drawCount << ",\n";
+	json << "\t\"collapsedDraws\": " << lastStatistics.m_collapsedDrawCount << ",\n";
+	json << "\t\"issuedStateCalls\": " << lastStatistics.m_issuedStateCalls << ",\n";
+	json << "\t\"skippedStateCalls\": " << lastStatistics.m_skippedStateCalls << ",\n";
+	json << "\t\"unit\": \"ms\",\n";
+	json << "\t\"gpuTimestamps\": " << (hasGpuTimes ? "true" : "false") << ",\n";
+	json << "\t\"results\": {\n";
+	WritePercentiles(json, "cpuFrame", ComputePercentiles(cpuFrameTimes));
+	WritePercentiles(json, "record", ComputePercentiles(recordTimes));
+	WritePercentiles(json, "submit", ComputePercentiles(submitTimes));
+	WritePercentiles(json, "gpu", ComputePercentiles(gpuTimes), true);
+	json << "\t}\n";
+	json << "}\n";
+
+	return WriteOutput(settings, json.str()) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Timings of one variant of a micro benchmark, one sample per iteration in milliseconds
+struct MicroBenchmarkResult
+{
+	std::string m_name;
+	std::vector<float> m_samples;
+	// Items every iteration processes, throughput is only reported for variants that set it
+	uint64_t m_itemsPerIteration = 0;
+};
+
+// Micro benchmarks run without initializing the engine, unless noted otherwise. They throw when the variants disagree
+// on their results.
+
+// Transform::World against TransformBatch::ComputeWorldMatrices for elementCount transforms whose
+// translation, rotation and scale change every iteration
+std::vector<MicroBenchmarkResult> RunTransformBenchmark(uint32_t elementCount, uint32_t warmupIterations, uint32_t iterations);
+
+// Transform hierarchy updates and frustum culling of elementCount entities on the job system, once per thread count
+// from 1 to hardware_concurrency. Results are named "transforms_<threads>" and "culling_<threads>".
+std::vector<MicroBenchmarkResult> RunJobScalingBenchmark(uint32_t elementCount, uint32_t warmupIterations, uint32_t iterations);
+
+// elementCount transform updates pushed through a ring from producer threads and popped by the calling thread:
+// "spsc" and "mpsc_1" with one producer on the raw rings, "queue_<producers>" through the RenderCommandQueue with
+// hardware_concurrency - 1 producers. Reports commands per second.
+std::vector<MicroBenchmarkResult> RunCommandQueueBenchmark(uint32_t elementCount, uint32_t warmupIterations, uint32_t iterations);
+
+// Needs the engine, initialized headless. elementCount 32-bit values uploaded through an UploadManager with a small
+// staging ring of its own and read back, after a small upload followed by one larger than the ring. Reports bytes
+// per second, throws when the data read back differs.
+std::vector<MicroBenchmarkResult> RunUploadBenchmark(uint32_t elementCount, uint32_t warmupIterations, uint32_t iterations);
@@ -0,0 +1,87 @@
+#include "microBenchmarks.h"
+
+#include "timer.h"
+#include "transform.h"
+#include "transformBatch.h"
+
+#include <random>
+#include <stdexcept>
+
+std::vector<MicroBenchmarkResult> RunTransformBenchmark(uint32_t elementCount, uint32_t warmupIterations, uint32_t iterations)
+{
+	// Fixed seed so every run works on the same transforms
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> translationDistribution(-100.f, 100.f);
+	std::uniform_real_distribution<float> scaleDistribution(0.5f, 2.f);
+	std::uniform_real_distribution<float> unitDistribution(-1.f, 1.f);
+
+	std::vector<Transform> transforms;
+	transforms.reserve(elementCount);
+	TransformBatch batch;
+	batch.Reserve(elementCount);
+
+	for (uint32_t i = 0; i < elementCount; i++)
+	{
+		const glm::vec3 translation(translationDistribution(random), translationDistribution(random), translationDistribution(random));
+		const glm::vec3 scale(scaleDistribution(random), scaleDistribution(random), scaleDistribution(random));
+		const glm::quat rotation = glm::normalize(glm::quat(unitDistribution(random), unitDistribution(random), unitDistribution(random), unitDistribution(random)));
+
+		transforms.emplace_back(translation, scale, rotation);
+		batch.Add(translation, scale, rotation);
+	}
+
+	std::vector<glm::mat4> worldMatrices(elementCount);
+	std::vector<glm::mat4> batchMatrices(elementCount);
+
+	MicroBenchmarkResult worldResult{ "transformWorld", {} };
+	MicroBenchmarkResult batchResult{ "transformBatch", {} };
+	worldResult.m_samples.reserve(iterations);
+	batchResult.m_samples.reserve(iterations);
+
+	// Both variants get the same translations, so neither can skip work the other does
+	const glm::vec3 step(0.001f, 0.f, 0.f);
+
+	Timer timer;
+	for (uint32_t iteration = 0; iteration < warmupIterations + iterations; iteration++)
+	{
+		const bool isWarmup = iteration < warmupIterations;
+
+		// Updating the transforms is part of what a frame does, it's timed for both variants
+		timer.GetDeltaTime(Unit::MILLI);
+		for (uint32_t i = 0; i < elementCount; i++)
+		{
+			Transform& transform = transforms[i];
+			transform.SetTranslation(transform.GetTranslation() + step);
+			worldMatrices[i] = transform.World();
+		}
+		const float worldTime = timer.GetDeltaTime(Unit::MILLI);
+
+		for (uint32_t i = 0; i < elementCount; i++)
+		{
+			batch.SetTranslation(i, batch.GetTranslation(i) + step);
+		}
+		batch.ComputeWorldMatrices(batchMatrices.data());
+		const float batchTime = timer.GetDeltaTime(Unit::MILLI);
+
+		if (!isWarmup)
+		{
+			worldResult.m_samples.push_back(worldTime);
+			batchResult.m_samples.push_back(batchTime);
+		}
+	}
+
+	for (uint32_t i = 0; i < elementCount; i++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			const glm::vec4 difference = glm::abs(worldMatrices[i][column] - batchMatrices[i][column]);
+			// Translations reach ~100, the tolerance is relative to them
+			if (glm::max(glm::max(difference.x, difference.y), glm::max(difference.z, difference.w)) > 1e-3f)
+			{
+				throw std::runtime_error("TransformBatch computed a different world matrix than Transform::World for transform " + std::to_string(i));
+			}
+		}
+	}
+
+	return { worldResult, batchResult };
+}
@@ -0,0 +1,122 @@
+#include "microBenchmarks.h"
+
+#include "engine.h"
+#include "timer.h"
+#include "vkDevice.h"
+#include "vkUploadManager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// Small ring of its own, so the uploads wrap and split into several chunks
+static constexpr VkDeviceSize STAGING_RING_SIZE = 256 * 1024;
+
+// Host visible destination, the uploaded bytes are read back and compared
+struct ReadbackBuffer
+{
+	ReadbackBuffer(const Device& device, VkDeviceSize size) : m_device(device)
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VmaAllocationCreateInfo allocCreateInfo{};
+		allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+		allocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		VmaAllocationInfo allocInfo{};
+		if (vmaCreateBuffer(m_device.GetAllocator(), &bufferInfo, &allocCreateInfo, &m_buffer, &m_allocation, &allocInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate readback buffer");
+		}
+
+		m_pMapped = static_cast<const uint8_t*>(allocInfo.pMappedData);
+	}
+
+	~ReadbackBuffer()
+	{
+		vmaDestroyBuffer(m_device.GetAllocator(), m_buffer, m_allocation);
+	}
+
+	bool Equals(const std::vector<uint32_t>& data) const
+	{
+		vmaInvalidateAllocation(m_device.GetAllocator(), m_allocation, 0, VK_WHOLE_SIZE);
+		return memcmp(m_pMapped, data.data(), data.size() * sizeof(uint32_t)) == 0;
+	}
+
+	const Device& m_device;
+	VkBuffer m_buffer = VK_NULL_HANDLE;
+	VmaAllocation m_allocation = VK_NULL_HANDLE;
+	const uint8_t* m_pMapped = nullptr;
+};
+
+static std::vector<uint32_t> CreatePattern(size_t count, uint32_t seed)
+{
+	std::vector<uint32_t> data(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		data[i] = static_cast<uint32_t>(i) * 2654435761u + seed;
+	}
+
+	return data;
+}
+
+std::vector<MicroBenchmarkResult> RunUploadBenchmark(uint32_t elementCount, uint32_t warmupIterations, uint32_t iterations)
+{
+	const Device& device = Core::engine.GetDevice();
+	UploadManager uploadManager(Core::engine.GetSharedDevice(), STAGING_RING_SIZE);
+
+	// Larger than the ring, split into chunks that each need the whole ring
+	const size_t largeCount = 3 * STAGING_RING_SIZE / sizeof(uint32_t) + 5;
+	const size_t benchmarkCount = std::max<size_t>(elementCount, 1);
+	ReadbackBuffer readback(device, std::max(largeCount, benchmarkCount) * sizeof(uint32_t));
+
+	// A small upload leaves the ring's head off a boundary, the large one after it used to never fit
+	{
+		const std::vector<uint32_t> small = CreatePattern(16, 1);
+		uploadManager.UploadBuffer(readback.m_buffer, small.data(), small.size() * sizeof(uint32_t));
+		uploadManager.Flush();
+		uploadManager.WaitIdle();
+
+		const std::vector<uint32_t> large = CreatePattern(largeCount, 2);
+		uploadManager.UploadBuffer(readback.m_buffer, large.data(), large.size() * sizeof(uint32_t));
+		uploadManager.Flush();
+		uploadManager.WaitIdle();
+
+		if (!readback.Equals(large))
+		{
+			throw std::runtime_error("Upload larger than the staging ring after a small upload arrived corrupted");
+		}
+	}
+
+	const std::vector<uint32_t> data = CreatePattern(benchmarkCount, 3);
+	const VkDeviceSize dataSize = data.size() * sizeof(uint32_t);
+
+	MicroBenchmarkResult result{ "upload", {}, dataSize };
+	result.m_samples.reserve(iterations);
+
+	Timer timer;
+	for (uint32_t iteration = 0; iteration < warmupIterations + iterations; iteration++)
+	{
+		timer.GetDeltaTime(Unit::MILLI);
+		uploadManager.UploadBuffer(readback.m_buffer, data.data(), dataSize);
+		uploadManager.Flush();
+		uploadManager.WaitIdle();
+		const float time = timer.GetDeltaTime(Unit::MILLI);
+
+		if (iteration >= warmupIterations)
+		{
+			result.m_samples.push_back(time);
+		}
+	}
+
+	if (!readback.Equals(data))
+	{
+		throw std::runtime_error("Uploaded data arrived corrupted");
+	}
+
+	return { result };
+}
@@ -13,29 +13,65 @@
 class Device;
 class Renderer;
 class InputHandler;
+class ThreadPool;
+class JobSystem;
+class TransformSystem;
+class SystemScheduler;
+class RenderThread;
+class RenderCommandQueue;
 namespace Core
 {
 	class Input; 
 	class Engine 
 	{
 	public:
-		void Initialize();
+		// Headless skips the window, input and swapchain, frames are rendered into offscreen images instead
+		void Initialize(bool headless = false);
+		// Runs the systems, which extract the frame's snapshot last
 		void Update(float);
+		// Hands the snapshot to the render thread, waits for it to finish the previous frame first
 		void Render();
 		void ShutDown();
 
 		const Device& GetDevice() const;
+		// For objects that share ownership of the device, like an UploadManager of their own
+		std::shared_ptr<Device> GetSharedDevice() const;
 		const Renderer& GetRenderer() const;
 		const Input& GetInput() const;
 		GLFWwindow* GetWindow() const;
 		entt::registry& GetRegistry();
+		ThreadPool& GetThreadPool();
+		JobSystem& GetJobSystem();
+		TransformSystem& GetTransformSystem();
+		// Gameplay systems are added here, they run with the engine's ones in Update. The default phase puts them
+		// after input and before the transform update, whenever they are added.
+		SystemScheduler& GetSystemScheduler();
+		// Renderables owned by the renderer, any thread may push to it without touching GPU resources
+		RenderCommandQueue& GetRenderCommandQueue();
+
+		bool IsHeadless() const;
+
+		// Frames render with the camera of the newest extraction, which can be one frame ahead of their objects.
+		// On by default, with it off every frame renders from its own snapshot and is reproducible.
+		void SetCameraLatching(bool isLatching);
 	private:
+		// The engine's own systems: input, transform hierarchy and render extraction
+		void RegisterSystems();
+
 		std::shared_ptr<Device> m_pDevice = nullptr;
 		std::shared_ptr<Renderer> m_pRenderer = nullptr;
+		std::shared_ptr<RenderThread> m_pRenderThread = nullptr;
 		std::shared_ptr<Input> m_pInput = nullptr;
 		std::shared_ptr<InputHandler> m_pInputHandler = nullptr;
+		std::shared_ptr<ThreadPool> m_pThreadPool = nullptr;
+		std::shared_ptr<JobSystem> m_pJobSystem = nullptr;
+		std::shared_ptr<TransformSystem> m_pTransformSystem = nullptr;
+		std::shared_ptr<SystemScheduler> m_pSystemScheduler = nullptr;
 
 		entt::registry m_registry;
+
+		bool m_isHeadless = false;
+		bool m_isCameraLatching = true;
 	};
 
 	extern Engine engine;
@@ -2,5 +2,13 @@
 
 #include <fstream>
 #include <vector>
+#include <string>
+#include <filesystem>
 
-std::vector<char> ReadFile(const std::string& filename);
\ No newline at end of file
+std::vector<char> ReadFile(const std::string& filename);
+
+// Writes to a temporary file first and renames it, so a crash mid-write never leaves a truncated file behind
+void WriteBinaryFile(const std::string& filename, const void* data, size_t size);
+
+// Absolute path of the running executable
+std::filesystem::path GetExecutablePath();
\ No newline at end of file
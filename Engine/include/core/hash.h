@@ -1,6 +1,9 @@
 #pragma once
 
 #include <bitset>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
 
 // From the Boost library
 template<class T>
@@ -9,3 +12,47 @@ inline void HashCombine(std::size_t& seed, const T& v)
 	std::hash<T> hasher;
 	seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 };
+
+// MurmurHash64A (Austin Appleby, public domain), consumes 8 bytes per step.
+// Used for pipeline keys and to detect corrupted binary blobs (e.g. the on-disk pipeline cache).
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0)
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ull;
+	const int r = 47;
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed ^ (size * m);
+
+	const size_t blockCount = size / 8;
+	for (size_t i = 0; i < blockCount; ++i)
+	{
+		uint64_t k;
+		memcpy(&k, bytes + i * 8, sizeof(k)); // Unaligned safe load
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		hash ^= k;
+		hash *= m;
+	}
+
+	const uint8_t* tail = bytes + blockCount * 8;
+	switch (size & 7)
+	{
+	case 7: hash ^= static_cast<uint64_t>(tail[6]) << 48; [[fallthrough]];
+	case 6: hash ^= static_cast<uint64_t>(tail[5]) << 40; [[fallthrough]];
+	case 5: hash ^= static_cast<uint64_t>(tail[4]) << 32; [[fallthrough]];
+	case 4: hash ^= static_cast<uint64_t>(tail[3]) << 24; [[fallthrough]];
+	case 3: hash ^= static_cast<uint64_t>(tail[2]) << 16; [[fallthrough]];
+	case 2: hash ^= static_cast<uint64_t>(tail[1]) << 8; [[fallthrough]];
+	case 1: hash ^= static_cast<uint64_t>(tail[0]);
+		hash *= m;
+	}
+
+	hash ^= hash >> r;
+	hash *= m;
+	hash ^= hash >> r;
+
+	return hash;
+}
\ No newline at end of file
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// Counts the jobs that were started with it and haven't finished yet. Jobs can be made to wait for a counter with
+// JobSystem::RunAfter, the first exception thrown by one of its jobs is rethrown by JobSystem::Wait.
+// A counter has to outlive its jobs, it can be reused once JobSystem::Wait returned.
+class JobCounter
+{
+public:
+	JobCounter() = default;
+
+	[[nodiscard]] bool IsDone();
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+private:
+	friend class JobSystem;
+
+	// Guards all members, finishing the last job and taking the continuations is one step so a waiter that saw
+	// the counter done can destroy it right away
+	std::mutex m_mutex;
+	uint32_t m_pending = 0;
+	std::vector<std::function<void()>> m_continuations;
+	std::exception_ptr m_exception;
+};
+
+// Work stealing scheduler for frame work that's split into many short jobs (transform updates, culling, recording).
+// Every worker has its own deque: it pushes and pops the jobs it spawns at the back, idle workers steal the oldest
+// jobs from the front of the others' deques, so work spreads without a shared queue all threads contend on.
+// Threads outside the job system (the one that creates it, the render thread) attach to get a deque too, they run
+// jobs while they wait for a counter.
+// Long running work that shouldn't hold up a frame, like pipeline compilation, belongs on the ThreadPool.
+class JobSystem
+{
+public:
+	// Picks hardware_concurrency - 1 workers, leaving a core for the thread that created the job system
+	static constexpr uint32_t DEFAULT_WORKER_COUNT = UINT32_MAX;
+
+	// 0 workers is valid, every job then runs on the attached threads while they wait. attachedThreadCount is the
+	// number of threads that can attach, the creating thread is attached right away.
+	explicit JobSystem(uint32_t workerCount = DEFAULT_WORKER_COUNT, uint32_t attachedThreadCount = 1);
+	~JobSystem();
+
+	// pCounter, if any, counts the job until it finished. Jobs without a counter must not throw.
+	void Run(std::function<void()> job, JobCounter* pCounter = nullptr);
+	// Same as Run, but the job is only queued once every job of dependency finished
+	void RunAfter(JobCounter& dependency, std::function<void()> job, JobCounter* pCounter = nullptr);
+
+	// Gives the calling thread the next free deque, it has to stay attached for the job system's lifetime
+	void AttachThread();
+
+	// Runs queued jobs on the calling thread until the counter's jobs finished, then rethrows their first exception
+	void Wait(JobCounter& counter);
+
+	// Calls function(begin, end) on disjoint ranges covering [0, count), with at most one range per thread and at
+	// least minBatchSize elements per range, and returns once all of them ran
+	template<typename F>
+	void ParallelFor(uint32_t count, uint32_t minBatchSize, F&& function);
+
+	uint32_t GetWorkerCount() const;
+	// Workers and attached threads, every one of them can run jobs
+	uint32_t GetThreadCount() const;
+
+	// Index of the calling thread: 0 to GetWorkerCount() - 1 for workers, the attached threads follow in the order
+	// they attached (the creating thread first), UINT32_MAX for any other thread.
+	// Lets jobs use per-thread resources, like command pools.
+	static uint32_t GetThreadIndex();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+private:
+	struct Job
+	{
+		std::function<void()> m_function;
+		JobCounter* m_pCounter = nullptr;
+	};
+
+	struct JobQueue
+	{
+		std::mutex m_mutex;
+		std::deque<Job> m_jobs;
+	};
+
+	void WorkerLoop(uint32_t workerIndex);
+
+	// Pushes onto the calling thread's own deque, threads without one spread their jobs over all deques
+	void Schedule(Job job);
+	// Pops from the calling thread's deque, steals from the others when it's empty
+	bool TryRunJob();
+	void Execute(Job& job);
+	void Finish(JobCounter* pCounter);
+
+	std::vector<std::thread> m_workers;
+	// One per worker, followed by one per attached thread
+	std::vector<std::unique_ptr<JobQueue>> m_queues;
+	std::atomic<uint32_t> m_nextAttachedQueue = 0;
+	std::atomic<uint32_t> m_nextQueue = 0;
+
+	// Jobs in all deques, can briefly drop below 0 since it's only updated after a push
+	std::atomic<int32_t> m_queuedJobs = 0;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_jobAvailable;
+	bool m_isStopping = false;
+};
+
+template<typename F>
+void JobSystem::ParallelFor(uint32_t count, uint32_t minBatchSize, F&& function)
+{
+	const uint32_t jobCount = std::min(count / std::max(minBatchSize, 1u), GetWorkerCount() + 1);
+	if (jobCount < 2)
+	{
+		if (count > 0)
+		{
+			function(0u, count);
+		}
+		return;
+	}
+
+	// Disjoint ranges, the first (count % jobCount) jobs get one element more
+	const uint32_t elementsPerJob = count / jobCount;
+	const uint32_t remainder = count % jobCount;
+
+	const auto getJobBegin = [elementsPerJob, remainder](uint32_t job) { return job * elementsPerJob + std::min(job, remainder); };
+
+	JobCounter counter;
+	for (uint32_t job = 0; job < jobCount - 1; job++)
+	{
+		Run([&function, begin = getJobBegin(job), end = getJobBegin(job + 1)]() { function(begin, end); }, &counter);
+	}
+
+	// The last range runs here instead of idling, the jobs reference function so they have to finish before
+	// this returns or throws
+	std::exception_ptr exception;
+	try
+	{
+		function(getJobBegin(jobCount - 1), count);
+	}
+	catch (...)
+	{
+		exception = std::current_exception();
+	}
+
+	Wait(counter);
+
+	if (exception)
+	{
+		std::rethrow_exception(exception);
+	}
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// Producer and consumer positions live on separate cache lines, otherwise every push invalidates the line the
+// consumer polls and the other way round
+constexpr size_t RING_BUFFER_CACHE_LINE_SIZE = 64;
+
+// Bounded lock-free queue for exactly one producer and one consumer thread. Positions are monotonic and wrap
+// through a power of two capacity, each side caches the other's position and only reloads it when the queue looks
+// full or empty.
+template<typename T>
+class SpscRingBuffer
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Items are copied in and out of the ring");
+
+public:
+	// capacity has to be a power of two
+	explicit SpscRingBuffer(uint32_t capacity);
+
+	// Producer only, returns false when the ring is full
+	bool TryPush(const T& item);
+	// Consumer only, returns false when the ring is empty
+	bool TryPop(T& item);
+
+	uint32_t GetCapacity() const;
+
+	SpscRingBuffer(const SpscRingBuffer&) = delete;
+	SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+private:
+	std::unique_ptr<T[]> m_items;
+	uint32_t m_mask = 0;
+
+	alignas(RING_BUFFER_CACHE_LINE_SIZE) std::atomic<uint32_t> m_tail = 0;
+	uint32_t m_cachedHead = 0;
+
+	alignas(RING_BUFFER_CACHE_LINE_SIZE) std::atomic<uint32_t> m_head = 0;
+	uint32_t m_cachedTail = 0;
+};
+
+// Bounded lock-free queue for any number of producer threads and one consumer thread. Every slot carries a sequence
+// number that tells producers whether it's free and the consumer whether it was written (D. Vyukov's bounded queue),
+// producers claim slots with a compare exchange on the tail. Items of one producer are popped in the order it pushed
+// them.
+template<typename T>
+class MpscRingBuffer
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Items are copied in and out of the ring");
+
+public:
+	// capacity has to be a power of two
+	explicit MpscRingBuffer(uint32_t capacity);
+
+	// Any thread, returns false when the ring is full
+	bool TryPush(const T& item);
+	// Consumer only, returns false when the ring is empty or the next slot is claimed but not written yet
+	bool TryPop(T& item);
+
+	uint32_t GetCapacity() const;
+
+	MpscRingBuffer(const MpscRingBuffer&) = delete;
+	MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+private:
+	// Each slot gets its own cache lines, producers writing neighbouring slots don't invalidate each other's
+	struct alignas(RING_BUFFER_CACHE_LINE_SIZE) Slot
+	{
+		// Equals the position for free slots, position + 1 once the item was written
+		std::atomic<uint32_t> m_sequence;
+		T m_item;
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	uint32_t m_mask = 0;
+
+	alignas(RING_BUFFER_CACHE_LINE_SIZE) std::atomic<uint32_t> m_tail = 0;
+	alignas(RING_BUFFER_CACHE_LINE_SIZE) uint32_t m_head = 0;
+};
+
+template<typename T>
+SpscRingBuffer<T>::SpscRingBuffer(uint32_t capacity) :
+	m_items(std::make_unique<T[]>(capacity)),
+	m_mask(capacity - 1)
+{
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "Ring buffer capacity has to be a power of two");
+}
+
+template<typename T>
+bool SpscRingBuffer<T>::TryPush(const T& item)
+{
+	const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+	if (tail - m_cachedHead > m_mask)
+	{
+		m_cachedHead = m_head.load(std::memory_order_acquire);
+		if (tail - m_cachedHead > m_mask)
+		{
+			return false;
+		}
+	}
+
+	m_items[tail & m_mask] = item;
+	m_tail.store(tail + 1, std::memory_order_release);
+
+	return true;
+}
+
+template<typename T>
+bool SpscRingBuffer<T>::TryPop(T& item)
+{
+	const uint32_t head = m_head.load(std::memory_order_relaxed);
+	if (head == m_cachedTail)
+	{
+		m_cachedTail = m_tail.load(std::memory_order_acquire);
+		if (head == m_cachedTail)
+		{
+			return false;
+		}
+	}
+
+	item = m_items[head & m_mask];
+	m_head.store(head + 1, std::memory_order_release);
+
+	return true;
+}
+
+template<typename T>
+uint32_t SpscRingBuffer<T>::GetCapacity() const
+{
+	return m_mask + 1;
+}
+
+template<typename T>
+MpscRingBuffer<T>::MpscRingBuffer(uint32_t capacity) :
+	m_slots(std::make_unique<Slot[]>(capacity)),
+	m_mask(capacity - 1)
+{
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "Ring buffer capacity has to be a power of two");
+
+	for (uint32_t i = 0; i < capacity; i++)
+	{
+		m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+template<typename T>
+bool MpscRingBuffer<T>::TryPush(const T& item)
+{
+	uint32_t position = m_tail.load(std::memory_order_relaxed);
+	Slot* pSlot = nullptr;
+
+	while (true)
+	{
+		pSlot = &m_slots[position & m_mask];
+		const int32_t difference = static_cast<int32_t>(pSlot->m_sequence.load(std::memory_order_acquire) - position);
+
+		if (difference == 0)
+		{
+			// Free, claim it unless another producer was faster
+			if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// Still holds the item of the previous lap, the consumer hasn't popped it yet
+			return false;
+		}
+		else
+		{
+			position = m_tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	pSlot->m_item = item;
+	pSlot->m_sequence.store(position + 1, std::memory_order_release);
+
+	return true;
+}
+
+template<typename T>
+bool MpscRingBuffer<T>::TryPop(T& item)
+{
+	Slot& slot = m_slots[m_head & m_mask];
+	if (slot.m_sequence.load(std::memory_order_acquire) != m_head + 1)
+	{
+		return false;
+	}
+
+	item = slot.m_item;
+	// Free for the producers' next lap
+	slot.m_sequence.store(m_head + m_mask + 1, std::memory_order_release);
+	m_head++;
+
+	return true;
+}
+
+template<typename T>
+uint32_t MpscRingBuffer<T>::GetCapacity() const
+{
+	return m_mask + 1;
+}
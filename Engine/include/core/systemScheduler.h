@@ -0,0 +1,100 @@
+#pragma once
+
+#pragma warning(push)
+#pragma warning(disable : 4267) // Deprecated declarations
+#include <entt/entity/registry.hpp>
+#pragma warning(pop)
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class JobSystem;
+class JobCounter;
+
+// Component types a system only reads, and ones it writes, passed to SystemScheduler::AddSystem
+template<typename... Components>
+struct Reads {};
+template<typename... Components>
+struct Writes {};
+
+// Coarse order of the frame. Conflicting systems of different phases run in phase order, regardless of the order
+// they were added in.
+enum class SystemPhase : uint8_t
+{
+	INPUT,
+	GAMEPLAY,
+	// World matrices are computed from what the phases before changed
+	TRANSFORMS,
+	// Copies the frame's state for the render thread
+	EXTRACTION
+};
+
+// Runs the registered systems every frame, concurrently where their component accesses allow it.
+// Two systems conflict when one of them writes a component type the other reads or writes, conflicting systems run
+// in phase order and in the order they were added within a phase, all others may overlap on the job system's threads.
+// Adding or removing components counts as writing them, creating or destroying entities as writing entt::entity.
+class SystemScheduler
+{
+public:
+	using System = std::function<void(entt::registry& registry, float deltaTime)>;
+
+	explicit SystemScheduler(entt::registry& registry);
+
+	// Can't be called while the systems run
+	template<typename... ReadComponents, typename... WriteComponents>
+	void AddSystem(const std::string& name, Reads<ReadComponents...>, Writes<WriteComponents...>, System system, SystemPhase phase = SystemPhase::GAMEPLAY);
+
+	// Returns once every system ran, rethrows the first exception a system threw.
+	// Systems after a failed one in the dependency graph don't run.
+	void Run(JobSystem& jobSystem, float deltaTime);
+
+	SystemScheduler(const SystemScheduler&) = delete;
+	SystemScheduler& operator=(const SystemScheduler&) = delete;
+
+private:
+	struct SystemEntry
+	{
+		std::string m_name;
+		System m_function;
+		SystemPhase m_phase = SystemPhase::GAMEPLAY;
+		std::vector<entt::id_type> m_reads;
+		std::vector<entt::id_type> m_writes;
+
+		// Systems that conflict with this one and run after it, and the number of ones this one waits for
+		std::vector<uint32_t> m_dependents;
+		uint32_t m_dependencyCount = 0;
+	};
+
+	void AddSystem(SystemEntry system);
+	static bool Conflicts(const SystemEntry& lhs, const SystemEntry& rhs);
+
+	// Runs the system, then queues the dependents it was the last dependency of
+	void RunSystem(JobSystem& jobSystem, JobCounter& counter, uint32_t index, float deltaTime);
+
+	entt::registry& m_registry;
+
+	std::vector<SystemEntry> m_systems;
+	// Per system, counted down while a frame runs
+	std::unique_ptr<std::atomic<uint32_t>[]> m_remainingDependencies;
+};
+
+template<typename... ReadComponents, typename... WriteComponents>
+void SystemScheduler::AddSystem(const std::string& name, Reads<ReadComponents...>, Writes<WriteComponents...>, System system, SystemPhase phase)
+{
+	// The registry creates storages on first use, which isn't thread safe. Systems only use the ones they declared,
+	// creating them here means they all exist before systems run concurrently.
+	(static_cast<void>(m_registry.storage<ReadComponents>()), ...);
+	(static_cast<void>(m_registry.storage<WriteComponents>()), ...);
+
+	SystemEntry entry{};
+	entry.m_name = name;
+	entry.m_function = std::move(system);
+	entry.m_phase = phase;
+	entry.m_reads = { entt::type_id<ReadComponents>().hash()... };
+	entry.m_writes = { entt::type_id<WriteComponents>().hash()... };
+
+	AddSystem(std::move(entry));
+}
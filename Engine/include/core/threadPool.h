@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+// Fixed set of worker threads consuming a shared FIFO of jobs.
+// Used for long running work that would otherwise stall the main thread, like pipeline compilation.
+// Work the frame waits for is split over the JobSystem instead.
+class ThreadPool
+{
+public:
+	// 0 picks hardware_concurrency - 1 workers (at least one), leaving a core for the main thread
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	template<typename F>
+	std::future<std::invoke_result_t<F>> Submit(F&& function);
+
+	// Blocks until the job queue is empty and no worker is running a job
+	void WaitIdle();
+
+	uint32_t GetThreadCount() const;
+
+	// Index of the calling worker thread (0 to GetThreadCount() - 1), UINT32_MAX when called from any other thread.
+	// Lets jobs use per-thread resources, like command pools, without locking.
+	static uint32_t GetWorkerIndex();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+	void WorkerLoop(uint32_t workerIndex);
+
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_jobs;
+
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_idle;
+
+	uint32_t m_activeJobs = 0;
+	bool m_isStopping = false;
+};
+
+template<typename F>
+std::future<std::invoke_result_t<F>> ThreadPool::Submit(F&& function)
+{
+	using ReturnType = std::invoke_result_t<F>;
+
+	// std::function needs a copyable callable, packaged_task is move only
+	auto task = std::make_shared<std::packaged_task<ReturnType()>>(std::forward<F>(function));
+	std::future<ReturnType> future = task->get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.emplace([task]() { (*task)(); });
+	}
+
+	m_jobAvailable.notify_one();
+
+	return future;
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <stdexcept>
 
 enum Unit
 {
@@ -20,7 +21,8 @@ private:
 	float ReturnType(std::chrono::nanoseconds deltaTime);
 
 	std::chrono::high_resolution_clock m_timer;
-	std::chrono::nanoseconds m_lastTimePoint = std::chrono::duration<long long, std::nano>(0);
+	// Starts at construction so the first GetDeltaTime() call does not return the time since epoch
+	std::chrono::nanoseconds m_lastTimePoint = std::chrono::high_resolution_clock::now().time_since_epoch();
 };
 
 // Base
@@ -37,24 +39,25 @@ inline float Timer::ReturnType<std::chrono::nanoseconds>(std::chrono::nanosecond
 	return static_cast<float>(deltaTime.count());
 }
 
+// Converted to floating point durations, casting to the integer std::chrono types truncates (e.g. 0.8ms -> 0ms)
 template<>
 inline float Timer::ReturnType<std::chrono::microseconds>(std::chrono::nanoseconds deltaTime)
 {
-	std::chrono::microseconds value = std::chrono::duration_cast<std::chrono::microseconds>(deltaTime);
-	return static_cast<float>(value.count());
+	std::chrono::duration<float, std::micro> value = deltaTime;
+	return value.count();
 }
 
 template<>
 inline float Timer::ReturnType<std::chrono::milliseconds>(std::chrono::nanoseconds deltaTime)
 {
-	std::chrono::milliseconds value = std::chrono::duration_cast<std::chrono::milliseconds>(deltaTime);
-	return static_cast<float>(value.count());
+	std::chrono::duration<float, std::milli> value = deltaTime;
+	return value.count();
 }
 
 template<>
 inline float Timer::ReturnType<std::chrono::seconds>(std::chrono::nanoseconds deltaTime)
 {
-	std::chrono::seconds value = std::chrono::duration_cast<std::chrono::seconds>(deltaTime);
-	return static_cast<float>(value.count());
+	std::chrono::duration<float> value = deltaTime;
+	return value.count();
 }
 //
@@ -7,7 +7,9 @@
 #include <glm/gtx/quaternion.hpp>
 
 #include <string>
+#include <atomic>
 
+class TransformSystem;
 struct Transform
 {
 	Transform() {}
@@ -24,8 +26,13 @@ struct Transform
 	/// <summary>Gets this Transform's rotation in local space.</summary>
 	[[nodiscard]] inline const glm::quat& GetRotation() const { return m_rotation; }
 
-	/// <summary>Gets the matrix that transforms from local space to world space.
+	/// <summary>Gets the matrix that transforms from local space to the parent's space.
 	/// Calling this function recomputes the matrix when necessary.</summary>
+	[[nodiscard]] const glm::mat4& Local();
+
+	/// <summary>Gets the matrix that transforms from local space to world space.
+	/// Transforms without a parent compute it when necessary, for ones with a parent it's the matrix the
+	/// TransformSystem computed in its last update.</summary>
 	[[nodiscard]] const glm::mat4& World();
 
 	void SetTranslation(const glm::vec3& translation)
@@ -49,12 +56,25 @@ struct Transform
 	void SetFromMatrix(const glm::mat4& transform);
 
 private:
+	friend class TransformSystem;
+
 	glm::vec3 m_translation = glm::vec3(0.0f, 0.0f, 0.0f);
 	glm::vec3 m_scale = glm::vec3(1.0f, 1.0f, 1.0f);
 	glm::quat m_rotation = glm::identity<glm::quat>();
 
+	glm::mat4 m_localMatrix = glm::identity<glm::mat4>();
+	bool m_localMatrixDirty = true;
+
+	// Maintained by the TransformSystem for transforms in a hierarchy
 	glm::mat4 m_worldMatrix = glm::identity<glm::mat4>();
-	bool m_worldMatrixDirty = true;
+	bool m_hasParent = false;
+	// Set whenever the local transform changes, until the TransformSystem propagated the change
+	bool m_hasChanged = true;
+	// Update of the TransformSystem that last recomputed the world matrix, children of transforms recomputed in
+	// the current update have to be recomputed too
+	uint32_t m_worldUpdate = 0;
+	// Flag of the subtree the transform is in, lets the TransformSystem skip subtrees without changes
+	std::atomic<bool>* m_pSubtreeChanged = nullptr;
 
 	void SetMatrixDirty();
 };
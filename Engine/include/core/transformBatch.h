@@ -0,0 +1,50 @@
+#pragma once
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include <vector>
+
+// Many transforms without a hierarchy (props, particles, instances), stored as structure of arrays: every
+// component of the translations, rotations and scales has its own array. Computing the world matrices streams
+// through them and builds four matrices at a time with SSE, straight from the quaternion and scale.
+// The matrices are the ones Transform::World() computes for the same translation, rotation and scale.
+class TransformBatch
+{
+public:
+	// Returns the transform's index, indices stay valid until Clear()
+	uint32_t Add(const glm::vec3& translation, const glm::vec3& scale, const glm::quat& rotation);
+	void Reserve(uint32_t count);
+	void Clear();
+
+	void SetTranslation(uint32_t index, const glm::vec3& translation);
+	void SetScale(uint32_t index, const glm::vec3& scale);
+	void SetRotation(uint32_t index, const glm::quat& rotation);
+
+	[[nodiscard]] glm::vec3 GetTranslation(uint32_t index) const;
+	[[nodiscard]] glm::vec3 GetScale(uint32_t index) const;
+	[[nodiscard]] glm::quat GetRotation(uint32_t index) const;
+
+	[[nodiscard]] uint32_t GetSize() const;
+
+	// pMatrices needs room for GetSize() matrices
+	void ComputeWorldMatrices(glm::mat4* pMatrices) const;
+
+private:
+	// Scalar version of the kernel, for the transforms that don't fill a SIMD group
+	void ComputeWorldMatrix(uint32_t index, glm::mat4& matrix) const;
+
+	std::vector<float> m_translationX;
+	std::vector<float> m_translationY;
+	std::vector<float> m_translationZ;
+
+	std::vector<float> m_rotationX;
+	std::vector<float> m_rotationY;
+	std::vector<float> m_rotationZ;
+	std::vector<float> m_rotationW;
+
+	std::vector<float> m_scaleX;
+	std::vector<float> m_scaleY;
+	std::vector<float> m_scaleZ;
+};
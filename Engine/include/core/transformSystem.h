@@ -0,0 +1,89 @@
+#pragma once
+
+#pragma warning(push)
+#pragma warning(disable : 4267) // Deprecated declarations
+#include <entt/entity/registry.hpp>
+#pragma warning(pop)
+
+#include <vector>
+#include <deque>
+#include <atomic>
+
+// Places an entity's Transform in its parent's space. Both entities need a Transform, set parents through
+// TransformSystem::SetParent, which also gives the parent a Hierarchy.
+struct Hierarchy
+{
+	entt::entity parent = entt::null;
+	// Distance to the root, maintained by the TransformSystem
+	uint32_t depth = 0;
+};
+
+class JobSystem;
+
+// Computes the world matrices of transforms in a hierarchy. The hierarchy is kept sorted by root and then by depth,
+// so every subtree is one contiguous range in which parents are updated before their children.
+// Changing a transform flags its subtree, subtrees nobody touched since the last update are skipped without looking
+// at their transforms. Within a flagged subtree only the changed transforms and their descendants are recomputed.
+// Flagged subtrees are independent and split over the job system, a subtree with enough transforms of its own is
+// split level by level instead, the transforms of a level only read their parents' world matrices, which the
+// previous level finished.
+class TransformSystem
+{
+public:
+	// Subtrees and levels are only split into jobs once every job gets at least this many transforms
+	static constexpr uint32_t MIN_TRANSFORMS_PER_JOB = 512;
+
+	explicit TransformSystem(entt::registry& registry);
+	~TransformSystem();
+
+	// entt::null detaches the entity, it becomes a root. The parent can't be a descendant of the entity.
+	void SetParent(entt::entity entity, entt::entity parent);
+
+	// Has to run before world matrices are read, and not concurrently with changes to the registry
+	void Update(JobSystem& jobSystem);
+
+	TransformSystem(const TransformSystem&) = delete;
+	TransformSystem& operator=(const TransformSystem&) = delete;
+
+private:
+	// Hierarchy components were added or removed, e.g. by destroying an entity
+	void OnHierarchyChanged(entt::registry& registry, entt::entity entity);
+
+	// Recomputes the depths and roots, sorts the Hierarchy and Transform storages by them and points every
+	// transform at the changed flag of its subtree
+	void SortHierarchy();
+	uint32_t ComputeDepth(entt::entity entity);
+	// roots is indexed by entity, entt::null where the root wasn't looked up yet
+	entt::entity FindRoot(entt::entity entity, std::vector<entt::entity>& roots);
+
+	void UpdateRange(uint32_t begin, uint32_t end);
+	void UpdateSubtree(uint32_t subtree);
+	uint32_t GetSubtreeSize(uint32_t subtree) const;
+
+	// Transforms keep a pointer to their subtree's flag, it has to be cleared before the flags go away
+	void ReleaseChangedFlags();
+
+	entt::registry& m_registry;
+
+	struct Subtree
+	{
+		// Level i of the subtree spans m_sortedEntities[m_levelOffsets[m_firstLevel + i], m_levelOffsets[m_firstLevel + i + 1])
+		uint32_t m_firstLevel = 0;
+		uint32_t m_levelCount = 0;
+	};
+
+	// Entities grouped by root and in depth order within each group
+	std::vector<entt::entity> m_sortedEntities;
+	std::vector<uint32_t> m_levelOffsets;
+	std::vector<Subtree> m_subtrees;
+	// One per subtree, set by Transform whenever one of the subtree's transforms changes. Only grows, so a
+	// transform holding on to a flag after a sort (e.g. a copy) can't write to freed memory.
+	std::deque<std::atomic<bool>> m_subtreeChanged;
+	bool m_isSortDirty = true;
+
+	// Changed subtrees of the current update that are small enough to share a job
+	std::vector<uint32_t> m_changedSubtrees;
+
+	// Starts at 1, transforms that were never recomputed have 0
+	uint32_t m_update = 0;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// 64-bit key draws are sorted by. The fields that are most expensive to change are the most significant, so sorted
+// draws with the same state form runs that only need their state bound once:
+// | pass 4 | pipeline 12 | material 16 | mesh 16 | depth 16 |
+// Draws whose keys only differ in depth can be drawn as instances of one draw.
+struct DrawSortKey
+{
+	static constexpr uint32_t DEPTH_BITS = 16;
+	static constexpr uint32_t MESH_BITS = 16;
+	static constexpr uint32_t MATERIAL_BITS = 16;
+	static constexpr uint32_t PIPELINE_BITS = 12;
+	static constexpr uint32_t PASS_BITS = 4;
+
+	static constexpr uint32_t MESH_SHIFT = DEPTH_BITS;
+	static constexpr uint32_t MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+	static constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+	static constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+
+	static uint64_t Make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint16_t depth);
+
+	// The key without its depth, equal for draws that can be batched
+	static uint64_t GetBatch(uint64_t key) { return key >> DEPTH_BITS; }
+	static uint32_t GetPass(uint64_t key) { return static_cast<uint32_t>(key >> PASS_SHIFT); }
+	static uint32_t GetPipeline(uint64_t key) { return static_cast<uint32_t>(key >> PIPELINE_SHIFT) & ((1u << PIPELINE_BITS) - 1); }
+	static uint32_t GetMaterial(uint64_t key) { return static_cast<uint32_t>(key >> MATERIAL_SHIFT) & ((1u << MATERIAL_BITS) - 1); }
+	static uint32_t GetMesh(uint64_t key) { return static_cast<uint32_t>(key >> MESH_SHIFT) & ((1u << MESH_BITS) - 1); }
+
+	// Ascending for increasing view depth (front to back), negative depths (behind the camera) map to 0.
+	// Keeps the upper bits of the float, so precision is relative to the distance like the depth buffer's.
+	// Passes that blend back to front store the inverted value.
+	static uint16_t QuantizeDepth(float viewDepth);
+};
+
+// Keys of the visible draws with the index of what they draw, sorted by key before recording
+class DrawList
+{
+public:
+	struct Entry
+	{
+		uint64_t m_key;
+		uint32_t m_index;
+	};
+
+	void Clear();
+	void Add(uint64_t key, uint32_t index);
+
+	// Stable LSD radix sort, one byte per pass. All byte histograms are counted in a single read of the keys and the
+	// passes for bytes that are the same in every key (unused pipeline or material bits, ...) are skipped.
+	void Sort();
+
+	const std::vector<Entry>& GetEntries() const;
+	uint32_t GetSize() const;
+
+private:
+	std::vector<Entry> m_entries;
+	// Ping-pong buffer of the sort, kept to reuse its memory
+	std::vector<Entry> m_sortBuffer;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+// Everything the renderer reads from the registry for one frame. The extraction copies it on the simulation thread,
+// so the render thread never touches the registry while the simulation of the next frame changes it.
+struct FrameSnapshot
+{
+	// Visible entity with a MeshRenderer
+	struct Object
+	{
+		glm::mat4 m_model;
+		glm::vec4 m_color;
+		uint32_t m_mesh;
+	};
+
+	glm::mat4 m_view = glm::mat4(1.f);
+	glm::mat4 m_projection = glm::mat4(1.f);
+	glm::vec3 m_cameraPosition = glm::vec3(0.f);
+	glm::vec3 m_cameraForward = glm::vec3(0.f, 0.f, 1.f);
+
+	// Kept between frames to reuse its memory
+	std::vector<Object> m_objects;
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "ringBuffer.h"
+
+#include "glm/glm.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Identifies a renderable that was spawned through the RenderCommandQueue. Ids aren't reused.
+using RenderableId = uint32_t;
+constexpr RenderableId INVALID_RENDERABLE = UINT32_MAX;
+constexpr uint32_t INVALID_MESH = UINT32_MAX;
+
+// Vertex layout of uploaded meshes, the same as the shared vertex buffer's
+struct MeshVertex
+{
+	glm::vec3 m_position;
+	glm::vec3 m_color;
+	glm::vec2 m_texCoord;
+};
+
+// Geometry of an UPLOAD_MESH command, owned by the command until the render thread applied it
+struct MeshUpload
+{
+	std::vector<MeshVertex> m_vertices;
+	std::vector<uint32_t> m_indices;
+};
+
+enum class RenderCommandType : uint8_t
+{
+	SPAWN_RENDERABLE,
+	DESPAWN_RENDERABLE,
+	UPDATE_TRANSFORM,
+	SET_COLOR,
+	UPLOAD_MESH,
+};
+
+// One cache line per command. Transforms are affine, only the upper three rows of their columns are stored, colors
+// are packed to 8 bits per channel (glm::packUnorm4x8), so they're clamped to [0, 1].
+struct RenderCommand
+{
+	RenderCommandType m_type;
+	// Renderable, or mesh for UPLOAD_MESH
+	uint32_t m_target;
+
+	union
+	{
+		struct
+		{
+			float m_model[12];
+			uint32_t m_mesh;
+			uint32_t m_color;
+		} m_spawn;
+
+		struct
+		{
+			float m_model[12];
+		} m_transform;
+
+		struct
+		{
+			uint32_t m_color;
+		} m_color;
+
+		struct
+		{
+			MeshUpload* m_pMesh;
+		} m_upload;
+	};
+
+	static void EncodeModel(const glm::mat4& model, float* pModel);
+	static glm::mat4 DecodeModel(const float* pModel);
+};
+
+static_assert(sizeof(RenderCommand) == 64, "Render commands are meant to fill exactly one cache line");
+
+// Lets gameplay code on any thread change what the renderer draws without a registry and without touching Vulkan
+// objects. Commands go through a bounded lock-free ring, the render thread applies all of them at the start of its
+// next frame. Renderable and mesh ids are handed out right away, so commands referencing them can follow at once.
+// Every call returns false (or an invalid id) when the ring is full, the command is dropped then and can be
+// retried after the next frame. Meshes reserve their room in the renderer's shared vertex and index buffers when
+// they're queued, a mesh that doesn't fit is rejected right away instead of failing on the render thread.
+class RenderCommandQueue
+{
+public:
+	// capacity has to be a power of two. firstMeshId is the number of meshes the renderer loaded itself, the vertex
+	// and index counts are the room left behind them in the shared buffers.
+	RenderCommandQueue(uint32_t capacity, uint32_t firstMeshId, uint32_t vertexCount, uint32_t indexCount);
+	~RenderCommandQueue();
+
+	[[nodiscard]] RenderableId SpawnRenderable(uint32_t mesh, const glm::mat4& model, const glm::vec4& color = glm::vec4(1.f));
+	// These return false for ids SpawnRenderable never handed out, INVALID_RENDERABLE included
+	bool DespawnRenderable(RenderableId renderable);
+	bool UpdateTransform(RenderableId renderable, const glm::mat4& model);
+	bool SetColor(RenderableId renderable, const glm::vec4& color);
+	// The mesh can be drawn once the render thread applied the command, its id is valid right away.
+	// INVALID_MESH when the ring is full, the mesh is empty or it doesn't fit into the space left.
+	[[nodiscard]] uint32_t UploadMesh(std::vector<MeshVertex> vertices, std::vector<uint32_t> indices);
+
+	// Render thread only. Calls apply for every queued command in order, UPLOAD_MESH commands' MeshUpload is
+	// deleted after apply returned, or threw. Returns the number of commands applied.
+	template<typename F>
+	uint32_t Consume(F&& apply);
+
+	// Meshes loaded by the renderer plus every id UploadMesh handed out. Ids burned by a full ring are counted too,
+	// the renderer leaves their ranges empty.
+	uint32_t GetMeshCount() const;
+
+	RenderCommandQueue(const RenderCommandQueue&) = delete;
+	RenderCommandQueue& operator=(const RenderCommandQueue&) = delete;
+
+private:
+	bool IsValid(RenderableId renderable) const;
+
+	// Takes count from remaining unless that would go below zero
+	static bool TryReserve(std::atomic<uint32_t>& remaining, uint32_t count);
+
+	MpscRingBuffer<RenderCommand> m_ring;
+
+	std::atomic<uint32_t> m_remainingVertices = 0;
+	std::atomic<uint32_t> m_remainingIndices = 0;
+
+	std::atomic<RenderableId> m_nextRenderable = 0;
+	std::atomic<uint32_t> m_nextMesh = 0;
+};
+
+template<typename F>
+uint32_t RenderCommandQueue::Consume(F&& apply)
+{
+	uint32_t count = 0;
+
+	RenderCommand command;
+	while (m_ring.TryPop(command))
+	{
+		// Owned by the command, freed even when apply throws
+		std::unique_ptr<MeshUpload> pMesh(command.m_type == RenderCommandType::UPLOAD_MESH ? command.m_upload.m_pMesh : nullptr);
+
+		apply(static_cast<const RenderCommand&>(command));
+
+		count++;
+	}
+
+	return count;
+}
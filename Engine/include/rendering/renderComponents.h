@@ -2,7 +2,23 @@
 
 #include "glm/glm.hpp"
 
+#include <cstdint>
+
 struct Camera
 {
 	glm::mat4 projection = glm::mat4(1.f);
+};
+
+// Renders one of the renderer's meshes with the entity's Transform, entities without a Transform aren't rendered
+struct MeshRenderer
+{
+	uint32_t mesh = 0;
+	bool visible = true;
+};
+
+// Optional, entities without one render with the default material
+struct Material
+{
+	// Multiplied with the texture
+	glm::vec4 color = glm::vec4(1.f);
 };
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "frameSnapshot.h"
+
+#include <array>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+class Renderer;
+class JobSystem;
+
+// Renders on its own thread from snapshots the simulation thread extracted, so the simulation of the next frame
+// overlaps the recording and submission of the current one. Of its two snapshots one is rendered while the
+// extraction fills the other, the simulation is at most one frame ahead of the render thread.
+class RenderThread
+{
+public:
+	// The render thread attaches to the job system, it needs room for one more attached thread
+	RenderThread(Renderer& renderer, JobSystem& jobSystem);
+	// Renders the submitted snapshot, if any, before it stops
+	~RenderThread();
+
+	// Snapshot the next extraction fills, it belongs to the simulation thread until Submit
+	FrameSnapshot& GetExtractionSnapshot();
+
+	// Hands the extracted snapshot over to the render thread. Waits until the render thread finished the previous
+	// one first, and rethrows what the render thread threw since the last call.
+	void Submit();
+
+	// Blocks until every submitted snapshot was rendered
+	void WaitIdle();
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+private:
+	void RenderLoop();
+
+	Renderer& m_renderer;
+	JobSystem& m_jobSystem;
+
+	std::array<FrameSnapshot, 2> m_snapshots;
+	// Only touched by the simulation thread
+	uint32_t m_extractionIndex = 0;
+
+	// Guards everything below
+	std::mutex m_mutex;
+	std::condition_variable m_frameSubmitted;
+	std::condition_variable m_frameRendered;
+	uint32_t m_renderIndex = 0;
+	bool m_hasSubmittedFrame = false;
+	bool m_isRendering = false;
+	bool m_isStopping = false;
+	std::exception_ptr m_exception;
+
+	// Started last, everything it uses is initialized by then
+	std::thread m_thread;
+};
@@ -2,13 +2,37 @@
 
 #include "vkCommon.h"
 
+#include <array>
+
+// Last known layout of an image, its last write and the reads since, the source of the next barrier on it.
+// Owned by whoever owns the image, so it carries over between command buffers and frames.
+struct ImageState
+{
+	VkImageLayout m_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	// Last write or layout transition, later accesses wait for it
+	VkPipelineStageFlags2 m_writeStageMask = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 m_writeAccessMask = VK_ACCESS_2_NONE;
+	// Scope the last write is already visible to, reads within it need no barrier. The next write waits for these stages.
+	VkPipelineStageFlags2 m_readStageMask = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 m_readAccessMask = VK_ACCESS_2_NONE;
+};
+
+// State setting calls (binds, viewport and scissor) that were recorded and ones that were filtered out because
+// they wouldn't have changed the bound state
+struct CommandBufferStatistics
+{
+	uint32_t m_issuedStateCalls = 0;
+	uint32_t m_skippedStateCalls = 0;
+};
+
 class CommandPool;
 class CommandBuffer
 {
 public:
 	// Doesn't need initializers, allocating is done in the command pool, as well as resetting.
 
-	void BeginCommandBuffer(const VkCommandBufferBeginInfo* info) const;
+	// Forgets the bound state and resets the statistics
+	void BeginCommandBuffer(const VkCommandBufferBeginInfo* info);
 	void EndCommandBuffer() const;
 
 	void BeginRendering(const VkRenderingInfo* info) const;
@@ -16,8 +40,10 @@ public:
 
 	VkCommandBuffer* GetVkPtr();
 
-	void SetViewPort(const VkViewport* pViewports, uint32_t firstViewport = 0, uint32_t viewportCount = 1) const;
-	void SetScissor(const VkRect2D* pScissors, uint32_t firstScissor = 0, uint32_t scissorCount = 1) const;
+	// Binds and dynamic state are tracked per command buffer object and skipped when they match what's bound.
+	// Copies of a CommandBuffer track separately, record through a single object (or references to it).
+	void SetViewPort(const VkViewport* pViewports, uint32_t firstViewport = 0, uint32_t viewportCount = 1);
+	void SetScissor(const VkRect2D* pScissors, uint32_t firstScissor = 0, uint32_t scissorCount = 1);
 
 	void DrawIndexed(uint32_t indexCount,
 		uint32_t instanceCount = 1,
@@ -27,23 +53,88 @@ public:
 
 	void BindPipeline(VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline);
 
-	void BindVertexBuffers(const VkBuffer* pBuffers, const VkDeviceSize* pOffsets, uint32_t firstBinding = 0, uint32_t bindingCount = 1) const;
-	void BindIndexBuffer(VkBuffer buffer, VkIndexType indexType, VkDeviceSize offset = 0) const;
+	void Dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1) const;
+	// Group counts are read from a VkDispatchIndirectCommand in the buffer, e.g. written by a culling pass
+	void DispatchIndirect(VkBuffer buffer, VkDeviceSize offset = 0) const;
+	// Group count needed to cover elementCount invocations with groupSize invocations per group
+	static uint32_t GetGroupCount(uint32_t elementCount, uint32_t groupSize);
+
+	void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t size, const void* pValues, uint32_t offset = 0) const;
+
+	// Secondary command buffers recorded for the current dynamic rendering scope (begun with the secondary contents flag).
+	// The bound state is undefined afterwards, everything is bound again.
+	void ExecuteCommands(const VkCommandBuffer* pCommandBuffers, uint32_t commandBufferCount = 1);
+
+	void BindVertexBuffers(const VkBuffer* pBuffers, const VkDeviceSize* pOffsets, uint32_t firstBinding = 0, uint32_t bindingCount = 1);
+	void BindIndexBuffer(VkBuffer buffer, VkIndexType indexType, VkDeviceSize offset = 0);
+	// Binds with dynamic offsets are always recorded
 	void BindDescriptorSets(
 		VkPipelineLayout layout,
 		const VkDescriptorSet* pDescriptorSets,
 		uint32_t firstSet = 0,
 		uint32_t descriptorSetCount = 1,
 		uint32_t dynamicOffsetCount = 0,
-		const uint32_t* pDynamicOffsets = nullptr) const;
+		const uint32_t* pDynamicOffsets = nullptr);
 
 	void MemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, uint32_t memoryBarrierCount, const VkMemoryBarrier* pMemoryBarriers, VkDependencyFlags flags = 0) const;
 	void BufferMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier* pBufferMemoryBarriers, VkDependencyFlags flags = 0) const;
 	void ImageMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier* pImageMemoryBarriers, VkDependencyFlags flags = 0) const;
 
+	// Synchronization2 barriers are queued and recorded together by FlushBarriers(), so a batch of transitions costs
+	// a single vkCmdPipelineBarrier2. Flush before the commands that depend on them.
+	void AddBufferBarrier(const VkBufferMemoryBarrier2& barrier);
+	void AddImageBarrier(const VkImageMemoryBarrier2& barrier);
+
+	// Queues a barrier from the image's tracked state to the new one and updates the state. Reads in the same layout
+	// only wait for the last write, and are skipped when an earlier barrier already made it visible to their scope.
+	// Writes and layout transitions wait for the last write and every read since.
+	// With discardContents the old contents are dropped (old layout UNDEFINED), the transition is always recorded.
+	void TransitionImage(VkImage image, ImageState& state, VkImageLayout newLayout, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask,
+		VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, bool discardContents = false);
+
+	void FlushBarriers();
+
 	void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* pRegions) const;
 	void CopyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout, uint32_t regionCount, const VkBufferImageCopy* pRegions) const;
+
+	void ResetQueryPool(VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount) const;
+	void WriteTimestamp(VkPipelineStageFlagBits pipelineStage, VkQueryPool queryPool, uint32_t query) const;
+
+	// Since recording began
+	const CommandBufferStatistics& GetStatistics() const;
 private:
+	static constexpr uint32_t MAX_TRACKED_DESCRIPTOR_SETS = 4;
+	static constexpr uint32_t MAX_TRACKED_VERTEX_BINDINGS = 4;
+
+	// What's known to be bound, VK_NULL_HANDLE when unknown. Only the graphics and compute bind points are tracked.
+	struct BoundState
+	{
+		std::array<VkPipeline, 2> m_pipelines{};
+		std::array<std::array<VkPipelineLayout, MAX_TRACKED_DESCRIPTOR_SETS>, 2> m_descriptorSetLayouts{};
+		std::array<std::array<VkDescriptorSet, MAX_TRACKED_DESCRIPTOR_SETS>, 2> m_descriptorSets{};
+
+		std::array<VkBuffer, MAX_TRACKED_VERTEX_BINDINGS> m_vertexBuffers{};
+		std::array<VkDeviceSize, MAX_TRACKED_VERTEX_BINDINGS> m_vertexOffsets{};
+		VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+		VkDeviceSize m_indexOffset = 0;
+		VkIndexType m_indexType = VK_INDEX_TYPE_MAX_ENUM;
+
+		// Only single viewport and scissor sets are tracked
+		bool m_hasViewport = false;
+		VkViewport m_viewport{};
+		bool m_hasScissor = false;
+		VkRect2D m_scissor{};
+	};
+
+	// Counts the call and returns whether it can be skipped
+	bool SkipRedundant(bool isRedundant);
+
 	VkCommandBuffer m_commandBuffer;
 	VkPipelineBindPoint m_pipelineBindPoint = VK_PIPELINE_BIND_POINT_MAX_ENUM;
+
+	BoundState m_boundState{};
+	CommandBufferStatistics m_statistics{};
+
+	std::vector<VkBufferMemoryBarrier2> m_pendingBufferBarriers;
+	std::vector<VkImageMemoryBarrier2> m_pendingImageBarriers;
 };
\ No newline at end of file
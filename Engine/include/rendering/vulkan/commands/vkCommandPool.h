@@ -3,15 +3,24 @@
 #include "vkCommon.h"
 
 class CommandBuffer;
+// Pools are per frame in flight and reset as a whole once the frame's GPU work finished, command buffers are never
+// reset one by one. Secondary command buffers come from a separate graphics pool per recording thread, command pools
+// can't be used from multiple threads at once.
 class CommandPool
 {
 public:
-	CommandPool(VkDevice device, const QueueFamilyIndices& queueFamilyIndices);
+	// recordingThreadCount is the amount of threads that may record secondary command buffers at the same time
+	CommandPool(VkDevice device, const QueueFamilyIndices& queueFamilyIndices, uint32_t recordingThreadCount);
 	~CommandPool();
 
 	const CommandBuffer& GetOrCreateCommandBuffer(QueueType type, unsigned int currentFrame);
 	std::vector<CommandBuffer> GetOrCreateCommandBuffers(QueueType type, unsigned int count, unsigned int currentFrame);
 
+	// Only touches the pool of threadIndex, so every recording thread can call it without locking
+	CommandBuffer GetOrCreateSecondaryCommandBuffer(uint32_t threadIndex, unsigned int currentFrame);
+	uint32_t GetRecordingThreadCount() const;
+
+	// Resets every pool of the frame, including the per-thread ones. No thread may be recording for that frame.
 	void ResetCommandBuffers(unsigned int currentFrame);
 
 	CommandPool(const CommandPool&) = delete;
@@ -26,14 +35,28 @@ private:
 
 	VkCommandPool GetVkCommandPool(QueueType type, unsigned int currentFrame) const;
 
+	struct ThreadCommandBuffers
+	{
+		VkCommandPool m_commandPool = VK_NULL_HANDLE;
+		std::vector<CommandBuffer> m_secondaryCommandBuffers;
+		// Handed out since the last reset
+		uint32_t m_usedCount = 0;
+	};
+
 	std::array<VkCommandPool, MAX_FRAMES_IN_FLIGHT> m_graphicsCommandPools{};
 	std::array<VkCommandPool, MAX_FRAMES_IN_FLIGHT> m_transferCommandPools{};
+	std::array<VkCommandPool, MAX_FRAMES_IN_FLIGHT> m_computeCommandPools{};
 
 	std::array<std::vector<CommandBuffer>, MAX_FRAMES_IN_FLIGHT> m_graphicsCommandBuffers;
 	std::array<std::vector<CommandBuffer>, MAX_FRAMES_IN_FLIGHT> m_transferCommandBuffers;
+	std::array<std::vector<CommandBuffer>, MAX_FRAMES_IN_FLIGHT> m_computeCommandBuffers;
 
 	std::array<int, MAX_FRAMES_IN_FLIGHT> m_currentGraphicsIndex;
 	std::array<int, MAX_FRAMES_IN_FLIGHT> m_currentTransferIndex;
+	std::array<int, MAX_FRAMES_IN_FLIGHT> m_currentComputeIndex;
+
+	// Indexed by recording thread, sized once in the constructor so threads never see the vectors change
+	std::array<std::vector<ThreadCommandBuffers>, MAX_FRAMES_IN_FLIGHT> m_threadCommandBuffers;
 
 	VkDevice m_device;
 };
\ No newline at end of file
@@ -11,6 +11,7 @@ public:
 
 	// Change name.. probably the class name over the function name. Make it plural?
 	VkQueue GetQueue(QueueType type) const;
+	const QueueFamilyIndices& GetQueueFamilyIndices() const;
 
 	// Delete when CommandBuffer class is in place
 	std::shared_ptr<CommandPool> GetCommandPool() const;
@@ -18,6 +19,11 @@ public:
 	const CommandBuffer& GetOrCreateCommandBuffer(QueueType type, unsigned int currentFrame);
 	std::vector<CommandBuffer> GetOrCreateCommandBuffers(QueueType type, uint32_t count, unsigned int currentFrame);
 
+	// Graphics secondaries, every recording thread has its own pool. Thread indices are the job system's thread
+	// indices (JobSystem::GetThreadIndex).
+	CommandBuffer GetOrCreateSecondaryCommandBuffer(uint32_t threadIndex, unsigned int currentFrame);
+	uint32_t GetRecordingThreadCount() const;
+
 	void ResetCommandBuffers(unsigned int currentFrame) const;
 
 	Queue(const Queue&) = delete;
@@ -26,6 +32,8 @@ private:
 	VkQueue m_graphicsQueue{};
 	VkQueue m_presentQueue{};
 	VkQueue m_transferQueue{};
+	// Same queue as m_graphicsQueue when there is no dedicated compute family
+	VkQueue m_computeQueue{};
 
 	VkDevice m_device;
 
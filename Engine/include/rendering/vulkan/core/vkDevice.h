@@ -4,6 +4,7 @@
 #include "vkWindow.h"
 #include "vkSurface.h"
 #include "vkSwapchain.h"
+#include "vkOffscreenTarget.h"
 
 struct VmaAllocator_T;
 typedef VmaAllocator_T* VmaAllocator;
@@ -15,9 +16,12 @@ class Device
 public:
 	Device() = default;
 
-	void Initialize();
+	// When headless, no window, surface or swapchain is created and the renderer draws into an offscreen image ring
+	void Initialize(bool headless = false);
 	void ShutDown();
 
+	bool IsHeadless() const;
+
 	GLFWwindow* GetWindow() const;
 	VkDevice GetVkDevice() const;
 	VkInstance GetInstance() const;
@@ -27,6 +31,8 @@ public:
 	std::shared_ptr<PhysicalDevice> GetPhysicalDevice() const;
 	std::shared_ptr<Window> GetVkWindow() const;
 	std::shared_ptr<Swapchain> GetSwapchain() const;
+	std::shared_ptr<OffscreenTarget> GetOffscreenTarget() const;
+	std::shared_ptr<RenderTarget> GetRenderTarget() const;
 	std::shared_ptr<Queue> GetQueue() const;
 
 	const VmaAllocator& GetAllocator() const;
@@ -59,6 +65,7 @@ private:
 	//
 
 	std::shared_ptr<Swapchain> m_pSwapchain = nullptr;
+	std::shared_ptr<OffscreenTarget> m_pOffscreenTarget = nullptr;
 	std::shared_ptr<Window> m_pVkWindow = nullptr;
 	std::shared_ptr<PhysicalDevice> m_pPhysicalDevice = nullptr;
 	std::shared_ptr<Queue> m_pQueue = nullptr;
@@ -71,4 +78,7 @@ private:
 	VkDevice m_device{};
 
 	VkDebugUtilsMessengerEXT m_debugMessenger{};
+
+	std::vector<const char*> m_enabledDeviceExtensions;
+	bool m_isHeadless = false;
 };
\ No newline at end of file
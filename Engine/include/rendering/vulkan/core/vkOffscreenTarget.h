@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vkCommon.h"
+#include "vkRenderTarget.h"
+
+struct VmaAllocator_T;
+typedef VmaAllocator_T* VmaAllocator;
+struct VmaAllocation_T;
+typedef VmaAllocation_T* VmaAllocation;
+
+class PhysicalDevice;
+
+// Ring of VMA-allocated color images used instead of a swapchain when
+// the device runs without a window. Images are handed out round-robin by AcquireNextImage().
+class OffscreenTarget : public RenderTarget
+{
+public:
+	OffscreenTarget(VkDevice device, VmaAllocator allocator, std::shared_ptr<PhysicalDevice> physicalDevice, VkExtent2D extent, uint32_t imageCount);
+	~OffscreenTarget();
+
+	uint32_t AcquireNextImage();
+
+	const VkExtent2D& GetExtent() const override { return m_extent; }
+	VkFormat GetImageFormat() const override { return m_imageFormat; }
+
+	const std::vector<VkImage>& GetImages() const override { return m_images; }
+	const std::vector<VkImageView>& GetImageViews() const override { return m_imageViews; }
+
+	OffscreenTarget(const OffscreenTarget&) = delete;
+	OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+private:
+	void CreateColorResources(uint32_t imageCount);
+
+	void CreateImage(VkFormat format, VkImageUsageFlags usage, VkImage& image, VmaAllocation& allocation) const;
+	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) const;
+
+	VkDevice m_device;
+	VmaAllocator m_allocator;
+	std::shared_ptr<PhysicalDevice> m_pPhysicalDevice;
+
+	VkExtent2D m_extent;
+	VkFormat m_imageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+
+	std::vector<VkImage> m_images;
+	std::vector<VmaAllocation> m_allocations;
+	std::vector<VkImageView> m_imageViews;
+
+	uint32_t m_nextImage = 0;
+};
\ No newline at end of file
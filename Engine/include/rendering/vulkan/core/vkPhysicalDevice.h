@@ -5,6 +5,7 @@
 class PhysicalDevice
 {
 public:
+	// Pass VK_NULL_HANDLE as surface to pick a device for headless rendering
 	PhysicalDevice(VkInstance instance, VkSurfaceKHR surface);
 
 	VkPhysicalDevice GetDevice() const;
@@ -21,7 +22,7 @@ private:
 	int RatePhysicalDevice(VkPhysicalDevice device, VkSurfaceKHR surface) const;
 	bool IsDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface) const;
 
-	bool CheckDeviceExtensionSupport( VkPhysicalDevice device) const;
+	bool CheckDeviceExtensionSupport(VkPhysicalDevice device, bool requirePresentation) const;
 
 	VkPhysicalDevice m_physicalDevice;
 };
\ No newline at end of file
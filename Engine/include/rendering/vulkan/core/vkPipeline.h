@@ -1,25 +1,102 @@
 #pragma once
 
 #include "vkCommon.h"
+#include "vkShaderReflection.h"
 
+#include <array>
 #include <string>
+#include <atomic>
+#include <future>
+#include <type_traits>
+
+// Upper bound of a key's serialized state. The forward pipeline needs about 400 bytes, every further color attachment
+// adds 32 and every vertex attribute 16.
+constexpr size_t PIPELINE_KEY_CAPACITY = 1024;
+
+// Canonical byte serialization of a pipeline's state. Fields are written one by one (no struct padding, sType or pNext)
+// and arrays are prefixed with their count, so identical state always produces identical bytes. Keys are hashed once
+// as raw memory and compared with memcmp, cheap enough to look pipelines up per draw. The bytes are stored inline,
+// building, copying and looking up a key never allocates.
+class PipelineKey
+{
+public:
+	template<typename T>
+	void Write(T value);
+	void Write(float value);
+	void Write(const char* string);
+
+	// Computes the hash, call once all state is written
+	void Finalize();
+
+	uint64_t GetHash() const;
+	size_t GetSize() const;
+
+	bool operator==(const PipelineKey& other) const;
+	bool operator!=(const PipelineKey& other) const;
+
+private:
+	void WriteBytes(const void* data, size_t size);
+
+	uint64_t m_hash = 0;
+	uint32_t m_size = 0;
+	bool m_isFinalized = false;
+	std::array<uint8_t, PIPELINE_KEY_CAPACITY> m_data{};
+};
+
+static_assert(std::is_trivially_copyable_v<PipelineKey>, "Pipeline keys are copied as plain memory");
+
+template<typename T>
+void PipelineKey::Write(T value)
+{
+	static_assert(std::is_scalar_v<T>, "Write struct members individually, structs can contain padding bytes");
+	WriteBytes(&value, sizeof(T));
+}
 
+struct PipelineKeyHasher
+{
+	size_t operator()(const PipelineKey& key) const { return static_cast<size_t>(key.GetHash()); }
+};
+
+// Pipeline infos own copies of everything they reference, so they can be copied and handed to a worker
+// thread. The pointers inside the Vulkan create info structs are only filled in right before creation.
 struct BasePipelineInfo
 {
+	virtual ~BasePipelineInfo() = default;
+
 	virtual void SetShader(const std::string& filename, ShaderType type) = 0;
 
 	void SetLayoutInfo(const std::vector<VkDescriptorSetLayout>& layouts);
 	void SetLayoutInfo(const std::vector<VkDescriptorSetLayout>& layouts, const std::vector<VkPushConstantRange>& pushConstants);
+	// Set layouts and push constant ranges of all shaders specified so far, set layouts come from the DescriptorLayoutCache
+	void SetLayoutFromReflection();
+
+	// Merged reflection of all shaders specified so far
+	ShaderReflection GetReflection() const;
+
+	// Create info pointing into this object's storage, only valid as long as this object isn't modified or moved
+	VkPipelineLayoutCreateInfo GetLayoutCreateInfo() const;
+
+protected:
+	void WriteShaderStages(PipelineKey& key) const;
+	void WriteLayout(PipelineKey& key) const;
+
+public:
 
 	std::vector<VkPipelineShaderStageCreateInfo> m_shaderStages{};
+	std::vector<std::shared_ptr<const ShaderReflection>> m_shaderReflections{};
+	// SPIR-V hash per stage, written to the key instead of the module handle so keys don't depend on creation order
+	std::vector<uint64_t> m_shaderCodeHashes{};
 	VkPipelineLayoutCreateInfo m_layoutInfo{};
+
+	std::vector<VkDescriptorSetLayout> m_setLayouts{};
+	std::vector<VkPushConstantRange> m_pushConstantRanges{};
 };
 
 struct ComputePipelineInfo : public BasePipelineInfo
 {	
 	void SetShader(const std::string& filename, ShaderType type);
 
-	std::size_t Hash() const;
+	PipelineKey BuildKey() const;
 };
 
 struct GraphicsPipelineInfo : public BasePipelineInfo
@@ -27,6 +104,8 @@ struct GraphicsPipelineInfo : public BasePipelineInfo
 	void SetShader(const std::string& filename, ShaderType type);
 	void SetDynamicStates(const std::vector<VkDynamicState>& dynamicStates);
 	void SetVertexInputState(const std::vector<VkVertexInputBindingDescription>& bindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
+	// Single interleaved binding with the vertex shader's inputs tightly packed in location order, set the vertex shader first
+	void SetVertexInputStateFromReflection();
 	void SetInputAssemblyState(VkPrimitiveTopology topology, VkBool32 primitiveRestartEnable);
 	void SetViewportState(uint32_t viewportCount = 1, uint32_t scissorCount = 1);
 
@@ -68,11 +147,29 @@ struct GraphicsPipelineInfo : public BasePipelineInfo
 
 	void SetRenderInfo(const std::vector<VkFormat>& imageFormats, VkFormat depthFormat = VK_FORMAT_UNDEFINED, VkFormat StencilFormat = VK_FORMAT_UNDEFINED);
 
-	std::size_t Hash() const;
+	PipelineKey BuildKey() const;
 
 private:
 	friend class PipelineCache;
 
+	// Fills in the pointers of the state structs, see BasePipelineInfo
+	struct CreateInfoStates
+	{
+		VkPipelineDynamicStateCreateInfo m_dynamicState;
+		VkPipelineVertexInputStateCreateInfo m_vertexInputState;
+		VkPipelineMultisampleStateCreateInfo m_multisampleState;
+		VkPipelineColorBlendStateCreateInfo m_colorBlendState;
+		VkPipelineRenderingCreateInfo m_renderInfo;
+	};
+	CreateInfoStates GetCreateInfoStates() const;
+
+	std::vector<VkDynamicState> m_dynamicStates{};
+	std::vector<VkVertexInputBindingDescription> m_bindingDescriptions{};
+	std::vector<VkVertexInputAttributeDescription> m_attributeDescriptions{};
+	std::vector<VkSampleMask> m_sampleMask{};
+	std::vector<VkPipelineColorBlendAttachmentState> m_colorBlendAttachments{};
+	std::vector<VkFormat> m_colorAttachmentFormats{};
+
 	VkPipelineDynamicStateCreateInfo m_dynamicState{};
 	VkPipelineVertexInputStateCreateInfo m_vertexInputState{};
 	VkPipelineInputAssemblyStateCreateInfo m_inputAssemblyState{};
@@ -96,6 +193,32 @@ public:
 private:
 	friend class PipelineCache;
 
+	// Owned by the PipelineLayoutCache. Pipelines with the same set layouts and push constant ranges share the handle,
+	// so descriptor sets bound for one of them stay bound when switching to another one with the same layout.
 	VkPipelineLayout m_layout{};
 	VkPipeline m_pipeline{};
+};
+
+// Result of an asynchronous pipeline request. Get() hands out the fallback pipeline until compilation finished,
+// so the fallback has to use a compatible pipeline layout for the descriptor sets that are bound with it.
+// Giving both the same set layouts and push constant ranges guarantees that, they then share one VkPipelineLayout.
+// A failed compilation is logged once and Get() keeps handing out the fallback, only Wait() rethrows the failure.
+class PipelineHandle
+{
+public:
+	PipelineHandle() = default;
+	PipelineHandle(std::shared_future<std::shared_ptr<Pipeline>> future, std::shared_ptr<Pipeline> fallback);
+
+	bool IsReady() const;
+	// Compilation finished with an exception
+	bool HasFailed() const;
+
+	std::shared_ptr<Pipeline> Get() const;
+	std::shared_ptr<Pipeline> Wait() const;
+
+private:
+	std::shared_future<std::shared_ptr<Pipeline>> m_future;
+	std::shared_ptr<Pipeline> m_fallback;
+	// Shared by copies of the handle, so a failure is only logged once
+	std::shared_ptr<std::atomic<bool>> m_pHasFailed;
 };
\ No newline at end of file
@@ -1,40 +1,98 @@
 #pragma once
 
 #include "vkCommon.h"
+#include "vkPipeline.h"
 
 #include <string>
 #include <unordered_map>
+#include <mutex>
+#include <future>
 
+class PipelineLayoutCache;
+class DescriptorLayoutCache;
+class ShaderReflection;
+
+struct Shader
+{
+	VkPipelineShaderStageCreateInfo m_stageInfo{};
+
+	// Hash of the SPIR-V, identifies the code in pipeline keys independent of module handles and filenames
+	uint64_t m_codeHash = 0;
+
+	// Reflected once when the module is created, shared by every pipeline using the shader
+	std::shared_ptr<const ShaderReflection> m_pReflection = nullptr;
+};
+
+// Modules are keyed by the hash of their SPIR-V, so identical code shipped under different filenames shares one module.
+// Filenames are a secondary index that only saves reading and hashing the file again.
+// Hash hits compare the code, different code with the same hash gets a reseeded hash instead of the other's module.
 class ShaderCache
 {
 public:
-	static VkPipelineShaderStageCreateInfo GetOrCreateShader(const std::string& filename, ShaderType type);
+	static Shader GetOrCreateShader(const std::string& filename, ShaderType type);
 	static void Reset();
 
 	static VkShaderStageFlagBits GetShaderStageFlag(ShaderType type);
 private:
 	static VkShaderModule CreateShaderModule(const std::vector<char>& code);
+	// Both lookups reject a shader that is already used with another stage the same way
+	static void CheckStage(const Shader& shader, VkShaderStageFlagBits stage, const std::string& filename);
 
-	// TODO: Make shared_ptr to reduce copy costs
-	inline static std::unordered_map<std::string, VkPipelineShaderStageCreateInfo> m_shaderCache;
+	struct CachedShader
+	{
+		Shader m_shader;
+		// Compared on every hash hit, a hash collision must never hand out another shader's module
+		std::vector<char> m_code;
+	};
+
+	inline static std::unordered_map<uint64_t, CachedShader> m_shaderCache;
+	inline static std::unordered_map<std::string, uint64_t> m_filenameIndex;
+	inline static std::mutex m_mutex;
 };
 
-struct GraphicsPipelineInfo;
-struct ComputePipelineInfo;
-class Pipeline;
-// TODO: Add compute support
+// All functions are thread safe
 class PipelineCache
 {
 public:
 	static std::shared_ptr<Pipeline> GetOrCreateGraphicsPipeline(const GraphicsPipelineInfo& info);
 	static std::shared_ptr<Pipeline> GetOrCreateComputePipeline(const ComputePipelineInfo& info);
 
+	// Lookup only, for callers that keep the key of their pipeline around (e.g. per draw). Nullptr if it doesn't exist (yet).
+	static std::shared_ptr<Pipeline> FindGraphicsPipeline(const PipelineKey& key);
+
+	// Compiles the pipeline on the engine's thread pool, the handle returns the fallback until it's done.
+	// Requests for a pipeline that is already being compiled share the same job.
+	static PipelineHandle GetOrCreateGraphicsPipelineAsync(const GraphicsPipelineInfo& info, std::shared_ptr<Pipeline> fallback = nullptr);
+
+	// Blocks until all asynchronous compilations finished
+	static void WaitForPendingPipelines();
+
+	// Creates the VkPipelineCache, seeded from disk when the file was written by the same device and driver
+	static void Initialize(const std::string& cacheFilename = PIPELINE_CACHE_PATH);
+	// Serializes the VkPipelineCache before destroying it
 	static void Reset();
 
+	static void SaveToDisk();
+
+	// Owns the layouts of all cached pipelines, identical layout infos resolve to the same VkPipelineLayout
+	static PipelineLayoutCache& GetPipelineLayoutCache();
+	// Set layouts built from shader reflection are created through this one, so equal sets share a handle
+	static DescriptorLayoutCache& GetDescriptorLayoutCache();
+
 private:
+	static std::vector<char> LoadFromDisk(const std::string& cacheFilename, const VkPhysicalDeviceProperties& properties);
+
 	static std::shared_ptr<Pipeline> CreateGraphicsPipeline(const GraphicsPipelineInfo& info);
 	static std::shared_ptr<Pipeline> CreateComputePipeline(const ComputePipelineInfo& info);
 
-	inline static std::unordered_map<size_t, std::shared_ptr<Pipeline>> m_graphicsPipelineCache;
-	inline static std::unordered_map<size_t, std::shared_ptr<Pipeline>> m_computePipelineCache;
+	inline static std::unordered_map<PipelineKey, std::shared_ptr<Pipeline>, PipelineKeyHasher> m_graphicsPipelineCache;
+	inline static std::unordered_map<PipelineKey, std::shared_ptr<Pipeline>, PipelineKeyHasher> m_computePipelineCache;
+	inline static std::unordered_map<PipelineKey, std::shared_future<std::shared_ptr<Pipeline>>, PipelineKeyHasher> m_pendingGraphicsPipelines;
+	inline static std::mutex m_mutex;
+
+	inline static std::shared_ptr<PipelineLayoutCache> m_pPipelineLayoutCache = nullptr;
+	inline static std::shared_ptr<DescriptorLayoutCache> m_pDescriptorLayoutCache = nullptr;
+
+	inline static VkPipelineCache m_vkPipelineCache = VK_NULL_HANDLE;
+	inline static std::string m_cacheFilename;
 };
\ No newline at end of file
@@ -0,0 +1,267 @@
+#pragma once
+
+#include "vkCommon.h"
+#include "vkCommandBuffer.h"
+
+#include <functional>
+#include <unordered_map>
+
+struct VmaAllocation_T;
+typedef VmaAllocation_T* VmaAllocation;
+
+class Device;
+
+// Handles are only valid for the graph they were created in and until its next Reset()
+struct RenderGraphImage
+{
+	uint32_t m_index = UINT32_MAX;
+	bool IsValid() const { return m_index != UINT32_MAX; }
+};
+
+struct RenderGraphBuffer
+{
+	uint32_t m_index = UINT32_MAX;
+	bool IsValid() const { return m_index != UINT32_MAX; }
+};
+
+// Usage flags of transient resources are collected from the passes that use them
+struct RenderGraphImageDesc
+{
+	VkExtent2D m_extent{};
+	VkFormat m_format = VK_FORMAT_UNDEFINED;
+};
+
+struct RenderGraphBufferDesc
+{
+	VkDeviceSize m_size = 0;
+};
+
+// An image that lives outside the graph, e.g. a swapchain image
+struct ImportedImageInfo
+{
+	VkImage m_image = VK_NULL_HANDLE;
+	VkImageView m_view = VK_NULL_HANDLE;
+	VkFormat m_format = VK_FORMAT_UNDEFINED;
+	VkExtent2D m_extent{};
+
+	// Layout the image is left in after the last pass, UNDEFINED leaves it in whatever the last pass needed
+	VkImageLayout m_finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	// Stages of the semaphore wait the image is handed over with, the first barrier chains to that wait
+	VkPipelineStageFlags2 m_waitStageMask = VK_PIPELINE_STAGE_2_NONE;
+};
+
+struct RenderGraphStatistics
+{
+	uint32_t m_passCount = 0;
+	uint32_t m_culledPassCount = 0;
+	// Memory bound to transient resources, and what it would be without aliasing
+	VkDeviceSize m_transientMemory = 0;
+	VkDeviceSize m_transientMemoryUnaliased = 0;
+};
+
+// Frame graph, rebuilt every frame: passes declare the images and buffers they read and write, Compile() culls passes
+// whose results nobody uses, and Execute() records the passes in declaration order with the barriers and layout
+// transitions between them batched in front of each pass.
+// Transient resources only exist for the frame. Ones whose lifetimes (first to last pass using them) don't overlap
+// share memory. Their images and memory are kept while the graph compiles to the same set of transient resources,
+// so a graph that doesn't change from frame to frame doesn't allocate.
+// Attachments written without loading them are overwritten entirely, their earlier contents are discarded and the
+// passes that wrote them before are culled. Transient resources start out with undefined contents every frame.
+class RenderGraph
+{
+public:
+	using ExecuteFunction = std::function<void(CommandBuffer&)>;
+
+	class PassBuilder
+	{
+	public:
+		// loadContents when the pass loads the attachment instead of clearing it or not caring about it
+		PassBuilder& WriteColorAttachment(RenderGraphImage image, bool loadContents = false);
+		PassBuilder& WriteDepthAttachment(RenderGraphImage image, bool loadContents = false);
+		PassBuilder& ReadDepthAttachment(RenderGraphImage image);
+		PassBuilder& ReadTexture(RenderGraphImage image, VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+		PassBuilder& ReadStorageImage(RenderGraphImage image, VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+		PassBuilder& WriteStorageImage(RenderGraphImage image, VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+		PassBuilder& ReadTransfer(RenderGraphImage image);
+		PassBuilder& WriteTransfer(RenderGraphImage image);
+
+		// usage is the single buffer usage the pass reads it through (vertex, index, indirect, uniform, storage or transfer)
+		PassBuilder& ReadBuffer(RenderGraphBuffer buffer, VkBufferUsageFlagBits usage, VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_NONE);
+		PassBuilder& WriteBuffer(RenderGraphBuffer buffer, VkBufferUsageFlagBits usage, VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_NONE);
+
+		// The pass is never culled, for passes whose effects the graph can't see (readbacks, queries)
+		PassBuilder& SetSideEffects();
+
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph& graph, uint32_t passIndex) : m_graph(graph), m_passIndex(passIndex) {}
+
+		PassBuilder& AddImage(RenderGraphImage image, VkImageLayout layout, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask,
+			VkImageUsageFlags usage, uint32_t accessType);
+		PassBuilder& AddBuffer(RenderGraphBuffer buffer, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask,
+			VkBufferUsageFlags usage, uint32_t accessType);
+
+		RenderGraph& m_graph;
+		uint32_t m_passIndex;
+	};
+
+	RenderGraph(std::shared_ptr<Device> device);
+	~RenderGraph();
+
+	// Drops the passes and resources of the last frame, the physical transient resources are kept for reuse
+	void Reset();
+	// Drops the tracked state of every imported image, call it when they were destroyed (e.g. the swapchain was
+	// recreated). A new image can get the handle of a destroyed one, it must not inherit its layout.
+	void ForgetImportedImages();
+
+	RenderGraphImage ImportImage(const std::string& name, const ImportedImageInfo& info);
+	RenderGraphBuffer ImportBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize size);
+	RenderGraphImage CreateImage(const std::string& name, const RenderGraphImageDesc& desc);
+	RenderGraphBuffer CreateBuffer(const std::string& name, const RenderGraphBufferDesc& desc);
+
+	// Passes execute in the order they're added
+	PassBuilder AddPass(const std::string& name, ExecuteFunction execute);
+
+	// Culls passes, computes resource lifetimes and (re)creates the transient resources when they changed.
+	// Recreating waits for the device to be idle, which only happens when the graph's shape or extent changes.
+	void Compile();
+	// Queued barriers of the command buffer (e.g. upload acquires) are flushed together with the first pass' ones
+	void Execute(CommandBuffer& commandBuffer);
+
+	// Only valid after Compile(), and for transient resources only while a pass that isn't culled uses them
+	VkImage GetImage(RenderGraphImage image) const;
+	VkImageView GetImageView(RenderGraphImage image) const;
+	VkBuffer GetBuffer(RenderGraphBuffer buffer) const;
+
+	const RenderGraphStatistics& GetStatistics() const;
+
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+private:
+	// What a pass does with a resource's contents, decides culling and whether they can be discarded
+	enum AccessType : uint32_t
+	{
+		ACCESS_READ = 1 << 0,
+		ACCESS_WRITE = 1 << 1,
+		// The whole resource is written, nothing of its earlier contents survives
+		ACCESS_OVERWRITE = 1 << 2,
+	};
+
+	struct ResourceAccess
+	{
+		uint32_t m_resource;
+		VkImageLayout m_layout;
+		VkPipelineStageFlags2 m_stageMask;
+		VkAccessFlags2 m_accessMask;
+		uint32_t m_type;
+	};
+
+	struct Pass
+	{
+		std::string m_name;
+		ExecuteFunction m_execute;
+		std::vector<ResourceAccess> m_images;
+		std::vector<ResourceAccess> m_buffers;
+		bool m_hasSideEffects = false;
+		bool m_isCulled = false;
+	};
+
+	// Buffers don't have a layout, the same state as images without it
+	struct BufferState
+	{
+		VkPipelineStageFlags2 m_writeStageMask = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 m_writeAccessMask = VK_ACCESS_2_NONE;
+		VkPipelineStageFlags2 m_readStageMask = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 m_readAccessMask = VK_ACCESS_2_NONE;
+	};
+
+	struct ImageResource
+	{
+		std::string m_name;
+		RenderGraphImageDesc m_desc;
+		VkImageUsageFlags m_usage = 0;
+		VkImageAspectFlags m_aspect = 0;
+
+		bool m_isImported = false;
+		ImportedImageInfo m_import;
+
+		// Passes (indices) of the first and last use after culling, m_firstPass is UINT32_MAX when unused
+		uint32_t m_firstPass = UINT32_MAX;
+		uint32_t m_lastPass = 0;
+		uint32_t m_physical = UINT32_MAX;
+	};
+
+	struct BufferResource
+	{
+		std::string m_name;
+		RenderGraphBufferDesc m_desc;
+		VkBufferUsageFlags m_usage = 0;
+
+		bool m_isImported = false;
+		VkBuffer m_importedBuffer = VK_NULL_HANDLE;
+
+		uint32_t m_firstPass = UINT32_MAX;
+		uint32_t m_lastPass = 0;
+		uint32_t m_physical = UINT32_MAX;
+	};
+
+	// Shared by the transient resources aliased into it. The state is the one the last of them left it in, its write
+	// scope covers every access of it, the first barrier of the next one has to wait on it (also across frames).
+	struct MemoryBlock
+	{
+		VmaAllocation m_allocation = VK_NULL_HANDLE;
+		VkDeviceSize m_size = 0;
+		BufferState m_state;
+	};
+
+	struct PhysicalImage
+	{
+		VkImage m_image = VK_NULL_HANDLE;
+		VkImageView m_view = VK_NULL_HANDLE;
+		uint32_t m_memoryBlock = 0;
+		ImageState m_state;
+	};
+
+	struct PhysicalBuffer
+	{
+		VkBuffer m_buffer = VK_NULL_HANDLE;
+		uint32_t m_memoryBlock = 0;
+		BufferState m_state;
+	};
+
+	void CullPasses();
+	void ComputeLifetimes();
+	// Describes every transient resource that is used, compiling to the same key reuses the physical resources
+	std::vector<uint64_t> BuildTransientKey() const;
+	void CreateTransientResources();
+	void DestroyTransientResources();
+
+	// Finds a block whose other resources are never alive at the same time, or adds a new one
+	uint32_t AssignMemoryBlock(std::vector<std::vector<std::pair<uint32_t, uint32_t>>>& blockLifetimes,
+		std::vector<VkMemoryRequirements>& blockRequirements, const VkMemoryRequirements& requirements, uint32_t firstPass, uint32_t lastPass) const;
+
+	void RecordBarriers(CommandBuffer& commandBuffer, uint32_t passIndex);
+	void RecordBufferBarrier(CommandBuffer& commandBuffer, VkBuffer buffer, BufferState& state, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask);
+
+	ImageState& GetImageState(uint32_t image);
+	BufferState& GetBufferState(uint32_t buffer);
+
+	std::shared_ptr<Device> m_pDevice;
+
+	std::vector<Pass> m_passes;
+	std::vector<ImageResource> m_images;
+	std::vector<BufferResource> m_buffers;
+
+	// Imported resources keep their state across frames, keyed by handle as the graph is rebuilt every frame
+	std::unordered_map<VkImage, ImageState> m_importedImageStates;
+	std::unordered_map<VkBuffer, BufferState> m_importedBufferStates;
+
+	std::vector<uint64_t> m_transientKey;
+	std::vector<MemoryBlock> m_memoryBlocks;
+	std::vector<PhysicalImage> m_physicalImages;
+	std::vector<PhysicalBuffer> m_physicalBuffers;
+
+	RenderGraphStatistics m_statistics{};
+	bool m_isCompiled = false;
+};
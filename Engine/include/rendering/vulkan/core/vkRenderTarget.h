@@ -0,0 +1,18 @@
+#pragma once
+
+#include "vkCommon.h"
+
+// Common interface for whatever the renderer draws into, so recording doesn't have to care whether
+// the images come from a swapchain or from an offscreen ring (headless mode).
+// Only the color images live here, depth and other attachments are transient render graph images.
+class RenderTarget
+{
+public:
+	virtual ~RenderTarget() = default;
+
+	virtual const VkExtent2D& GetExtent() const = 0;
+	virtual VkFormat GetImageFormat() const = 0;
+
+	virtual const std::vector<VkImage>& GetImages() const = 0;
+	virtual const std::vector<VkImageView>& GetImageViews() const = 0;
+};
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vkCommon.h"
+
+#include <map>
+
+class DescriptorLayoutCache;
+
+struct ReflectedVertexInput
+{
+	uint32_t m_location = 0;
+	VkFormat m_format = VK_FORMAT_UNDEFINED;
+	uint32_t m_size = 0;
+};
+
+// Descriptor bindings, push constant ranges and vertex inputs read straight from SPIR-V, so layouts don't have to be
+// written by hand next to every shader. Reflections of the stages of one pipeline are merged into a single one.
+class ShaderReflection
+{
+public:
+	ShaderReflection() = default;
+
+	// Throws when the code isn't valid SPIR-V or uses resources the reflection doesn't understand
+	static ShaderReflection Reflect(const std::vector<char>& code, VkShaderStageFlagBits stage);
+
+	// Bindings used by both are combined into one with the stage flags of both, push constants into one range
+	void Merge(const ShaderReflection& other);
+
+	// One layout per set index up to the highest set used, unused sets get an empty layout
+	std::vector<VkDescriptorSetLayout> CreateSetLayouts(DescriptorLayoutCache& layoutCache) const;
+	std::vector<VkPushConstantRange> GetPushConstantRanges() const;
+
+	// Interleaved in a single binding, attributes tightly packed in location order
+	void GetVertexInput(std::vector<VkVertexInputBindingDescription>& bindingDescriptions, std::vector<VkVertexInputAttributeDescription>& attributeDescriptions) const;
+
+	// Exact amount of descriptors needed to allocate setCount copies of every set
+	std::vector<VkDescriptorPoolSize> GetPoolSizes(uint32_t setCount) const;
+
+	const std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>>& GetSets() const;
+	const std::vector<ReflectedVertexInput>& GetVertexInputs() const;
+
+private:
+	// Set index to its bindings, sorted by binding index
+	std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> m_sets;
+	std::vector<ReflectedVertexInput> m_vertexInputs;
+
+	VkShaderStageFlags m_pushConstantStages = 0;
+	uint32_t m_pushConstantOffset = 0;
+	uint32_t m_pushConstantSize = 0;
+};
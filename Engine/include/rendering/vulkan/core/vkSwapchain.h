@@ -1,30 +1,30 @@
 #pragma once
 
 #include "vkCommon.h"
+#include "vkRenderTarget.h"
 
 class Window;
 class PhysicalDevice;
-class Swapchain
+class Swapchain : public RenderTarget
 {
 public:
 	Swapchain(const VkDevice& device, const VkSurfaceKHR& surface, std::shared_ptr<Window> window, std::shared_ptr<PhysicalDevice> physicalDevice);
 	~Swapchain();
 
+	// Called from the render thread, does nothing while the window is minimized
 	void RecreateSwapchain();
 	
 	VkSwapchainKHR GetVkSwapChain() const { return m_swapChain; }
-	const VkExtent2D& GetExtent() const { return m_extent; }
+	const VkExtent2D& GetExtent() const override { return m_extent; }
 	VkFormat GetFormat() const { return m_imageFormat; }
 
-	const std::vector<VkImage>& GetImages() const { return m_images; }
-	const std::vector<VkImageView>& GetImageViews() const { return m_imageViews; }
-	const VkImageView& GetDepthView() const { return m_depthImageView; }
-	const VkFormat GetImageFormat() const{ return m_imageFormat; }
+	const std::vector<VkImage>& GetImages() const override { return m_images; }
+	const std::vector<VkImageView>& GetImageViews() const override { return m_imageViews; }
+	VkFormat GetImageFormat() const override { return m_imageFormat; }
 
 private:
 	void CreateSwapchain();
 	void CreateImageViews();
-	void CreateDepthResources();
 
 	void CleanUp();
 
@@ -43,8 +43,4 @@ private:
 
 	std::vector<VkImage> m_images;
 	std::vector<VkImageView> m_imageViews;
-
-	VkImage m_depthImage;
-	VkDeviceMemory m_depthImageMemory;
-	VkImageView m_depthImageView;
 };
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "vkCommon.h"
 
+#include <atomic>
+
 class Window
 {
 public:
@@ -11,9 +13,16 @@ public:
 	GLFWwindow* GetWindow() const { return m_pVkWindow; } // Not sure how to do this with smart pointers since there's no destructor..
 	VkExtent2D ChooseExtent(const VkSurfaceCapabilitiesKHR& capabilities) const;
 
+	// Framebuffer size as of the last event poll. GLFW can only be queried on the main thread, the swapchain is
+	// recreated on the render thread.
+	VkExtent2D GetFramebufferExtent() const;
+
 	void SetFrameBufferResized(const bool isResized);
+	void SetFramebufferExtent(int width, int height);
 private:
 	GLFWwindow* m_pVkWindow;
 
-	bool m_isFramebufferResized = false;
+	std::atomic<bool> m_isFramebufferResized = false;
+	std::atomic<uint32_t> m_framebufferWidth = 0;
+	std::atomic<uint32_t> m_framebufferHeight = 0;
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "vkCommon.h"
 
 #include <unordered_map>
+#include <mutex>
 
 class DescriptorLayoutCache
 {
@@ -30,4 +31,5 @@ private:
 
 	VkDevice m_device;
 	std::unordered_map<DescriptorLayoutInfo, VkDescriptorSetLayout, DescriptorLayoutHash> m_layoutCache;
+	std::mutex m_mutex; // Pipeline infos (and their reflected layouts) can be built on any thread
 };
\ No newline at end of file
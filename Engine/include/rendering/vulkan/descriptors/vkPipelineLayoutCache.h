@@ -0,0 +1,41 @@
+#pragma once
+
+#include "vkCommon.h"
+
+#include <unordered_map>
+#include <mutex>
+
+// Deduplicates pipeline layouts by their set layouts and push constant ranges. Pipelines sharing a layout keep
+// their bound descriptor sets valid when switching between them. Thread safe, pipelines are compiled on workers.
+class PipelineLayoutCache
+{
+public:
+	PipelineLayoutCache(VkDevice device);
+	~PipelineLayoutCache();
+
+	VkPipelineLayout GetOrCreatePipelineLayout(const VkPipelineLayoutCreateInfo* info);
+
+	struct PipelineLayoutInfo
+	{
+		// Set layouts from the DescriptorLayoutCache are unique per binding description, so comparing handles is enough
+		std::vector<VkDescriptorSetLayout> m_setLayouts;
+		std::vector<VkPushConstantRange> m_pushConstantRanges;
+
+		bool operator==(const PipelineLayoutInfo& other) const;
+
+		size_t Hash() const;
+	};
+
+	PipelineLayoutCache(const PipelineLayoutCache&) = delete;
+	PipelineLayoutCache& operator=(const PipelineLayoutCache&) = delete;
+
+private:
+	struct PipelineLayoutHash
+	{
+		std::size_t operator()(const PipelineLayoutInfo& other) const;
+	};
+
+	VkDevice m_device;
+	std::unordered_map<PipelineLayoutInfo, VkPipelineLayout, PipelineLayoutHash> m_layoutCache;
+	std::mutex m_mutex;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "vkCommon.h"
+#include "vkCommandBuffer.h"
+
+#include <deque>
+
+#pragma warning(push, 0)
+#include <vma/vk_mem_alloc.h>
+#pragma warning(pop)
+
+class Device;
+
+// Streams data into device local buffers and images without stalling the queue. Data is copied into a persistently
+// mapped staging ring right away, the GPU copies are batched into one command buffer that Flush() submits.
+// Every submission signals the manager's timeline semaphore, its ring space and command buffer are reused once the
+// semaphore reached that value. Work that reads uploaded data waits on the semaphore with GetSubmittedValue().
+// Copies run on the transfer queue. When that is a dedicated queue family, ownership of the uploaded resources is
+// released there and acquired by the graphics queue in the next frame's command buffer, see RecordAcquireBarriers().
+// Not thread safe, uploads are issued from the thread that renders.
+class UploadManager
+{
+public:
+	// Stages that consume uploaded data, graphics submissions wait on the upload timeline with this mask
+	static constexpr VkPipelineStageFlags WAIT_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	UploadManager(std::shared_ptr<Device> device, VkDeviceSize stagingSize = UPLOAD_STAGING_SIZE);
+	~UploadManager();
+
+	// Buffers larger than the staging ring are split into multiple copies
+	void UploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+	// Replaces the contents of a single mip, single layer color image and leaves it in SHADER_READ_ONLY_OPTIMAL
+	void UploadImage(VkImage dst, const void* data, VkDeviceSize size, uint32_t width, uint32_t height);
+
+	// Submits everything recorded since the last flush, returns the timeline value that signals its completion
+	uint64_t Flush();
+	// Blocks until all submitted uploads are done
+	void WaitIdle();
+
+	// Records the graphics side of the ownership transfers of everything flushed so far. Has to be recorded into a
+	// graphics command buffer that waits on GetSubmittedValue() and is submitted before the resources are used.
+	// The barriers are queued on the command buffer, they're recorded with its next FlushBarriers().
+	void RecordAcquireBarriers(CommandBuffer& graphicsCommandBuffer);
+
+	VkSemaphore GetTimelineSemaphore() const;
+	// Value of the last submission, 0 while nothing was submitted yet (the semaphore starts at 0)
+	uint64_t GetSubmittedValue() const;
+
+	UploadManager(const UploadManager&) = delete;
+	UploadManager& operator=(const UploadManager&) = delete;
+
+private:
+	struct Submission
+	{
+		CommandBuffer m_commandBuffer;
+		uint64_t m_timelineValue;
+		// Ring position that becomes free once the submission finished
+		uint64_t m_ringEnd;
+	};
+
+	// Returns the offset into the staging buffer. When the ring is full, pending copies are flushed and the
+	// oldest submission is waited on, so this is the only place an upload can block.
+	VkDeviceSize Allocate(VkDeviceSize size);
+	// Begins a command buffer for the next batch if none is being recorded
+	CommandBuffer& GetCommandBuffer();
+	// Releases the ring space and command buffers of finished submissions, blocks until waitValue is reached first
+	void Retire(uint64_t waitValue = 0);
+	// Ends the layout transitions of the batch, or releases its resources to the graphics queue family
+	void RecordReleaseBarriers();
+
+	std::shared_ptr<Device> m_pDevice;
+
+	VkQueue m_transferQueue = VK_NULL_HANDLE;
+	uint32_t m_transferFamily = 0;
+	uint32_t m_graphicsFamily = 0;
+	// Only when the transfer queue has its own family, resources are exclusive to one family at a time
+	bool m_isOwnershipTransferNeeded = false;
+
+	VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
+	VmaAllocation m_stagingAllocation = VK_NULL_HANDLE;
+	uint8_t* m_pMappedStaging = nullptr;
+	VkDeviceSize m_stagingSize = 0;
+	VkDeviceSize m_alignment = 0;
+
+	// Monotonic byte positions, the staging offset is the position modulo the ring size
+	uint64_t m_ringHead = 0;
+	uint64_t m_ringTail = 0;
+
+	VkCommandPool m_commandPool = VK_NULL_HANDLE;
+	std::vector<CommandBuffer> m_freeCommandBuffers;
+	CommandBuffer m_commandBuffer{};
+	bool m_isRecording = false;
+
+	// Barriers of the batch being recorded, recorded once right before it's submitted
+	std::vector<VkBufferMemoryBarrier2> m_bufferReleases;
+	std::vector<VkImageMemoryBarrier2> m_imageReleases;
+	// Matching barriers for the graphics queue of batches that were submitted already
+	std::vector<VkBufferMemoryBarrier2> m_bufferAcquires;
+	std::vector<VkImageMemoryBarrier2> m_imageAcquires;
+
+	VkSemaphore m_timelineSemaphore = VK_NULL_HANDLE;
+	uint64_t m_submittedValue = 0;
+	std::deque<Submission> m_submissions;
+};
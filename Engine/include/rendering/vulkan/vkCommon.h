@@ -20,6 +20,7 @@
 
 #define ASSERT_VK_SWAPCHAIN_CLASS(swapchain) assert(swapchain && "Vulkan swapchain is either uninitialized or deleted")
 #define ASSERT_VK_SURFACE_CLASS(surface) assert(surface && "Vulkan window surface is either uninitialized or deleted")
+#define ASSERT_VK_RENDER_TARGET_CLASS(target) assert(target && "Render target is either uninitialized or deleted")
 #define ASSERT_VK_WINDOW_CLASS(window) assert(window && "Vulkan window is either uninitialized or deleted")
 #define ASSERT_VK_QUEUE_CLASS(queue) assert(queue && "Queue class is is either uninitialized or deleted")
 #define ASSERT_GLFW_WINDOW_PTR(window) assert(window && "GLFW window is either uninitialized or deleted")
@@ -48,17 +49,47 @@ const uint32_t HEIGHT = 600;
 const std::string MODEL_PATH = "../Engine/models/viking_room.obj";
 const std::string TEXTURE_PATH = "../Engine/textures/viking_room.png";
 
+// Serialized VkPipelineCache, relative to the working directory
+const std::string PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
+// Persistently mapped staging memory the UploadManager streams buffer and image data through
+const VkDeviceSize UPLOAD_STAGING_SIZE = 32 * 1024 * 1024;
+
+// Draws are only split over multiple threads once every recording job gets at least this many,
+// below that the cost of secondary command buffers outweighs parallel recording
+const uint32_t MIN_DRAWS_PER_RECORDING_JOB = 128;
+
+// Objects the per-frame object buffers hold initially, they grow to the largest scene rendered so far
+const uint32_t INITIAL_OBJECT_CAPACITY = 1024;
+
+// Vertices and indices the shared mesh buffers hold, at least the loaded model's. Meshes uploaded through render
+// commands are appended until they're full.
+const uint32_t SHARED_VERTEX_CAPACITY = 256 * 1024;
+const uint32_t SHARED_INDEX_CAPACITY = 1024 * 1024;
+
+// Render commands that can be queued between two frames, a power of two
+const uint32_t RENDER_COMMAND_CAPACITY = 64 * 1024;
+
+// Amount of offscreen color images the renderer cycles through when running headless
+const uint32_t OFFSCREEN_IMAGE_COUNT = MAX_FRAMES_IN_FLIGHT;
+
 const std::vector<const char*> deviceExtensions =
 {
-	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 	VK_EXT_SHADER_DEMOTE_TO_HELPER_INVOCATION_EXTENSION_NAME,
 	VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
-	VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
-	VK_KHR_PRESENT_ID_EXTENSION_NAME,
 	VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+	VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
 	VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
 };
 
+// Only required when presenting to a window, headless devices (software drivers on CI/render farms) may not expose these
+const std::vector<const char*> presentDeviceExtensions =
+{
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+	VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+	VK_KHR_PRESENT_ID_EXTENSION_NAME
+};
+
 enum class ShaderType
 {
 	VERTEX,
@@ -79,10 +110,12 @@ struct QueueFamilyIndices
 	std::optional<uint32_t> m_graphicsFamily;
 	std::optional<uint32_t> m_presentFamily;
 	std::optional<uint32_t> m_transferFamily;
+	// Compute without graphics when the device has such a family, so compute work runs next to rasterization
+	std::optional<uint32_t> m_computeFamily;
 
 	bool IsComplete() const
 	{
-		return m_graphicsFamily.has_value() && m_presentFamily.has_value() && m_transferFamily.has_value();
+		return m_graphicsFamily.has_value() && m_presentFamily.has_value() && m_transferFamily.has_value() && m_computeFamily.has_value();
 	}
 };
 
@@ -2,11 +2,28 @@
 
 #include "vkCommon.h"
 #include "vkDevice.h"
+#include "vkPipeline.h"
+#include "vkShaderReflection.h"
+#include "vkUploadManager.h"
+#include "vkRenderGraph.h"
+#include "drawList.h"
+#include "frameSnapshot.h"
+#include "renderCommandQueue.h"
+
+#include <functional>
+#include <mutex>
+
+#include "glm/glm.hpp"
 
 #pragma warning(push, 0)
 #include <vma/vk_mem_alloc.h>
 #pragma warning(pop)
 
+#pragma warning(push)
+#pragma warning(disable : 4267) // Deprecated declarations
+#include <entt/entity/registry.hpp>
+#pragma warning(pop)
+
 struct FrameContext
 {
 	void Init(std::shared_ptr<Device> device);
@@ -14,30 +31,99 @@ struct FrameContext
 
 	VkSemaphore m_imageAvailableSemaphore;
 	VkSemaphore m_renderFinishedSemaphore;
-	uint64_t m_timelineValue;
+	uint64_t m_timelineValue = 0;
+
+	// Set once the frame's timestamp queries were submitted, the pool slots hold garbage before that
+	bool m_hasTimestamps = false;
+};
+
+// CPU timings are measured for the frame that was just rendered, GPU time belongs to the frame that
+// last used the same frame in flight slot (its results are only available after the timeline wait)
+struct FrameStatistics
+{
+	float m_recordTimeMs = 0.f;
+	float m_submitTimeMs = 0.f;
+	float m_gpuTimeMs = 0.f;
+
+	// Rendered entities, the draws they were batched into and the draws instancing saved
+	uint32_t m_instanceCount = 0;
+	uint32_t m_drawCount = 0;
+	uint32_t m_collapsedDrawCount = 0;
+
+	// Render commands applied at the start of the frame
+	uint32_t m_renderCommandCount = 0;
+
+	// State calls of the frame's primary and secondary command buffers, recorded and filtered out as redundant
+	uint32_t m_issuedStateCalls = 0;
+	uint32_t m_skippedStateCalls = 0;
+};
+
+// Range of the shared vertex and index buffers a mesh occupies, MeshRenderer::mesh indexes them
+struct MeshRange
+{
+	uint32_t m_firstIndex = 0;
+	uint32_t m_indexCount = 0;
+	int32_t m_vertexOffset = 0;
+};
+
+// Instanced draw of a run of sorted draws with the same state, the shaders find each instance's object data through
+// its instance index, the instances' entries are contiguous from m_firstInstance on
+struct DrawRange
+{
+	uint32_t m_firstIndex = 0;
+	uint32_t m_indexCount = 0;
+	int32_t m_vertexOffset = 0;
+	uint32_t m_firstInstance = 0;
+	uint32_t m_instanceCount = 1;
 };
 
 class CommandBuffer;
-class Pipeline;
 class Renderer
 {
 public:
 	Renderer(std::shared_ptr<Device> device);
 	~Renderer();
 
-	void Update();
-	void Render();
+	// Copies the camera and the visible entities into the snapshot. Runs on the simulation thread, it doesn't touch
+	// any of the render thread's state.
+	void Extract(entt::registry& registry, FrameSnapshot& snapshot) const;
+	// Renders a snapshot, only the render thread calls it
+	void Render(const FrameSnapshot& snapshot);
+
+	// Late latching, thread safe. Frames render with the newest latched camera instead of their snapshot's, it's
+	// written to the frame's uniform buffer right before the submit. Without a latched camera frames use their own.
+	void LatchCamera(const glm::mat4& view, const glm::mat4& projection);
+	void ClearLatchedCamera();
+
+	// Compute work for the next frame, e.g. culling or post-processing. Everything enqueued is recorded into one command
+	// buffer and submitted to the compute queue ahead of the frame, overlapping the previous frame's rasterization.
+	// The frame waits for it before COMPUTE_WAIT_STAGES, so its draws can consume the results (indirect arguments too).
+	// With waitForPreviousFrame the work starts after the previous frame's graphics work, to read what it rendered.
+	// Resources shared with a dedicated compute family need concurrent sharing (see ChooseSharingMode).
+	// Can be called from any thread.
+	void EnqueueAsyncCompute(std::function<void(CommandBuffer&)> record, bool waitForPreviousFrame = false);
+
+	// Renderables that live outside the registry, drawn with the extracted entities. Any thread can queue commands.
+	RenderCommandQueue& GetCommandQueue();
+
+	// Loaded meshes plus the ones queued for upload, thread safe
+	uint32_t GetMeshCount() const;
+
+	// Statistics of the last frame the render thread finished
+	FrameStatistics GetFrameStatistics() const;
+	bool SupportsGpuTimestamps() const;
 
 	Renderer(const Renderer&) = delete;
 	Renderer& operator=(const Renderer&) = delete;
 private:
-	void CreateDescriptorSetLayout();
 	void CreateGraphicsPipeline();
 	void CreateTextureImage();
 	void CreateTextureImageView();
 	void CreateTextureSampler();
 	void CreateUniformBuffers();
+	void CreateObjectBuffers();
 	void CreateSyncObjects();
+	void CreateTimestampQueryPool();
 	void CreateDescriptorPool();
 	void CreateDescriptorSets();
 
@@ -49,34 +135,93 @@ private:
 	void CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags ImageUsageFlags, VmaMemoryUsage memoryUsageFlags, VkImage& image, VmaAllocation& imageAllocation) const;
 	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) const;
 	//void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) const;
-	void CopyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size) const;
-	void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) const;
 
 	// VMA
 	void CreateBuffer(VkDeviceSize size, VkBuffer& buffer, VmaAllocation& allocation, VkBufferUsageFlagBits bufferUsageFlags, VmaMemoryUsage memoryUsageFlags);
 
+	// Data goes through the UploadManager's staging ring, it's on the GPU once the upload timeline reaches its flush
 	template <typename T>
 	void CreateBufferWithStaging(VkDeviceSize size, VkBuffer& buffer, VmaAllocation& allocation, std::vector<T>& bufferData, VkBufferUsageFlagBits usageFlag);
 	void CreateBufferWithStaging(VkDeviceSize size, VkBuffer& buffer, VmaAllocation& allocation, void* bufferData, VkBufferUsageFlagBits usageFlag);
 	//
 
-	void UpdateMVP(const int currentFrame);
+	// Applies the queued render commands to the retained renderables and uploads queued meshes
+	void ApplyRenderCommands();
+	// Appends the mesh to the shared vertex and index buffers, the frame's submission waits for the upload.
+	// The command queue only accepts meshes that fit.
+	void UploadMesh(uint32_t mesh, const MeshUpload& upload);
+
+	// Both have to run after the frame's timeline wait, they write the current frame's buffers.
+	// The camera is written last, right before the submit, to pick up the newest latched camera.
+	void UpdateCameraUniforms(const FrameSnapshot& snapshot);
+	// Puts the snapshot's objects and the retained renderables into the draw list and sorts it. Runs of objects with the same state become one
+	// instanced draw, their object data is written contiguously into the current frame's object buffer in sorted
+	// order (front to back within a run).
+	void BuildDraws(const FrameSnapshot& snapshot);
+	// (Re)creates a frame's object buffer and points its descriptor set at it, the frame must not be in flight
+	void ResizeObjectBuffer(uint32_t frame, uint32_t capacity);
 
 	VkShaderModule CreateShaderModule(const std::vector<char>& code);
 
-	void RecordCommandBuffer(CommandBuffer commandBuffer, uint32_t imageIndex) const;
-	const CommandBuffer& BeginSingleTimeCommands() const;
-	void EndSingleTimeCommands(CommandBuffer commandBuffer) const;
+	// Returns false when the frame has to be skipped (e.g. the swapchain was out of date and got recreated)
+	bool AcquireNextImage(const FrameContext& frame, uint32_t& imageIndex);
+	void PresentImage(const FrameContext& frame, uint32_t imageIndex);
+
+	// Reads back the GPU time of the last submission that used this frame context, must be called after its timeline wait
+	void ReadTimestamps(FrameContext& frame);
 
-	void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) const;
+	// Submits the enqueued async compute work with the current frame's compute pool, returns the compute timeline
+	// value the frame has to wait on (the last submitted one when nothing was enqueued)
+	uint64_t SubmitAsyncCompute();
 
-	bool HasStencilComponent(VkFormat format) const;
+	// Builds the frame's render graph and records it
+	void RecordCommandBuffer(CommandBuffer commandBuffer, uint32_t imageIndex);
+
+	// Binds the draw state and records m_draws[firstDraw, firstDraw + drawCount), called from recording threads
+	void RecordDraws(CommandBuffer& commandBuffer, const Pipeline& pipeline, const VkExtent2D& extent, uint32_t firstDraw, uint32_t drawCount) const;
+	// Splits m_draws over the job system's workers and the calling thread, each recording into a secondary command
+	// buffer from its own pool. Returns them in draw order, or nothing when there are too few draws to be worth it.
+	std::vector<CommandBuffer> RecordDrawsParallel(const Pipeline& pipeline, const VkExtent2D& extent, VkFormat colorFormat);
+
+	// Sort key pass of the forward pass' opaque draws
+	static constexpr uint32_t OPAQUE_PASS = 0;
+
+	// Stages of the frame that may consume async compute results
+
+	static constexpr VkPipelineStageFlags COMPUTE_WAIT_STAGES = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 
 	std::shared_ptr<Device> m_pDevice;
 
+	// Frame submissions wait on its timeline and acquire the uploaded resources from the transfer queue,
+	// so everything uploaded before a submit is visible to that frame
+	std::unique_ptr<UploadManager> m_pUploadManager;
+
+	// Merged reflection of the default pipeline's shaders, the descriptor pool is sized from it
+	ShaderReflection m_shaderReflection;
+	// Owned by the PipelineCache's DescriptorLayoutCache
 	VkDescriptorSetLayout m_descriptorSetLayout;
 
-	std::shared_ptr<Pipeline> m_pipeline;
+	// Compiled synchronously at startup, drawn with while asynchronously requested pipelines are still compiling
+	std::shared_ptr<Pipeline> m_defaultPipeline;
+	PipelineHandle m_pipeline;
+
+	// Indexed by mesh id, ids that were handed out but aren't uploaded yet have empty ranges
+	std::vector<MeshRange> m_meshes;
+
+	std::unique_ptr<RenderCommandQueue> m_pCommandQueue;
+	// Indexed by RenderableId, despawned ones stay as dead entries since ids aren't reused
+	struct RetainedRenderable
+	{
+		FrameSnapshot::Object m_object;
+		bool m_isAlive = false;
+	};
+	std::vector<RetainedRenderable> m_retainedRenderables;
+
+	// Rebuilt every frame, the draw list refers to the snapshot's objects by index, the retained renderables follow
+	// them (index - snapshot object count)
+	DrawList m_drawList;
+	std::vector<DrawRange> m_draws;
 
 	VkBuffer m_vertexBuffer;
 	//VkDeviceMemory m_vertexBufferMemory;
@@ -84,11 +229,26 @@ private:
 	VkBuffer m_indexBuffer;
 	//VkDeviceMemory m_indexBufferMemory;
 	VmaAllocation m_indexAllocation;
+	// Used and allocated vertices and indices of the shared buffers
+	uint32_t m_vertexCount = 0;
+	uint32_t m_indexCount = 0;
+	uint32_t m_vertexCapacity = 0;
+	uint32_t m_indexCapacity = 0;
 
 	std::vector<VkBuffer> m_uniformBuffers;
 	std::vector<VmaAllocation> m_uniformAllocations;
 	std::vector<void*> m_mappedUniformBuffers;
 
+	// Per frame in flight, persistently mapped and indexed by instance
+	std::vector<VkBuffer> m_objectBuffers;
+	std::vector<VmaAllocation> m_objectAllocations;
+	std::vector<void*> m_mappedObjectBuffers;
+	std::vector<uint32_t> m_objectCapacities;
+
+	// Rebuilt every frame, owns the depth buffer and keeps track of the render target's layouts
+	std::unique_ptr<RenderGraph> m_pRenderGraph;
+	VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
+
 	VkImage m_textureImage;
 	VmaAllocation m_textureAllocation;
 	//yVkDeviceMemory m_textureImageMemory;
@@ -102,8 +262,30 @@ private:
 	uint32_t m_currentFrame = 0;
 
 	VkSemaphore m_globalTimelineSemaphore;
+
+	// Guards the enqueued work, it's enqueued from other threads than the render thread
+	std::mutex m_asyncComputeMutex;
+	std::vector<std::function<void(CommandBuffer&)>> m_asyncComputeWork;
+	bool m_isComputeWaitingForGraphics = false;
+	VkSemaphore m_computeTimelineSemaphore = VK_NULL_HANDLE;
+	uint64_t m_computeTimelineValue = 0;
+
 	std::array<FrameContext, MAX_FRAMES_IN_FLIGHT> m_frameContexts{};
 
+	// Two timestamps (begin, end) per frame in flight
+	VkQueryPool m_timestampQueryPool = VK_NULL_HANDLE;
+	float m_timestampPeriod = 0.f;
+	// Filled while rendering, copied to m_lastFrameStatistics once the frame was submitted
+	FrameStatistics m_frameStatistics{};
+	mutable std::mutex m_statisticsMutex;
+	FrameStatistics m_lastFrameStatistics{};
+
+	// Guards the latched camera, the simulation thread latches it while the render thread records
+	std::mutex m_latchedCameraMutex;
+	glm::mat4 m_latchedView = glm::mat4(1.f);
+	glm::mat4 m_latchedProjection = glm::mat4(1.f);
+	bool m_hasLatchedCamera = false;
+
 	std::vector<uint32_t> m_queueSetIndices;
 	VkSharingMode m_sharingMode;
 };
\ No newline at end of file
@@ -1,22 +1,35 @@
 #version 450
 
-layout(binding = 0) uniform MVP
+layout(binding = 0) uniform Camera
 {
-    mat4 model;
     mat4 view;
     mat4 projection;
-} mvp;
+} camera;
+
+struct ObjectData
+{
+    mat4 model;
+    vec4 color;
+};
+
+// One entry per rendered object, draws select theirs through firstInstance
+layout(std430, binding = 2) readonly buffer Objects
+{
+    ObjectData objects[];
+};
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
-layout(location = 0) out vec3 fragColor;
+layout(location = 0) out vec4 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main() 
 {
-    gl_Position = mvp.projection * mvp.view * mvp.model * vec4(inPosition, 1);
-    fragColor = inColor;
+    ObjectData object = objects[gl_InstanceIndex];
+
+    gl_Position = camera.projection * camera.view * object.model * vec4(inPosition, 1);
+    fragColor = object.color;
     fragTexCoord = inTexCoord;
 }
\ No newline at end of file
@@ -2,47 +2,112 @@
 
 #include "vkDevice.h"
 #include "vkRender.h"
+#include "renderThread.h"
 #include "input.h"
 #include "inputHandler.h"
+#include "threadPool.h"
+#include "jobSystem.h"
+#include "transformSystem.h"
+#include "systemScheduler.h"
+#include "renderComponents.h"
+#include "transform.h"
 
 Core::Engine Core::engine;
 
-void Core::Engine::Initialize()
+void Core::Engine::Initialize(bool headless)
 {
+	m_isHeadless = headless;
+
+	// Created first, the renderer already hands pipeline compilation to it during initialization
+	INIT_WRAPPER("thread pool", m_pThreadPool = std::make_shared<ThreadPool>());
+	// Created on the simulation thread, the render thread attaches later, both run jobs while waiting for them.
+	// The device sizes its per-thread command pools by the job system's thread count.
+	INIT_WRAPPER("job system", m_pJobSystem = std::make_shared<JobSystem>(JobSystem::DEFAULT_WORKER_COUNT, 2));
+	INIT_WRAPPER("transform system", m_pTransformSystem = std::make_shared<TransformSystem>(m_registry));
+
 	// Macro practice
-	INIT_WRAPPER("input handler", m_pInputHandler = std::make_shared<InputHandler>());
 	INIT_WRAPPER("device class",
 		{
 			m_pDevice = std::make_shared<Device>();
-			m_pDevice->Initialize();
+			m_pDevice->Initialize(m_isHeadless);
 		};);
 	INIT_WRAPPER("renderer", m_pRenderer = std::make_shared<Renderer>(m_pDevice));
-	INIT_WRAPPER("input class", 
+	INIT_WRAPPER("render thread", m_pRenderThread = std::make_shared<RenderThread>(*m_pRenderer, *m_pJobSystem));
+
+	// Input is window based, there's nothing to poll when running headless
+	if (!m_isHeadless)
+	{
+		INIT_WRAPPER("input handler", m_pInputHandler = std::make_shared<InputHandler>());
+		INIT_WRAPPER("input class",
+			{
+					std::shared_ptr<Core::Input> inputPtr(new Core::Input, Core::InputDelFunc);
+					m_pInput = inputPtr;
+			});
+	}
+
+	INIT_WRAPPER("system scheduler",
 		{
-				std::shared_ptr<Core::Input> inputPtr(new Core::Input, Core::InputDelFunc);
-				m_pInput = inputPtr;
+			m_pSystemScheduler = std::make_shared<SystemScheduler>(m_registry);
+			RegisterSystems();
 		});
 }
 
+void Core::Engine::RegisterSystems()
+{
+	if (!m_isHeadless)
+	{
+		m_pSystemScheduler->AddSystem("input handler", Reads<Camera>{}, Writes<Transform>{},
+			[this](entt::registry&, float deltaTime) { m_pInputHandler->Update(deltaTime); }, SystemPhase::INPUT);
+	}
+
+	// World matrices are final once this ran, systems reading Transform after it see them.
+	// Sorting the hierarchy reorders both storages and detaches entities whose parent is gone, so it writes both.
+	m_pSystemScheduler->AddSystem("transforms", Reads<>{}, Writes<Hierarchy, Transform>{},
+		[this](entt::registry&, float) { m_pTransformSystem->Update(*m_pJobSystem); }, SystemPhase::TRANSFORMS);
+
+	// Transform::World caches the local matrices of transforms without a parent, so it counts as writing them
+	m_pSystemScheduler->AddSystem("render extraction", Reads<Camera, MeshRenderer, Material>{}, Writes<Transform>{},
+		[this](entt::registry& registry, float)
+		{
+			FrameSnapshot& snapshot = m_pRenderThread->GetExtractionSnapshot();
+			m_pRenderer->Extract(registry, snapshot);
+
+			// The render thread may still be recording the previous frame, it picks this camera up before submitting
+			if (m_isCameraLatching)
+			{
+				m_pRenderer->LatchCamera(snapshot.m_view, snapshot.m_projection);
+			}
+		}, SystemPhase::EXTRACTION);
+}
+
 void Core::Engine::Update(float deltaTime)
 {
-	m_pInput->Update();
-	m_pInputHandler->Update(deltaTime);
-	m_pRenderer->Update();
+	// Polls the window's input state, which the input handler system reads
+	if (!m_isHeadless)
+	{
+		m_pInput->Update();
+	}
+
+	m_pSystemScheduler->Run(*m_pJobSystem, deltaTime);
 }
 
 void Core::Engine::Render()
 {
-	m_pRenderer->Render();
+	m_pRenderThread->Submit();
 }
 
 void Core::Engine::ShutDown()
 {
+	m_pRenderThread.reset(); // Renders the last submitted frame first
+	m_pSystemScheduler.reset(); // Its systems reference the other members
 	m_pInputHandler.reset(); // No dependencies
 	m_pInput.reset();
 	m_pRenderer.reset();
 	m_pDevice->ShutDown();
 	m_pDevice.reset();
+	m_pTransformSystem.reset();
+	m_pJobSystem.reset();
+	m_pThreadPool.reset();
 }
 
 const Device& Core::Engine::GetDevice() const
@@ -51,6 +116,12 @@ const Device& Core::Engine::GetDevice() const
 	return *m_pDevice.get();
 }
 
+std::shared_ptr<Device> Core::Engine::GetSharedDevice() const
+{
+	assert(m_pDevice.get() && "Device is either uninitialized or deleted");
+	return m_pDevice;
+}
+
 const Renderer& Core::Engine::GetRenderer() const
 {
 	assert(m_pRenderer.get() && "Renderer is either uninitialized or deleted");
@@ -74,3 +145,49 @@ entt::registry& Core::Engine::GetRegistry()
 {
 	return m_registry;
 }
+
+ThreadPool& Core::Engine::GetThreadPool()
+{
+	assert(m_pThreadPool.get() && "Thread pool is either uninitialized or deleted");
+	return *m_pThreadPool.get();
+}
+
+JobSystem& Core::Engine::GetJobSystem()
+{
+	assert(m_pJobSystem.get() && "Job system is either uninitialized or deleted");
+	return *m_pJobSystem.get();
+}
+
+TransformSystem& Core::Engine::GetTransformSystem()
+{
+	assert(m_pTransformSystem.get() && "Transform system is either uninitialized or deleted");
+	return *m_pTransformSystem.get();
+}
+
+SystemScheduler& Core::Engine::GetSystemScheduler()
+{
+	assert(m_pSystemScheduler.get() && "System scheduler is either uninitialized or deleted");
+	return *m_pSystemScheduler.get();
+}
+
+RenderCommandQueue& Core::Engine::GetRenderCommandQueue()
+{
+	assert(m_pRenderer.get() && "Renderer is either uninitialized or deleted");
+	return m_pRenderer->GetCommandQueue();
+}
+
+bool Core::Engine::IsHeadless() const
+{
+	return m_isHeadless;
+}
+
+void Core::Engine::SetCameraLatching(bool isLatching)
+{
+	assert(m_pRenderer.get() && "Renderer is either uninitialized or deleted");
+
+	m_isCameraLatching = isLatching;
+	if (!isLatching)
+	{
+		m_pRenderer->ClearLatchedCamera();
+	}
+}
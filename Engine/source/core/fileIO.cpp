@@ -1,5 +1,11 @@
 #include "fileIO.h"
 
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
 std::vector<char> ReadFile(const std::string& filename)
 {
 	std::ifstream file(filename, std::ios::ate | std::ios::binary);
@@ -19,3 +25,38 @@ std::vector<char> ReadFile(const std::string& filename)
 
 	return buffer;
 }
+
+void WriteBinaryFile(const std::string& filename, const void* data, size_t size)
+{
+	const std::string tempFilename = filename + ".tmp";
+
+	{
+		std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open file for writing!");
+		}
+
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+
+		if (!file.good())
+		{
+			throw std::runtime_error("Failed to write file!");
+		}
+	}
+
+	std::filesystem::rename(tempFilename, filename);
+}
+
+std::filesystem::path GetExecutablePath()
+{
+#ifdef _WIN32
+	char buffer[MAX_PATH] = { 0 };
+	GetModuleFileNameA(nullptr, buffer, MAX_PATH);
+
+	return std::filesystem::path(buffer);
+#else
+	return std::filesystem::read_symlink("/proc/self/exe");
+#endif
+}
@@ -0,0 +1,278 @@
+#include "jobSystem.h"
+
+#include <cassert>
+
+static thread_local uint32_t t_threadIndex = UINT32_MAX;
+
+bool JobCounter::IsDone()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pending == 0;
+}
+
+JobSystem::JobSystem(uint32_t workerCount, uint32_t attachedThreadCount)
+{
+	if (workerCount == DEFAULT_WORKER_COUNT)
+	{
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1u;
+	}
+
+	assert(attachedThreadCount > 0 && "The creating thread is always attached");
+
+	for (uint32_t i = 0; i < workerCount + attachedThreadCount; i++)
+	{
+		m_queues.push_back(std::make_unique<JobQueue>());
+	}
+
+	m_nextAttachedQueue = workerCount;
+	AttachThread();
+
+	m_workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	// Jobs of the attached threads' deques only run while they wait
+	while (TryRunJob())
+	{
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_isStopping = true;
+	}
+
+	m_jobAvailable.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+
+	// Only the creating thread's index can be reset, the other attached threads may already be gone
+	t_threadIndex = UINT32_MAX;
+}
+
+void JobSystem::Run(std::function<void()> job, JobCounter* pCounter)
+{
+	if (pCounter)
+	{
+		std::lock_guard<std::mutex> lock(pCounter->m_mutex);
+		pCounter->m_pending++;
+	}
+
+	Schedule({ std::move(job), pCounter });
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> job, JobCounter* pCounter)
+{
+	if (pCounter)
+	{
+		std::lock_guard<std::mutex> lock(pCounter->m_mutex);
+		pCounter->m_pending++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(dependency.m_mutex);
+		if (dependency.m_pending > 0)
+		{
+			dependency.m_continuations.push_back([this, job = std::move(job), pCounter]() mutable { Schedule({ std::move(job), pCounter }); });
+			return;
+		}
+	}
+
+	Schedule({ std::move(job), pCounter });
+}
+
+void JobSystem::AttachThread()
+{
+	assert(t_threadIndex == UINT32_MAX && "Thread is already part of a job system");
+
+	const uint32_t queueIndex = m_nextAttachedQueue.fetch_add(1);
+	assert(queueIndex < m_queues.size() && "More threads attached than the job system was created for");
+
+	t_threadIndex = queueIndex;
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	assert(t_threadIndex != UINT32_MAX && "Only the job system's threads can wait, other threads would never run the jobs of its deques");
+
+	while (!counter.IsDone())
+	{
+		if (!TryRunJob())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	std::exception_ptr exception;
+	{
+		std::lock_guard<std::mutex> lock(counter.m_mutex);
+		std::swap(exception, counter.m_exception);
+	}
+
+	if (exception)
+	{
+		std::rethrow_exception(exception);
+	}
+}
+
+uint32_t JobSystem::GetWorkerCount() const
+{
+	return static_cast<uint32_t>(m_workers.size());
+}
+
+uint32_t JobSystem::GetThreadCount() const
+{
+	return static_cast<uint32_t>(m_queues.size());
+}
+
+uint32_t JobSystem::GetThreadIndex()
+{
+	return t_threadIndex;
+}
+
+void JobSystem::WorkerLoop(uint32_t workerIndex)
+{
+	t_threadIndex = workerIndex;
+
+	while (true)
+	{
+		if (TryRunJob())
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_jobAvailable.wait(lock, [this]() { return m_isStopping || m_queuedJobs.load() > 0; });
+
+		if (m_isStopping && m_queuedJobs.load() <= 0)
+		{
+			return;
+		}
+	}
+}
+
+void JobSystem::Schedule(Job job)
+{
+	const uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+	const uint32_t queueIndex = t_threadIndex < queueCount ? t_threadIndex : m_nextQueue.fetch_add(1) % queueCount;
+
+	{
+		JobQueue& queue = *m_queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.m_mutex);
+		queue.m_jobs.push_back(std::move(job));
+	}
+
+	// Counted under the sleep mutex, a worker can't check the count and go to sleep in between
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_queuedJobs++;
+	}
+
+	m_jobAvailable.notify_one();
+}
+
+bool JobSystem::TryRunJob()
+{
+	const uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+	const uint32_t ownQueue = t_threadIndex < queueCount ? t_threadIndex : UINT32_MAX;
+
+	Job job;
+	bool hasJob = false;
+
+	// Newest job of the own deque first, its data is most likely still in the cache
+	if (ownQueue != UINT32_MAX)
+	{
+		JobQueue& queue = *m_queues[ownQueue];
+		std::lock_guard<std::mutex> lock(queue.m_mutex);
+		if (!queue.m_jobs.empty())
+		{
+			job = std::move(queue.m_jobs.back());
+			queue.m_jobs.pop_back();
+			hasJob = true;
+		}
+	}
+
+	// Oldest job of another deque, starting with the next one so thieves don't all pick the same victim
+	const uint32_t firstVictim = ownQueue != UINT32_MAX ? ownQueue + 1 : 0;
+	for (uint32_t i = 0; i < queueCount && !hasJob; i++)
+	{
+		const uint32_t victim = (firstVictim + i) % queueCount;
+		if (victim == ownQueue)
+		{
+			continue;
+		}
+
+		JobQueue& queue = *m_queues[victim];
+		std::lock_guard<std::mutex> lock(queue.m_mutex);
+		if (!queue.m_jobs.empty())
+		{
+			job = std::move(queue.m_jobs.front());
+			queue.m_jobs.pop_front();
+			hasJob = true;
+		}
+	}
+
+	if (!hasJob)
+	{
+		return false;
+	}
+
+	m_queuedJobs--;
+	Execute(job);
+
+	return true;
+}
+
+void JobSystem::Execute(Job& job)
+{
+	if (!job.m_pCounter)
+	{
+		job.m_function();
+		return;
+	}
+
+	try
+	{
+		job.m_function();
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(job.m_pCounter->m_mutex);
+		if (!job.m_pCounter->m_exception)
+		{
+			job.m_pCounter->m_exception = std::current_exception();
+		}
+	}
+
+	Finish(job.m_pCounter);
+}
+
+void JobSystem::Finish(JobCounter* pCounter)
+{
+	std::vector<std::function<void()>> continuations;
+
+	{
+		std::lock_guard<std::mutex> lock(pCounter->m_mutex);
+		assert(pCounter->m_pending > 0 && "Finished more jobs than were started with the counter");
+
+		pCounter->m_pending--;
+		if (pCounter->m_pending == 0)
+		{
+			continuations.swap(pCounter->m_continuations);
+		}
+	}
+
+	// The counter may already be destroyed here, the continuations only reference their own counters
+	for (auto& continuation : continuations)
+	{
+		continuation();
+	}
+}
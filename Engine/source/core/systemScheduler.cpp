@@ -0,0 +1,107 @@
+#include "systemScheduler.h"
+
+#include "jobSystem.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+SystemScheduler::SystemScheduler(entt::registry& registry) :
+	m_registry(registry)
+{
+}
+
+void SystemScheduler::Run(JobSystem& jobSystem, float deltaTime)
+{
+	const uint32_t systemCount = static_cast<uint32_t>(m_systems.size());
+	for (uint32_t i = 0; i < systemCount; i++)
+	{
+		m_remainingDependencies[i].store(m_systems[i].m_dependencyCount);
+	}
+
+	JobCounter counter;
+	for (uint32_t i = 0; i < systemCount; i++)
+	{
+		if (m_systems[i].m_dependencyCount == 0)
+		{
+			jobSystem.Run([this, &jobSystem, &counter, i, deltaTime]() { RunSystem(jobSystem, counter, i, deltaTime); }, &counter);
+		}
+	}
+
+	jobSystem.Wait(counter);
+}
+
+void SystemScheduler::AddSystem(SystemEntry system)
+{
+	const uint32_t index = static_cast<uint32_t>(m_systems.size());
+
+	// Edges go from the earlier to the later system in (phase, index) order, which is a total order, so the graph
+	// can't have cycles
+	for (uint32_t i = 0; i < index; i++)
+	{
+		SystemEntry& other = m_systems[i];
+		if (!Conflicts(other, system))
+		{
+			continue;
+		}
+
+		if (other.m_phase <= system.m_phase)
+		{
+			other.m_dependents.push_back(index);
+			system.m_dependencyCount++;
+		}
+		else
+		{
+			system.m_dependents.push_back(i);
+			other.m_dependencyCount++;
+		}
+	}
+
+	m_systems.push_back(std::move(system));
+	m_remainingDependencies = std::make_unique<std::atomic<uint32_t>[]>(m_systems.size());
+}
+
+bool SystemScheduler::Conflicts(const SystemEntry& lhs, const SystemEntry& rhs)
+{
+	const auto contains = [](const std::vector<entt::id_type>& types, entt::id_type type) { return std::find(types.begin(), types.end(), type) != types.end(); };
+
+	for (entt::id_type type : lhs.m_writes)
+	{
+		if (contains(rhs.m_reads, type) || contains(rhs.m_writes, type))
+		{
+			return true;
+		}
+	}
+
+	for (entt::id_type type : rhs.m_writes)
+	{
+		if (contains(lhs.m_reads, type))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void SystemScheduler::RunSystem(JobSystem& jobSystem, JobCounter& counter, uint32_t index, float deltaTime)
+{
+	const SystemEntry& system = m_systems[index];
+
+	try
+	{
+		system.m_function(m_registry, deltaTime);
+	}
+	catch (const std::exception& e)
+	{
+		throw std::runtime_error("System \"" + system.m_name + "\" failed: " + e.what());
+	}
+
+	// Queued with the frame's counter before this job finishes, so Run can't see the counter done in between
+	for (uint32_t dependent : system.m_dependents)
+	{
+		if (m_remainingDependencies[dependent].fetch_sub(1) == 1)
+		{
+			jobSystem.Run([this, &jobSystem, &counter, dependent, deltaTime]() { RunSystem(jobSystem, counter, dependent, deltaTime); }, &counter);
+		}
+	}
+}
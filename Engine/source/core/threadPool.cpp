@@ -0,0 +1,89 @@
+#include "threadPool.h"
+
+#include <algorithm>
+
+static thread_local uint32_t t_workerIndex = UINT32_MAX;
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+	}
+
+	m_workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isStopping = true;
+	}
+
+	m_jobAvailable.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return m_jobs.empty() && m_activeJobs == 0; });
+}
+
+uint32_t ThreadPool::GetThreadCount() const
+{
+	return static_cast<uint32_t>(m_workers.size());
+}
+
+uint32_t ThreadPool::GetWorkerIndex()
+{
+	return t_workerIndex;
+}
+
+void ThreadPool::WorkerLoop(uint32_t workerIndex)
+{
+	t_workerIndex = workerIndex;
+
+	while (true)
+	{
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock, [this]() { return m_isStopping || !m_jobs.empty(); });
+
+			// Remaining jobs are still drained on shutdown, their futures might be waited on
+			if (m_isStopping && m_jobs.empty())
+			{
+				return;
+			}
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop();
+			m_activeJobs++;
+		}
+
+		// Exceptions end up in the job's future (packaged_task)
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_activeJobs--;
+
+			if (m_jobs.empty() && m_activeJobs == 0)
+			{
+				m_idle.notify_all();
+			}
+		}
+	}
+}
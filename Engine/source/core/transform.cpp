@@ -2,19 +2,24 @@
 
 using namespace glm;
 
-const glm::mat4& Transform::World()
+const glm::mat4& Transform::Local()
 {
-    if (m_worldMatrixDirty)
+    if (m_localMatrixDirty)
     {
         const auto translation = glm::translate(glm::mat4(1.0f), m_translation);
         const auto rotation = glm::toMat4(m_rotation);
         const auto scale = glm::scale(glm::mat4(1.0f), m_scale);
  
-        m_worldMatrix = translation * rotation * scale;
-        m_worldMatrixDirty = false;
+        m_localMatrix = translation * rotation * scale;
+        m_localMatrixDirty = false;
     }
 
-    return m_worldMatrix;
+    return m_localMatrix;
+}
+
+const glm::mat4& Transform::World()
+{
+    return m_hasParent ? m_worldMatrix : Local();
 }
 
 void Transform::SetFromMatrix(const glm::mat4& m44)
@@ -50,5 +55,10 @@ void Transform::SetFromMatrix(const glm::mat4& m44)
 
 void Transform::SetMatrixDirty()
 {
-    m_worldMatrixDirty = true;
+    m_localMatrixDirty = true;
+    m_hasChanged = true;
+    if (m_pSubtreeChanged)
+    {
+        m_pSubtreeChanged->store(true, std::memory_order_relaxed);
+    }
 }
@@ -0,0 +1,209 @@
+#include "transformBatch.h"
+
+#include <cassert>
+
+// SSE2 is part of every x64 target, other targets only get the scalar kernel
+#if defined(_M_X64) || defined(__SSE2__)
+#define TRANSFORM_BATCH_SSE
+#include <xmmintrin.h>
+#endif
+
+uint32_t TransformBatch::Add(const glm::vec3& translation, const glm::vec3& scale, const glm::quat& rotation)
+{
+	m_translationX.push_back(translation.x);
+	m_translationY.push_back(translation.y);
+	m_translationZ.push_back(translation.z);
+
+	m_rotationX.push_back(rotation.x);
+	m_rotationY.push_back(rotation.y);
+	m_rotationZ.push_back(rotation.z);
+	m_rotationW.push_back(rotation.w);
+
+	m_scaleX.push_back(scale.x);
+	m_scaleY.push_back(scale.y);
+	m_scaleZ.push_back(scale.z);
+
+	return GetSize() - 1;
+}
+
+void TransformBatch::Reserve(uint32_t count)
+{
+	for (auto* pArray : { &m_translationX, &m_translationY, &m_translationZ, &m_rotationX, &m_rotationY, &m_rotationZ, &m_rotationW, &m_scaleX, &m_scaleY, &m_scaleZ })
+	{
+		pArray->reserve(count);
+	}
+}
+
+void TransformBatch::Clear()
+{
+	for (auto* pArray : { &m_translationX, &m_translationY, &m_translationZ, &m_rotationX, &m_rotationY, &m_rotationZ, &m_rotationW, &m_scaleX, &m_scaleY, &m_scaleZ })
+	{
+		pArray->clear();
+	}
+}
+
+void TransformBatch::SetTranslation(uint32_t index, const glm::vec3& translation)
+{
+	assert(index < GetSize() && "Transform index out of range");
+
+	m_translationX[index] = translation.x;
+	m_translationY[index] = translation.y;
+	m_translationZ[index] = translation.z;
+}
+
+void TransformBatch::SetScale(uint32_t index, const glm::vec3& scale)
+{
+	assert(index < GetSize() && "Transform index out of range");
+
+	m_scaleX[index] = scale.x;
+	m_scaleY[index] = scale.y;
+	m_scaleZ[index] = scale.z;
+}
+
+void TransformBatch::SetRotation(uint32_t index, const glm::quat& rotation)
+{
+	assert(index < GetSize() && "Transform index out of range");
+
+	m_rotationX[index] = rotation.x;
+	m_rotationY[index] = rotation.y;
+	m_rotationZ[index] = rotation.z;
+	m_rotationW[index] = rotation.w;
+}
+
+glm::vec3 TransformBatch::GetTranslation(uint32_t index) const
+{
+	assert(index < GetSize() && "Transform index out of range");
+	return glm::vec3(m_translationX[index], m_translationY[index], m_translationZ[index]);
+}
+
+glm::vec3 TransformBatch::GetScale(uint32_t index) const
+{
+	assert(index < GetSize() && "Transform index out of range");
+	return glm::vec3(m_scaleX[index], m_scaleY[index], m_scaleZ[index]);
+}
+
+glm::quat TransformBatch::GetRotation(uint32_t index) const
+{
+	assert(index < GetSize() && "Transform index out of range");
+	return glm::quat(m_rotationW[index], m_rotationX[index], m_rotationY[index], m_rotationZ[index]);
+}
+
+uint32_t TransformBatch::GetSize() const
+{
+	return static_cast<uint32_t>(m_translationX.size());
+}
+
+void TransformBatch::ComputeWorldMatrices(glm::mat4* pMatrices) const
+{
+	const uint32_t count = GetSize();
+	uint32_t first = 0;
+
+#ifdef TRANSFORM_BATCH_SSE
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 zero = _mm_setzero_ps();
+
+	// Every lane is a transform, the lanes of a column's x, y, z and w are transposed into the columns of four
+	// matrices right before they're stored
+	for (; first + 4 <= count; first += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&m_rotationX[first]);
+		const __m128 y = _mm_loadu_ps(&m_rotationY[first]);
+		const __m128 z = _mm_loadu_ps(&m_rotationZ[first]);
+		const __m128 w = _mm_loadu_ps(&m_rotationW[first]);
+
+		const __m128 x2 = _mm_add_ps(x, x);
+		const __m128 y2 = _mm_add_ps(y, y);
+		const __m128 z2 = _mm_add_ps(z, z);
+
+		const __m128 xx = _mm_mul_ps(x, x2);
+		const __m128 yy = _mm_mul_ps(y, y2);
+		const __m128 zz = _mm_mul_ps(z, z2);
+		const __m128 xy = _mm_mul_ps(x, y2);
+		const __m128 xz = _mm_mul_ps(x, z2);
+		const __m128 yz = _mm_mul_ps(y, z2);
+		const __m128 wx = _mm_mul_ps(w, x2);
+		const __m128 wy = _mm_mul_ps(w, y2);
+		const __m128 wz = _mm_mul_ps(w, z2);
+
+		const __m128 scaleX = _mm_loadu_ps(&m_scaleX[first]);
+		const __m128 scaleY = _mm_loadu_ps(&m_scaleY[first]);
+		const __m128 scaleZ = _mm_loadu_ps(&m_scaleZ[first]);
+
+		// Rotation columns scaled by the scale of their axis
+		__m128 column0X = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), scaleX);
+		__m128 column0Y = _mm_mul_ps(_mm_add_ps(xy, wz), scaleX);
+		__m128 column0Z = _mm_mul_ps(_mm_sub_ps(xz, wy), scaleX);
+		__m128 column0W = zero;
+
+		__m128 column1X = _mm_mul_ps(_mm_sub_ps(xy, wz), scaleY);
+		__m128 column1Y = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), scaleY);
+		__m128 column1Z = _mm_mul_ps(_mm_add_ps(yz, wx), scaleY);
+		__m128 column1W = zero;
+
+		__m128 column2X = _mm_mul_ps(_mm_add_ps(xz, wy), scaleZ);
+		__m128 column2Y = _mm_mul_ps(_mm_sub_ps(yz, wx), scaleZ);
+		__m128 column2Z = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), scaleZ);
+		__m128 column2W = zero;
+
+		__m128 column3X = _mm_loadu_ps(&m_translationX[first]);
+		__m128 column3Y = _mm_loadu_ps(&m_translationY[first]);
+		__m128 column3Z = _mm_loadu_ps(&m_translationZ[first]);
+		__m128 column3W = one;
+
+		_MM_TRANSPOSE4_PS(column0X, column0Y, column0Z, column0W);
+		_MM_TRANSPOSE4_PS(column1X, column1Y, column1Z, column1W);
+		_MM_TRANSPOSE4_PS(column2X, column2Y, column2Z, column2W);
+		_MM_TRANSPOSE4_PS(column3X, column3Y, column3Z, column3W);
+
+		// After the transposes the X registers hold the first transform's columns, Y the second's, ...
+		const __m128 columns[4][4] =
+		{
+			{ column0X, column1X, column2X, column3X },
+			{ column0Y, column1Y, column2Y, column3Y },
+			{ column0Z, column1Z, column2Z, column3Z },
+			{ column0W, column1W, column2W, column3W },
+		};
+
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			glm::mat4& matrix = pMatrices[first + lane];
+			for (uint32_t column = 0; column < 4; column++)
+			{
+				_mm_storeu_ps(&matrix[column][0], columns[lane][column]);
+			}
+		}
+	}
+#endif
+
+	for (; first < count; first++)
+	{
+		ComputeWorldMatrix(first, pMatrices[first]);
+	}
+}
+
+void TransformBatch::ComputeWorldMatrix(uint32_t index, glm::mat4& matrix) const
+{
+	const float x = m_rotationX[index];
+	const float y = m_rotationY[index];
+	const float z = m_rotationZ[index];
+	const float w = m_rotationW[index];
+
+	const float xx = x * (x + x);
+	const float yy = y * (y + y);
+	const float zz = z * (z + z);
+	const float xy = x * (y + y);
+	const float xz = x * (z + z);
+	const float yz = y * (z + z);
+	const float wx = w * (x + x);
+	const float wy = w * (y + y);
+	const float wz = w * (z + z);
+
+	const float scaleX = m_scaleX[index];
+	const float scaleY = m_scaleY[index];
+	const float scaleZ = m_scaleZ[index];
+
+	matrix[0] = glm::vec4((1.f - (yy + zz)) * scaleX, (xy + wz) * scaleX, (xz - wy) * scaleX, 0.f);
+	matrix[1] = glm::vec4((xy - wz) * scaleY, (1.f - (xx + zz)) * scaleY, (yz + wx) * scaleY, 0.f);
+	matrix[2] = glm::vec4((xz + wy) * scaleZ, (yz - wx) * scaleZ, (1.f - (xx + yy)) * scaleZ, 0.f);
+	matrix[3] = glm::vec4(m_translationX[index], m_translationY[index], m_translationZ[index], 1.f);
+}
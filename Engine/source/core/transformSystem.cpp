@@ -0,0 +1,293 @@
+#include "transformSystem.h"
+
+#include "transform.h"
+#include "jobSystem.h"
+
+#include <cassert>
+
+TransformSystem::TransformSystem(entt::registry& registry) :
+	m_registry(registry)
+{
+	m_registry.on_construct<Hierarchy>().connect<&TransformSystem::OnHierarchyChanged>(*this);
+	m_registry.on_destroy<Hierarchy>().connect<&TransformSystem::OnHierarchyChanged>(*this);
+}
+
+TransformSystem::~TransformSystem()
+{
+	m_registry.on_construct<Hierarchy>().disconnect(this);
+	m_registry.on_destroy<Hierarchy>().disconnect(this);
+
+	ReleaseChangedFlags();
+}
+
+void TransformSystem::SetParent(entt::entity entity, entt::entity parent)
+{
+	assert(m_registry.all_of<Transform>(entity) && "Only entities with a Transform can be part of a hierarchy");
+
+	if (parent != entt::null)
+	{
+		assert(m_registry.valid(parent) && m_registry.all_of<Transform>(parent) && "Parent has to be an entity with a Transform");
+
+#ifndef NDEBUG
+		for (entt::entity ancestor = parent; ancestor != entt::null; )
+		{
+			assert(ancestor != entity && "Parenting an entity to its own descendant would create a cycle");
+			const Hierarchy* pHierarchy = m_registry.try_get<Hierarchy>(ancestor);
+			ancestor = pHierarchy ? pHierarchy->parent : entt::null;
+		}
+#endif
+
+		if (!m_registry.all_of<Hierarchy>(parent))
+		{
+			m_registry.emplace<Hierarchy>(parent);
+		}
+	}
+
+	m_registry.get_or_emplace<Hierarchy>(entity).parent = parent;
+	m_registry.get<Transform>(entity).m_hasChanged = true;
+
+	m_isSortDirty = true;
+}
+
+void TransformSystem::Update(JobSystem& jobSystem)
+{
+	if (m_isSortDirty)
+	{
+		SortHierarchy();
+		m_isSortDirty = false;
+	}
+
+	m_update++;
+
+	m_changedSubtrees.clear();
+	uint32_t changedTransformCount = 0;
+	for (uint32_t subtree = 0; subtree < m_subtrees.size(); subtree++)
+	{
+		if (!m_subtreeChanged[subtree].exchange(false, std::memory_order_relaxed))
+		{
+			continue;
+		}
+
+		// Large subtrees get the jobs to themselves, one level after the other
+		const uint32_t size = GetSubtreeSize(subtree);
+		if (size < MIN_TRANSFORMS_PER_JOB)
+		{
+			m_changedSubtrees.push_back(subtree);
+			changedTransformCount += size;
+			continue;
+		}
+
+		const Subtree& range = m_subtrees[subtree];
+		for (uint32_t level = range.m_firstLevel; level < range.m_firstLevel + range.m_levelCount; level++)
+		{
+			const uint32_t begin = m_levelOffsets[level];
+			const uint32_t end = m_levelOffsets[level + 1];
+
+			jobSystem.ParallelFor(end - begin, MIN_TRANSFORMS_PER_JOB, [this, begin](uint32_t jobBegin, uint32_t jobEnd) { UpdateRange(begin + jobBegin, begin + jobEnd); });
+		}
+	}
+
+	if (m_changedSubtrees.empty())
+	{
+		return;
+	}
+
+	// Small subtrees don't depend on each other, each job takes whole subtrees
+	const uint32_t subtreeCount = static_cast<uint32_t>(m_changedSubtrees.size());
+	const uint32_t minSubtreesPerJob = static_cast<uint32_t>(static_cast<uint64_t>(MIN_TRANSFORMS_PER_JOB) * subtreeCount / changedTransformCount);
+	jobSystem.ParallelFor(subtreeCount, minSubtreesPerJob, [this](uint32_t jobBegin, uint32_t jobEnd)
+		{
+			for (uint32_t i = jobBegin; i < jobEnd; i++)
+			{
+				UpdateSubtree(m_changedSubtrees[i]);
+			}
+		});
+}
+
+void TransformSystem::OnHierarchyChanged(entt::registry& registry, entt::entity entity)
+{
+	m_isSortDirty = true;
+
+	// Removing the Hierarchy makes the transform a root again, its world matrix is its local one
+	if (Transform* pTransform = registry.try_get<Transform>(entity))
+	{
+		pTransform->m_hasParent = false;
+		pTransform->m_hasChanged = true;
+		pTransform->m_pSubtreeChanged = nullptr;
+	}
+}
+
+void TransformSystem::SortHierarchy()
+{
+	auto& hierarchies = m_registry.storage<Hierarchy>();
+
+	for (auto [entity, hierarchy] : hierarchies.each())
+	{
+		hierarchy.depth = UINT32_MAX;
+	}
+
+	for (auto [entity, hierarchy] : hierarchies.each())
+	{
+		ComputeDepth(entity);
+	}
+
+	std::vector<entt::entity> roots;
+	for (auto [entity, hierarchy] : hierarchies.each())
+	{
+		const size_t index = entt::to_entity(entity);
+		if (roots.size() <= index)
+		{
+			roots.resize(index + 1, entt::null);
+		}
+	}
+
+	for (auto [entity, hierarchy] : hierarchies.each())
+	{
+		FindRoot(entity, roots);
+	}
+
+	// Every subtree ends up in one range with parents in front of their children, the transforms are put in the
+	// same order so the update reads both storages front to back
+	m_registry.sort<Hierarchy>([&roots, &hierarchies](const entt::entity lhs, const entt::entity rhs)
+		{
+			const auto lhsRoot = entt::to_entity(roots[entt::to_entity(lhs)]);
+			const auto rhsRoot = entt::to_entity(roots[entt::to_entity(rhs)]);
+			return lhsRoot != rhsRoot ? lhsRoot < rhsRoot : hierarchies.get(lhs).depth < hierarchies.get(rhs).depth;
+		});
+	m_registry.sort<Transform, Hierarchy>();
+
+	m_sortedEntities.clear();
+	m_levelOffsets.clear();
+	m_subtrees.clear();
+	entt::entity currentRoot = entt::null;
+	uint32_t currentDepth = 0;
+	for (auto [entity, hierarchy] : hierarchies.each())
+	{
+		const entt::entity root = roots[entt::to_entity(entity)];
+		if (root != currentRoot)
+		{
+			m_subtrees.push_back({ static_cast<uint32_t>(m_levelOffsets.size()), 0 });
+			currentRoot = root;
+			currentDepth = UINT32_MAX;
+		}
+
+		if (hierarchy.depth != currentDepth)
+		{
+			m_levelOffsets.push_back(static_cast<uint32_t>(m_sortedEntities.size()));
+			m_subtrees.back().m_levelCount++;
+			currentDepth = hierarchy.depth;
+		}
+
+		m_sortedEntities.push_back(entity);
+	}
+	m_levelOffsets.push_back(static_cast<uint32_t>(m_sortedEntities.size()));
+
+	while (m_subtreeChanged.size() < m_subtrees.size())
+	{
+		m_subtreeChanged.emplace_back(false);
+	}
+
+	// Subtrees are formed anew, every one of them is updated once to pick up what changed before the sort
+	for (uint32_t subtree = 0; subtree < m_subtrees.size(); subtree++)
+	{
+		m_subtreeChanged[subtree].store(true, std::memory_order_relaxed);
+
+		const Subtree& range = m_subtrees[subtree];
+		for (uint32_t i = m_levelOffsets[range.m_firstLevel]; i < m_levelOffsets[range.m_firstLevel + range.m_levelCount]; i++)
+		{
+			const entt::entity entity = m_sortedEntities[i];
+			Transform& transform = m_registry.get<Transform>(entity);
+			transform.m_hasParent = hierarchies.get(entity).parent != entt::null;
+			transform.m_pSubtreeChanged = &m_subtreeChanged[subtree];
+		}
+	}
+}
+
+uint32_t TransformSystem::ComputeDepth(entt::entity entity)
+{
+	Hierarchy& hierarchy = m_registry.get<Hierarchy>(entity);
+	if (hierarchy.depth != UINT32_MAX)
+	{
+		return hierarchy.depth;
+	}
+
+	assert(m_registry.all_of<Transform>(entity) && "Entities in a hierarchy need a Transform");
+
+	// The parent was destroyed or left the hierarchy, the entity is detached and keeps its local transform
+	if (hierarchy.parent != entt::null && !(m_registry.valid(hierarchy.parent) && m_registry.all_of<Hierarchy>(hierarchy.parent)))
+	{
+		hierarchy.parent = entt::null;
+		m_registry.get<Transform>(entity).m_hasChanged = true;
+	}
+
+	hierarchy.depth = hierarchy.parent == entt::null ? 0 : ComputeDepth(hierarchy.parent) + 1;
+	return hierarchy.depth;
+}
+
+entt::entity TransformSystem::FindRoot(entt::entity entity, std::vector<entt::entity>& roots)
+{
+	entt::entity& root = roots[entt::to_entity(entity)];
+	if (root == entt::null)
+	{
+		// ComputeDepth already detached entities whose parent left the hierarchy
+		const entt::entity parent = m_registry.get<Hierarchy>(entity).parent;
+		root = parent == entt::null ? entity : FindRoot(parent, roots);
+	}
+	return root;
+}
+
+void TransformSystem::UpdateRange(uint32_t begin, uint32_t end)
+{
+	auto& transforms = m_registry.storage<Transform>();
+	const auto& hierarchies = m_registry.storage<Hierarchy>();
+
+	for (uint32_t i = begin; i < end; i++)
+	{
+		const entt::entity entity = m_sortedEntities[i];
+		Transform& transform = transforms.get(entity);
+		const Hierarchy& hierarchy = hierarchies.get(entity);
+
+		if (hierarchy.parent == entt::null)
+		{
+			// Roots' world matrices are their local ones, computed here so children on other threads only read
+			if (transform.m_hasChanged)
+			{
+				transform.m_worldMatrix = transform.Local();
+				transform.m_worldUpdate = m_update;
+				transform.m_hasChanged = false;
+			}
+			continue;
+		}
+
+		const Transform& parent = transforms.get(hierarchy.parent);
+		if (!transform.m_hasChanged && parent.m_worldUpdate != m_update)
+		{
+			continue;
+		}
+
+		transform.m_worldMatrix = parent.m_worldMatrix * transform.Local();
+		transform.m_worldUpdate = m_update;
+		transform.m_hasChanged = false;
+	}
+}
+
+void TransformSystem::UpdateSubtree(uint32_t subtree)
+{
+	// Levels are stored one after the other, the whole subtree is a single range in depth order
+	const Subtree& range = m_subtrees[subtree];
+	UpdateRange(m_levelOffsets[range.m_firstLevel], m_levelOffsets[range.m_firstLevel + range.m_levelCount]);
+}
+
+uint32_t TransformSystem::GetSubtreeSize(uint32_t subtree) const
+{
+	const Subtree& range = m_subtrees[subtree];
+	return m_levelOffsets[range.m_firstLevel + range.m_levelCount] - m_levelOffsets[range.m_firstLevel];
+}
+
+void TransformSystem::ReleaseChangedFlags()
+{
+	for (auto [entity, hierarchy, transform] : m_registry.view<Hierarchy, Transform>().each())
+	{
+		transform.m_pSubtreeChanged = nullptr;
+	}
+}
@@ -0,0 +1,105 @@
+#include "drawList.h"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+
+uint64_t DrawSortKey::Make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint16_t depth)
+{
+	assert(pass < (1u << PASS_BITS) && "Pass doesn't fit into the sort key");
+	assert(pipeline < (1u << PIPELINE_BITS) && "Pipeline id doesn't fit into the sort key");
+	assert(material < (1u << MATERIAL_BITS) && "Material id doesn't fit into the sort key");
+	assert(mesh < (1u << MESH_BITS) && "Mesh id doesn't fit into the sort key");
+
+	return (static_cast<uint64_t>(pass) << PASS_SHIFT) |
+		(static_cast<uint64_t>(pipeline) << PIPELINE_SHIFT) |
+		(static_cast<uint64_t>(material) << MATERIAL_SHIFT) |
+		(static_cast<uint64_t>(mesh) << MESH_SHIFT) |
+		depth;
+}
+
+uint16_t DrawSortKey::QuantizeDepth(float viewDepth)
+{
+	if (!(viewDepth > 0.f))
+	{
+		return 0;
+	}
+
+	// The bit patterns of positive floats are ordered like their values
+	uint32_t bits;
+	memcpy(&bits, &viewDepth, sizeof(bits));
+
+	return static_cast<uint16_t>(bits >> 16);
+}
+
+void DrawList::Clear()
+{
+	m_entries.clear();
+}
+
+void DrawList::Add(uint64_t key, uint32_t index)
+{
+	m_entries.push_back({ key, index });
+}
+
+void DrawList::Sort()
+{
+	constexpr uint32_t RADIX_BITS = 8;
+	constexpr uint32_t BUCKET_COUNT = 1 << RADIX_BITS;
+	constexpr uint32_t PASS_COUNT = 64 / RADIX_BITS;
+
+	const size_t count = m_entries.size();
+	if (count < 2)
+	{
+		return;
+	}
+
+	std::array<std::array<uint32_t, BUCKET_COUNT>, PASS_COUNT> histograms{};
+	for (const Entry& entry : m_entries)
+	{
+		for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+		{
+			histograms[pass][(entry.m_key >> (pass * RADIX_BITS)) & (BUCKET_COUNT - 1)]++;
+		}
+	}
+
+	m_sortBuffer.resize(count);
+
+	for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+	{
+		auto& histogram = histograms[pass];
+
+		// Every key has the same byte, this pass wouldn't change the order
+		const uint32_t firstByte = static_cast<uint32_t>(m_entries[0].m_key >> (pass * RADIX_BITS)) & (BUCKET_COUNT - 1);
+		if (histogram[firstByte] == count)
+		{
+			continue;
+		}
+
+		// Counts to the offsets each bucket starts at
+		uint32_t offset = 0;
+		for (uint32_t& bucket : histogram)
+		{
+			const uint32_t bucketCount = bucket;
+			bucket = offset;
+			offset += bucketCount;
+		}
+
+		for (const Entry& entry : m_entries)
+		{
+			m_sortBuffer[histogram[(entry.m_key >> (pass * RADIX_BITS)) & (BUCKET_COUNT - 1)]++] = entry;
+		}
+
+		m_entries.swap(m_sortBuffer);
+	}
+}
+
+const std::vector<DrawList::Entry>& DrawList::GetEntries() const
+{
+	return m_entries;
+}
+
+uint32_t DrawList::GetSize() const
+{
+	return static_cast<uint32_t>(m_entries.size());
+}
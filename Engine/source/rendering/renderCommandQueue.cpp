@@ -0,0 +1,166 @@
+#include "renderCommandQueue.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <cassert>
+#include <memory>
+
+void RenderCommand::EncodeModel(const glm::mat4& model, float* pModel)
+{
+	for (int column = 0; column < 4; column++)
+	{
+		pModel[column * 3 + 0] = model[column].x;
+		pModel[column * 3 + 1] = model[column].y;
+		pModel[column * 3 + 2] = model[column].z;
+	}
+}
+
+glm::mat4 RenderCommand::DecodeModel(const float* pModel)
+{
+	glm::mat4 model;
+	for (int column = 0; column < 4; column++)
+	{
+		model[column] = glm::vec4(pModel[column * 3 + 0], pModel[column * 3 + 1], pModel[column * 3 + 2], column == 3 ? 1.f : 0.f);
+	}
+
+	return model;
+}
+
+RenderCommandQueue::RenderCommandQueue(uint32_t capacity, uint32_t firstMeshId, uint32_t vertexCount, uint32_t indexCount) :
+	m_ring(capacity),
+	m_remainingVertices(vertexCount),
+	m_remainingIndices(indexCount),
+	m_nextMesh(firstMeshId)
+{
+}
+
+RenderCommandQueue::~RenderCommandQueue()
+{
+	// Frees the geometry of uploads that were never applied
+	Consume([](const RenderCommand&) {});
+}
+
+RenderableId RenderCommandQueue::SpawnRenderable(uint32_t mesh, const glm::mat4& model, const glm::vec4& color)
+{
+	assert(mesh < GetMeshCount() && "Renderable references a mesh that doesn't exist");
+
+	RenderCommand command{};
+	command.m_type = RenderCommandType::SPAWN_RENDERABLE;
+	command.m_target = m_nextRenderable.fetch_add(1, std::memory_order_relaxed);
+	RenderCommand::EncodeModel(model, command.m_spawn.m_model);
+	command.m_spawn.m_mesh = mesh;
+	command.m_spawn.m_color = glm::packUnorm4x8(color);
+
+	// The id is burned when the ring is full, ids are plentiful and never reused anyway
+	return m_ring.TryPush(command) ? command.m_target : INVALID_RENDERABLE;
+}
+
+bool RenderCommandQueue::DespawnRenderable(RenderableId renderable)
+{
+	if (!IsValid(renderable))
+	{
+		return false;
+	}
+
+	RenderCommand command{};
+	command.m_type = RenderCommandType::DESPAWN_RENDERABLE;
+	command.m_target = renderable;
+
+	return m_ring.TryPush(command);
+}
+
+bool RenderCommandQueue::UpdateTransform(RenderableId renderable, const glm::mat4& model)
+{
+	if (!IsValid(renderable))
+	{
+		return false;
+	}
+
+	RenderCommand command{};
+	command.m_type = RenderCommandType::UPDATE_TRANSFORM;
+	command.m_target = renderable;
+	RenderCommand::EncodeModel(model, command.m_transform.m_model);
+
+	return m_ring.TryPush(command);
+}
+
+bool RenderCommandQueue::SetColor(RenderableId renderable, const glm::vec4& color)
+{
+	if (!IsValid(renderable))
+	{
+		return false;
+	}
+
+	RenderCommand command{};
+	command.m_type = RenderCommandType::SET_COLOR;
+	command.m_target = renderable;
+	command.m_color.m_color = glm::packUnorm4x8(color);
+
+	return m_ring.TryPush(command);
+}
+
+uint32_t RenderCommandQueue::UploadMesh(std::vector<MeshVertex> vertices, std::vector<uint32_t> indices)
+{
+	if (vertices.empty() || indices.empty())
+	{
+		return INVALID_MESH;
+	}
+
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+	if (!TryReserve(m_remainingVertices, vertexCount))
+	{
+		return INVALID_MESH;
+	}
+	if (!TryReserve(m_remainingIndices, indexCount))
+	{
+		m_remainingVertices.fetch_add(vertexCount, std::memory_order_relaxed);
+		return INVALID_MESH;
+	}
+
+	auto pMesh = std::make_unique<MeshUpload>();
+	pMesh->m_vertices = std::move(vertices);
+	pMesh->m_indices = std::move(indices);
+
+	RenderCommand command{};
+	command.m_type = RenderCommandType::UPLOAD_MESH;
+	command.m_target = m_nextMesh.fetch_add(1, std::memory_order_relaxed);
+	command.m_upload.m_pMesh = pMesh.get();
+
+	// The id is burned when the ring is full, like renderable ids. Its range stays empty and draws nothing.
+	if (!m_ring.TryPush(command))
+	{
+		m_remainingVertices.fetch_add(vertexCount, std::memory_order_relaxed);
+		m_remainingIndices.fetch_add(indexCount, std::memory_order_relaxed);
+		return INVALID_MESH;
+	}
+
+	// Owned by the command now
+	pMesh.release();
+	return command.m_target;
+}
+
+bool RenderCommandQueue::IsValid(RenderableId renderable) const
+{
+	// Also rejects INVALID_RENDERABLE, the render thread would index its renderables with it
+	return renderable < m_nextRenderable.load(std::memory_order_relaxed);
+}
+
+uint32_t RenderCommandQueue::GetMeshCount() const
+{
+	return m_nextMesh.load(std::memory_order_relaxed);
+}
+
+bool RenderCommandQueue::TryReserve(std::atomic<uint32_t>& remaining, uint32_t count)
+{
+	uint32_t available = remaining.load(std::memory_order_relaxed);
+	do
+	{
+		if (count > available)
+		{
+			return false;
+		}
+	} while (!remaining.compare_exchange_weak(available, available - count, std::memory_order_relaxed));
+
+	return true;
+}
@@ -0,0 +1,101 @@
+#include "renderThread.h"
+
+#include "vkRender.h"
+#include "jobSystem.h"
+
+RenderThread::RenderThread(Renderer& renderer, JobSystem& jobSystem) :
+	m_renderer(renderer),
+	m_jobSystem(jobSystem),
+	m_thread(&RenderThread::RenderLoop, this)
+{
+}
+
+RenderThread::~RenderThread()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_frameRendered.wait(lock, [this]() { return !m_hasSubmittedFrame && !m_isRendering; });
+		m_isStopping = true;
+	}
+
+	m_frameSubmitted.notify_one();
+	m_thread.join();
+}
+
+FrameSnapshot& RenderThread::GetExtractionSnapshot()
+{
+	return m_snapshots[m_extractionIndex];
+}
+
+void RenderThread::Submit()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_frameRendered.wait(lock, [this]() { return !m_hasSubmittedFrame && !m_isRendering; });
+
+		if (m_exception)
+		{
+			std::exception_ptr exception = nullptr;
+			std::swap(exception, m_exception);
+			std::rethrow_exception(exception);
+		}
+
+		// The render thread is idle, the snapshot it rendered last is free for the next extraction
+		m_renderIndex = m_extractionIndex;
+		m_extractionIndex = 1 - m_extractionIndex;
+		m_hasSubmittedFrame = true;
+	}
+
+	m_frameSubmitted.notify_one();
+}
+
+void RenderThread::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_frameRendered.wait(lock, [this]() { return !m_hasSubmittedFrame && !m_isRendering; });
+}
+
+void RenderThread::RenderLoop()
+{
+	// Parallel recording waits for jobs and records with the command pool of its thread index
+	m_jobSystem.AttachThread();
+
+	while (true)
+	{
+		uint32_t renderIndex = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_frameSubmitted.wait(lock, [this]() { return m_hasSubmittedFrame || m_isStopping; });
+
+			if (!m_hasSubmittedFrame)
+			{
+				return;
+			}
+
+			renderIndex = m_renderIndex;
+			m_hasSubmittedFrame = false;
+			m_isRendering = true;
+		}
+
+		std::exception_ptr exception = nullptr;
+		try
+		{
+			m_renderer.Render(m_snapshots[renderIndex]);
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isRendering = false;
+			if (exception && !m_exception)
+			{
+				m_exception = exception;
+			}
+		}
+
+		m_frameRendered.notify_all();
+	}
+}
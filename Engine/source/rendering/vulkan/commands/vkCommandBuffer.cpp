@@ -1,11 +1,42 @@
 #include "vkCommandBuffer.h"
 
+#include <cstring>
+
 #define ASSERT_COMMAND_BUFFER(commandBuffer) assert(commandBuffer != VK_NULL_HANDLE && "Command buffer is not yet initialized");
 
-void CommandBuffer::BeginCommandBuffer(const VkCommandBufferBeginInfo* info) const
+// Accesses that make a barrier necessary even when the layout doesn't change
+static constexpr VkAccessFlags2 WRITE_ACCESS_MASK =
+	VK_ACCESS_2_SHADER_WRITE_BIT |
+	VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+	VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_TRANSFER_WRITE_BIT |
+	VK_ACCESS_2_HOST_WRITE_BIT |
+	VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+// Index into the tracked bind points, UINT32_MAX for the ones that aren't tracked
+static uint32_t GetBindPointIndex(VkPipelineBindPoint pipelineBindPoint)
+{
+	switch (pipelineBindPoint)
+	{
+	case VK_PIPELINE_BIND_POINT_GRAPHICS:
+		return 0;
+	case VK_PIPELINE_BIND_POINT_COMPUTE:
+		return 1;
+	default:
+		return UINT32_MAX;
+	}
+}
+
+void CommandBuffer::BeginCommandBuffer(const VkCommandBufferBeginInfo* info)
 {
 	ASSERT_COMMAND_BUFFER(m_commandBuffer);
 
+	// A reset command buffer has nothing bound, secondaries don't inherit their primary's state either
+	m_pipelineBindPoint = VK_PIPELINE_BIND_POINT_MAX_ENUM;
+	m_boundState = {};
+	m_statistics = {};
+
 	if (vkBeginCommandBuffer(m_commandBuffer, info) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to begin recording command buffer");
@@ -16,6 +47,8 @@ void CommandBuffer::EndCommandBuffer() const
 {
 	ASSERT_COMMAND_BUFFER(m_commandBuffer);
 
+	assert(m_pendingBufferBarriers.empty() && m_pendingImageBarriers.empty() && "Queued barriers were never flushed");
+
 	if (vkEndCommandBuffer(m_commandBuffer) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to record command buffer");
@@ -53,43 +86,204 @@ void CommandBuffer::BindPipeline(VkPipelineBindPoint pipelineBindPoint, VkPipeli
 	ASSERT_COMMAND_BUFFER(m_commandBuffer);
 
 	m_pipelineBindPoint = pipelineBindPoint;
+
+	const uint32_t bindPointIndex = GetBindPointIndex(pipelineBindPoint);
+	const bool isTracked = bindPointIndex != UINT32_MAX;
+	if (SkipRedundant(isTracked && m_boundState.m_pipelines[bindPointIndex] == pipeline))
+	{
+		return;
+	}
+
 	vkCmdBindPipeline(m_commandBuffer, pipelineBindPoint, pipeline);
+
+	if (isTracked)
+	{
+		m_boundState.m_pipelines[bindPointIndex] = pipeline;
+	}
+
+	// Pipelines with static viewport or scissor state overwrite the dynamic state
+	if (pipelineBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS)
+	{
+		m_boundState.m_hasViewport = false;
+		m_boundState.m_hasScissor = false;
+	}
+}
+
+void CommandBuffer::Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) const
+{
+	ASSERT_COMMAND_BUFFER(m_commandBuffer);
+	assert(m_pipelineBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE && "Dispatch needs a bound compute pipeline");
+
+	vkCmdDispatch(m_commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+void CommandBuffer::DispatchIndirect(VkBuffer buffer, VkDeviceSize offset) const
+{
+	ASSERT_COMMAND_BUFFER(m_commandBuffer);
+	assert(m_pipelineBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE && "Dispatch needs a bound compute pipeline");
+
+	vkCmdDispatchIndirect(m_commandBuffer, buffer, offset);
+}
+
+uint32_t CommandBuffer::GetGroupCount(uint32_t elementCount, uint32_t groupSize)
+{
+	assert(groupSize > 0 && "Group size can't be 0");
+
+	return (elementCount + groupSize - 1) / groupSize;
+}
+
+void CommandBuffer::PushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t size, const void* pValues, uint32_t offset) const
+{
+	ASSERT_COMMAND_BUFFER(m_commandBuffer);
+
+	vkCmdPushConstants(m_commandBuffer, layout, stageFlags, offset, size, pValues);
+}
+
+void CommandBuffer::ExecuteCommands(const VkCommandBuffer* pCommandBuffers, uint32_t commandBufferCount)
+{
+	ASSERT_COMMAND_BUFFER(m_commandBuffer);
+
+	vkCmdExecuteCommands(m_commandBuffer, commandBufferCount, pCommandBuffers);
+
+	m_boundState = {};
 }
 
-void CommandBuffer::BindVertexBuffers(const VkBuffer* pBuffers, const VkDeviceSize* pOffsets, uint32_t firstBinding, uint32_t bindingCount) const
+void CommandBuffer::BindVertexBuffers(const VkBuffer* pBuffers, const VkDeviceSize* pOffsets, uint32_t firstBinding, uint32_t bindingCount)
 {
 	ASSERT_COMMAND_BUFFER(m_commandBuffer);
 
+	const bool isTracked = firstBinding + bindingCount <= MAX_TRACKED_VERTEX_BINDINGS;
+
+	bool isRedundant = isTracked;
+	for (uint32_t i = 0; i < bindingCount && isRedundant; i++)
+	{
+		isRedundant = pBuffers[i] != VK_NULL_HANDLE &&
+			m_boundState.m_vertexBuffers[firstBinding + i] == pBuffers[i] &&
+			m_boundState.m_vertexOffsets[firstBinding + i] == pOffsets[i];
+	}
+
+	if (SkipRedundant(isRedundant))
+	{
+		return;
+	}
+
 	vkCmdBindVertexBuffers(m_commandBuffer, firstBinding, bindingCount, pBuffers, pOffsets);
+
+	for (uint32_t i = 0; i < bindingCount && firstBinding + i < MAX_TRACKED_VERTEX_BINDINGS; i++)
+	{
+		m_boundState.m_vertexBuffers[firstBinding + i] = pBuffers[i];
+		m_boundState.m_vertexOffsets[firstBinding + i] = pOffsets[i];
+	}
 }
 
-void CommandBuffer::BindIndexBuffer(VkBuffer buffer, VkIndexType indexType, VkDeviceSize offset) const
+void CommandBuffer::BindIndexBuffer(VkBuffer buffer, VkIndexType indexType, VkDeviceSize offset)
 {
 	ASSERT_COMMAND_BUFFER(m_commandBuffer);
 
+	const bool isRedundant = buffer != VK_NULL_HANDLE && m_boundState.m_indexBuffer == buffer &&
+		m_boundState.m_indexOffset == offset && m_boundState.m_indexType == indexType;
+	if (SkipRedundant(isRedundant))
+	{
+		return;
+	}
+
 	vkCmdBindIndexBuffer(m_commandBuffer, buffer, offset, indexType);
+
+	m_boundState.m_indexBuffer = buffer;
+	m_boundState.m_indexOffset = offset;
+	m_boundState.m_indexType = indexType;
 }
 
-void CommandBuffer::BindDescriptorSets(VkPipelineLayout layout, const VkDescriptorSet* pDescriptorSets, uint32_t firstSet, uint32_t descriptorSetCount, uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets) const
+void CommandBuffer::BindDescriptorSets(VkPipelineLayout layout, const VkDescriptorSet* pDescriptorSets, uint32_t firstSet, uint32_t descriptorSetCount, uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets)
 {
 	ASSERT_COMMAND_BUFFER(m_commandBuffer);
 
 	assert(m_pipelineBindPoint != VK_PIPELINE_BIND_POINT_MAX_ENUM && "Pipeline bind point is not yet initialized. Call BindPipeline() before calling BindDescriptorSets()");
+
+	const uint32_t bindPointIndex = GetBindPointIndex(m_pipelineBindPoint);
+	const bool isTracked = bindPointIndex != UINT32_MAX && firstSet + descriptorSetCount <= MAX_TRACKED_DESCRIPTOR_SETS;
+
+	// Sets bound with another layout may have been disturbed, they only count as bound with the same one
+	bool isRedundant = isTracked && dynamicOffsetCount == 0;
+	for (uint32_t i = 0; i < descriptorSetCount && isRedundant; i++)
+	{
+		isRedundant = pDescriptorSets[i] != VK_NULL_HANDLE &&
+			m_boundState.m_descriptorSets[bindPointIndex][firstSet + i] == pDescriptorSets[i] &&
+			m_boundState.m_descriptorSetLayouts[bindPointIndex][firstSet + i] == layout;
+	}
+
+	if (SkipRedundant(isRedundant))
+	{
+		return;
+	}
+
 	vkCmdBindDescriptorSets(m_commandBuffer, m_pipelineBindPoint, layout, firstSet, descriptorSetCount, pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
+
+	if (bindPointIndex == UINT32_MAX)
+	{
+		return;
+	}
+
+	auto& sets = m_boundState.m_descriptorSets[bindPointIndex];
+	auto& layouts = m_boundState.m_descriptorSetLayouts[bindPointIndex];
+
+	// Sets bound with dynamic offsets are never redundant, they're only remembered as unknown
+	for (uint32_t i = 0; i < descriptorSetCount && firstSet + i < MAX_TRACKED_DESCRIPTOR_SETS; i++)
+	{
+		sets[firstSet + i] = dynamicOffsetCount == 0 ? pDescriptorSets[i] : VK_NULL_HANDLE;
+		layouts[firstSet + i] = layout;
+	}
+
+	// Binding with a layout the other sets weren't bound with may disturb them, their layouts only have to be
+	// compatible up to the set, which isn't known here
+	for (uint32_t set = 0; set < MAX_TRACKED_DESCRIPTOR_SETS; set++)
+	{
+		if (layouts[set] != layout)
+		{
+			sets[set] = VK_NULL_HANDLE;
+			layouts[set] = VK_NULL_HANDLE;
+		}
+	}
 }
 
-void CommandBuffer::SetViewPort(const VkViewport* pViewports, uint32_t firstViewport, uint32_t viewportCount) const
+void CommandBuffer::SetViewPort(const VkViewport* pViewports, uint32_t firstViewport, uint32_t viewportCount)
 {
 	ASSERT_COMMAND_BUFFER(m_commandBuffer);
 
+	const bool isTracked = firstViewport == 0 && viewportCount == 1;
+	const bool isRedundant = isTracked && m_boundState.m_hasViewport && memcmp(&m_boundState.m_viewport, pViewports, sizeof(VkViewport)) == 0;
+	if (SkipRedundant(isRedundant))
+	{
+		return;
+	}
+
 	vkCmdSetViewport(m_commandBuffer, firstViewport, viewportCount, pViewports);
+
+	m_boundState.m_hasViewport = isTracked;
+	if (isTracked)
+	{
+		m_boundState.m_viewport = pViewports[0];
+	}
 }
 
-void CommandBuffer::SetScissor(const VkRect2D* pScissors, uint32_t firstScissor, uint32_t scissorCount) const
+void CommandBuffer::SetScissor(const VkRect2D* pScissors, uint32_t firstScissor, uint32_t scissorCount)
 {
 	ASSERT_COMMAND_BUFFER(m_commandBuffer);
 
+	const bool isTracked = firstScissor == 0 && scissorCount == 1;
+	const bool isRedundant = isTracked && m_boundState.m_hasScissor && memcmp(&m_boundState.m_scissor, pScissors, sizeof(VkRect2D)) == 0;
+	if (SkipRedundant(isRedundant))
+	{
+		return;
+	}
+
 	vkCmdSetScissor(m_commandBuffer, firstScissor, scissorCount, pScissors);
+
+	m_boundState.m_hasScissor = isTracked;
+	if (isTracked)
+	{
+		m_boundState.m_scissor = pScissors[0];
+	}
 }
 
 void CommandBuffer::MemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, uint32_t memoryBarrierCount, const VkMemoryBarrier* pMemoryBarriers, VkDependencyFlags flags) const
@@ -128,6 +322,96 @@ void CommandBuffer::ImageMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipe
 		imageMemoryBarrierCount, pImageMemoryBarriers);
 }
 
+void CommandBuffer::AddBufferBarrier(const VkBufferMemoryBarrier2& barrier)
+{
+	m_pendingBufferBarriers.push_back(barrier);
+	m_pendingBufferBarriers.back().sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+}
+
+void CommandBuffer::AddImageBarrier(const VkImageMemoryBarrier2& barrier)
+{
+	m_pendingImageBarriers.push_back(barrier);
+	m_pendingImageBarriers.back().sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+}
+
+void CommandBuffer::TransitionImage(VkImage image, ImageState& state, VkImageLayout newLayout, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask, VkImageAspectFlags aspectMask, bool discardContents)
+{
+	const bool isWrite = (dstAccessMask & WRITE_ACCESS_MASK) != 0;
+	const bool isReadInSameLayout = !isWrite && !discardContents && state.m_layout == newLayout;
+
+	VkImageMemoryBarrier2 barrier{};
+	if (isReadInSameLayout)
+	{
+		// Nothing written yet, or an earlier barrier already made the write visible to this scope
+		const bool isVisible = (dstStageMask & ~state.m_readStageMask) == 0 && (dstAccessMask & ~state.m_readAccessMask) == 0;
+		if (state.m_writeStageMask == VK_PIPELINE_STAGE_2_NONE || isVisible)
+		{
+			state.m_readStageMask |= dstStageMask;
+			state.m_readAccessMask |= dstAccessMask;
+			return;
+		}
+
+		barrier.srcStageMask = state.m_writeStageMask;
+		barrier.srcAccessMask = state.m_writeAccessMask;
+	}
+	else
+	{
+		// Reads since the write only need an execution dependency, their accesses don't have to be made available
+		barrier.srcStageMask = state.m_writeStageMask | state.m_readStageMask;
+		barrier.srcAccessMask = state.m_writeAccessMask;
+	}
+
+	barrier.dstStageMask = dstStageMask;
+	barrier.dstAccessMask = dstAccessMask;
+	barrier.oldLayout = discardContents ? VK_IMAGE_LAYOUT_UNDEFINED : state.m_layout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = aspectMask;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+	AddImageBarrier(barrier);
+
+	if (isReadInSameLayout)
+	{
+		state.m_readStageMask |= dstStageMask;
+		state.m_readAccessMask |= dstAccessMask;
+		return;
+	}
+
+	// A layout transition is a write too, its result is visible to the barrier's destination scope
+	state.m_layout = newLayout;
+	state.m_writeStageMask = dstStageMask;
+	state.m_writeAccessMask = dstAccessMask & WRITE_ACCESS_MASK;
+	state.m_readStageMask = isWrite ? VK_PIPELINE_STAGE_2_NONE : dstStageMask;
+	state.m_readAccessMask = isWrite ? VK_ACCESS_2_NONE : dstAccessMask;
+}
+
+void CommandBuffer::FlushBarriers()
+{
+	ASSERT_COMMAND_BUFFER(m_commandBuffer);
+
+	if (m_pendingBufferBarriers.empty() && m_pendingImageBarriers.empty())
+	{
+		return;
+	}
+
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(m_pendingBufferBarriers.size());
+	dependencyInfo.pBufferMemoryBarriers = m_pendingBufferBarriers.data();
+	dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(m_pendingImageBarriers.size());
+	dependencyInfo.pImageMemoryBarriers = m_pendingImageBarriers.data();
+
+	vkCmdPipelineBarrier2(m_commandBuffer, &dependencyInfo);
+
+	m_pendingBufferBarriers.clear();
+	m_pendingImageBarriers.clear();
+}
+
 void CommandBuffer::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* pRegions) const
 {
 	ASSERT_COMMAND_BUFFER(m_commandBuffer);
@@ -141,3 +425,36 @@ void CommandBuffer::CopyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, VkIm
 
 	vkCmdCopyBufferToImage(m_commandBuffer, srcBuffer, dstImage, dstImageLayout, regionCount, pRegions);
 }
+
+void CommandBuffer::ResetQueryPool(VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount) const
+{
+	ASSERT_COMMAND_BUFFER(m_commandBuffer);
+
+	vkCmdResetQueryPool(m_commandBuffer, queryPool, firstQuery, queryCount);
+}
+
+void CommandBuffer::WriteTimestamp(VkPipelineStageFlagBits pipelineStage, VkQueryPool queryPool, uint32_t query) const
+{
+	ASSERT_COMMAND_BUFFER(m_commandBuffer);
+
+	vkCmdWriteTimestamp(m_commandBuffer, pipelineStage, queryPool, query);
+}
+
+const CommandBufferStatistics& CommandBuffer::GetStatistics() const
+{
+	return m_statistics;
+}
+
+bool CommandBuffer::SkipRedundant(bool isRedundant)
+{
+	if (isRedundant)
+	{
+		m_statistics.m_skippedStateCalls++;
+	}
+	else
+	{
+		m_statistics.m_issuedStateCalls++;
+	}
+
+	return isRedundant;
+}
@@ -4,16 +4,18 @@
 
 #define ASSERT_CURRENT_FRAME(currentFrame) assert(currentFrame < MAX_FRAMES_IN_FLIGHT && "currentFrame has a higher value that the maximum amount of frames in flight")
 
-CommandPool::CommandPool(VkDevice device, const QueueFamilyIndices& queueFamilyIndices) : m_device(device)
+CommandPool::CommandPool(VkDevice device, const QueueFamilyIndices& queueFamilyIndices, uint32_t recordingThreadCount) : m_device(device)
 {
 	m_currentGraphicsIndex.fill(-1);
 	m_currentTransferIndex.fill(-1);
+	m_currentComputeIndex.fill(-1);
 
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		VkCommandPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		// Reset as a whole every frame, which is cheaper than resetting buffers individually
+		poolInfo.flags = 0;
 		poolInfo.queueFamilyIndex = queueFamilyIndices.m_graphicsFamily.value();
 
 		if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_graphicsCommandPools[i]) != VK_SUCCESS)
@@ -21,7 +23,7 @@ CommandPool::CommandPool(VkDevice device, const QueueFamilyIndices& queueFamilyI
 			throw std::runtime_error("Failed to create command pool");
 		}
 #
-		poolInfo.flags |= VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 		poolInfo.queueFamilyIndex = queueFamilyIndices.m_transferFamily.value();
 
 		if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_transferCommandPools[i]) != VK_SUCCESS)
@@ -29,7 +31,24 @@ CommandPool::CommandPool(VkDevice device, const QueueFamilyIndices& queueFamilyI
 			throw std::runtime_error("Failed to create command pool");
 		}
 
-		// TODO: Compute pool
+		poolInfo.queueFamilyIndex = queueFamilyIndices.m_computeFamily.value();
+
+		if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_computeCommandPools[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create command pool");
+		}
+
+		// Secondary command buffers are recorded once per frame and thrown away on the next reset
+		poolInfo.queueFamilyIndex = queueFamilyIndices.m_graphicsFamily.value();
+
+		m_threadCommandBuffers[i].resize(recordingThreadCount);
+		for (auto& threadCommandBuffers : m_threadCommandBuffers[i])
+		{
+			if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &threadCommandBuffers.m_commandPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create command pool");
+			}
+		}
 	}
 }
 
@@ -39,6 +58,12 @@ CommandPool::~CommandPool()
 	{
 		vkDestroyCommandPool(m_device, m_graphicsCommandPools[i], nullptr);
 		vkDestroyCommandPool(m_device, m_transferCommandPools[i], nullptr);
+		vkDestroyCommandPool(m_device, m_computeCommandPools[i], nullptr);
+
+		for (const auto& threadCommandBuffers : m_threadCommandBuffers[i])
+		{
+			vkDestroyCommandPool(m_device, threadCommandBuffers.m_commandPool, nullptr);
+		}
 	}
 }
 
@@ -79,15 +104,56 @@ std::vector<CommandBuffer> CommandPool::GetOrCreateCommandBuffers(QueueType type
 	}
 }
 
+CommandBuffer CommandPool::GetOrCreateSecondaryCommandBuffer(uint32_t threadIndex, unsigned int currentFrame)
+{
+	ASSERT_CURRENT_FRAME(currentFrame);
+	assert(threadIndex < m_threadCommandBuffers[currentFrame].size() && "threadIndex is higher than the amount of recording threads");
+
+	ThreadCommandBuffers& threadCommandBuffers = m_threadCommandBuffers[currentFrame][threadIndex];
+	auto& commandBufferList = threadCommandBuffers.m_secondaryCommandBuffers;
+
+	if (threadCommandBuffers.m_usedCount == commandBufferList.size())
+	{
+		commandBufferList.emplace_back();
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = threadCommandBuffers.m_commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(m_device, &allocInfo, commandBufferList.back().GetVkPtr()) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate command buffers");
+		}
+	}
+
+	return commandBufferList[threadCommandBuffers.m_usedCount++];
+}
+
+uint32_t CommandPool::GetRecordingThreadCount() const
+{
+	return static_cast<uint32_t>(m_threadCommandBuffers[0].size());
+}
+
 void CommandPool::ResetCommandBuffers(unsigned int currentFrame)
 {
 	ASSERT_CURRENT_FRAME(currentFrame);
 
 	vkResetCommandPool(m_device, m_graphicsCommandPools[currentFrame], 0);
 	vkResetCommandPool(m_device, m_transferCommandPools[currentFrame], 0);
+	vkResetCommandPool(m_device, m_computeCommandPools[currentFrame], 0);
+
+	for (auto& threadCommandBuffers : m_threadCommandBuffers[currentFrame])
+	{
+		vkResetCommandPool(m_device, threadCommandBuffers.m_commandPool, 0);
+		threadCommandBuffers.m_usedCount = 0;
+	}
 
-	m_currentGraphicsIndex[currentFrame] = 0;
-	m_currentTransferIndex[currentFrame] = 0;
+	// GetOrCreateCommandBuffer() increments before handing out, so the first one after the reset is index 0 again
+	m_currentGraphicsIndex[currentFrame] = -1;
+	m_currentTransferIndex[currentFrame] = -1;
+	m_currentComputeIndex[currentFrame] = -1;
 }
 
 const CommandBuffer& CommandPool::CreateCommandBuffer(QueueType type, unsigned int currentFrame)
@@ -170,7 +236,8 @@ VkCommandPool CommandPool::GetVkCommandPool(QueueType type, unsigned int current
 		return m_transferCommandPools[currentFrame];
 		break;
 	case QueueType::COMPUTE:
-		throw std::runtime_error("'COMPUTE' command pool is not yet implemented");
+		return m_computeCommandPools[currentFrame];
+		break;
 	default:
 		throw std::runtime_error("Unsupported queue type specified");
 	}
@@ -188,7 +255,8 @@ std::vector<CommandBuffer>& CommandPool::GetCommandBufferList(QueueType type, un
 		return m_transferCommandBuffers[currentFrame];
 		break;
 	case QueueType::COMPUTE:
-		throw std::runtime_error("'COMPUTE' command buffers are not yet implemented");
+		return m_computeCommandBuffers[currentFrame];
+		break;
 	default:
 		throw std::runtime_error("Unsupported queue type specified");
 	}
@@ -206,7 +274,8 @@ int& CommandPool::GetCurrentIndex(QueueType type, unsigned int currentFrame)
 		return m_currentTransferIndex[currentFrame];
 		break;
 	case QueueType::COMPUTE:
-		throw std::runtime_error("'COMPUTE' index counter is not yet implemented");
+		return m_currentComputeIndex[currentFrame];
+		break;
 	default:
 		throw std::runtime_error("Unsupported queue type specified");
 	}
@@ -3,13 +3,16 @@
 #include "vkCommandPool.h"
 #include "vkCommandBuffer.h"
 
+#include "engine.h"
+#include "jobSystem.h"
+
 Queue::Queue(VkDevice device, const QueueFamilyIndices& queueFamilyIndices) :
 	m_device(device)
 {
 	m_queueFamilyIndices = queueFamilyIndices;
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { queueFamilyIndices.m_graphicsFamily.value(), queueFamilyIndices.m_presentFamily.value(), queueFamilyIndices.m_transferFamily.value() };
+	std::set<uint32_t> uniqueQueueFamilies = { queueFamilyIndices.m_graphicsFamily.value(), queueFamilyIndices.m_presentFamily.value(), queueFamilyIndices.m_transferFamily.value(), queueFamilyIndices.m_computeFamily.value() };
 
 	float queuePriority = 1.f;
 	for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -25,8 +28,11 @@ Queue::Queue(VkDevice device, const QueueFamilyIndices& queueFamilyIndices) :
 	vkGetDeviceQueue(m_device, queueFamilyIndices.m_graphicsFamily.value(), 0, &m_graphicsQueue);
 	vkGetDeviceQueue(m_device, queueFamilyIndices.m_presentFamily.value(), 0, &m_presentQueue);
 	vkGetDeviceQueue(m_device, queueFamilyIndices.m_transferFamily.value(), 0, &m_transferQueue);
+	vkGetDeviceQueue(m_device, queueFamilyIndices.m_computeFamily.value(), 0, &m_computeQueue);
 
-	m_pCommandPool = std::make_shared<CommandPool>(device, queueFamilyIndices);
+	// One pool per thread of the job system, recording jobs can run on the workers and on any attached thread
+	const uint32_t recordingThreadCount = Core::engine.GetJobSystem().GetThreadCount();
+	m_pCommandPool = std::make_shared<CommandPool>(device, queueFamilyIndices, recordingThreadCount);
 }
 
 VkQueue Queue::GetQueue(QueueType type) const
@@ -43,14 +49,18 @@ VkQueue Queue::GetQueue(QueueType type) const
 		return m_transferQueue;
 		break;
 	case QueueType::COMPUTE:
-		throw std::runtime_error("No functionality for queue type 'COMPUTE' has been implemented");
-		// TODO
+		return m_computeQueue;
 		break;
 	}
 
 	throw std::runtime_error("Undefined queue type specified");
 }
 
+const QueueFamilyIndices& Queue::GetQueueFamilyIndices() const
+{
+	return m_queueFamilyIndices;
+}
+
 std::shared_ptr<CommandPool> Queue::GetCommandPool() const
 {
 	return m_pCommandPool;
@@ -66,6 +76,16 @@ std::vector<CommandBuffer> Queue::GetOrCreateCommandBuffers(QueueType type, uint
 	return m_pCommandPool->GetOrCreateCommandBuffers(type, count, currentFrame);
 }
 
+CommandBuffer Queue::GetOrCreateSecondaryCommandBuffer(uint32_t threadIndex, unsigned int currentFrame)
+{
+	return m_pCommandPool->GetOrCreateSecondaryCommandBuffer(threadIndex, currentFrame);
+}
+
+uint32_t Queue::GetRecordingThreadCount() const
+{
+	return m_pCommandPool->GetRecordingThreadCount();
+}
+
 void Queue::ResetCommandBuffers(unsigned int currentFrame) const
 {
 	m_pCommandPool->ResetCommandBuffers(currentFrame);
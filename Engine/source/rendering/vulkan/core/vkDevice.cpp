@@ -25,18 +25,31 @@ const bool g_enableValidationLayers = false;
 const bool g_enableValidationLayers = true;
 #endif
 
-void Device::Initialize()
+void Device::Initialize(bool headless)
 {
-	m_pVkWindow = std::make_shared<Window>();
+	m_isHeadless = headless;
+
+	m_enabledDeviceExtensions = deviceExtensions;
+	if (!m_isHeadless)
+	{
+		m_enabledDeviceExtensions.insert(m_enabledDeviceExtensions.end(), presentDeviceExtensions.begin(), presentDeviceExtensions.end());
+
+		m_pVkWindow = std::make_shared<Window>();
+	}
+
 	CreateInstance();
 	InitDebugMessenger();
-	m_pSurface = std::make_unique<Surface>(m_instance, m_pVkWindow->GetWindow());
-	m_pPhysicalDevice = std::make_unique<PhysicalDevice>(m_instance, m_pSurface->GetSurface());
+
+	if (!m_isHeadless)
+	{
+		m_pSurface = std::make_unique<Surface>(m_instance, m_pVkWindow->GetWindow());
+	}
+
+	m_pPhysicalDevice = std::make_unique<PhysicalDevice>(m_instance, GetSurface());
 
 	QueueFamilyIndices indices = m_pPhysicalDevice->FindQueueFamilies(m_pPhysicalDevice->GetDevice(), GetSurface());
 
 	CreateLogicalDevice(indices);
-	m_pSwapchain = std::make_shared<Swapchain>(m_device, m_pSurface->GetSurface(), m_pVkWindow, m_pPhysicalDevice);
 	m_pQueue = std::make_shared<Queue>(m_device, indices);
 
 	VmaAllocatorCreateInfo allocatorInfo = {};
@@ -45,12 +58,22 @@ void Device::Initialize()
 	allocatorInfo.instance = m_instance;
 
 	vmaCreateAllocator(&allocatorInfo, &m_allocator);
+
+	if (m_isHeadless)
+	{
+		m_pOffscreenTarget = std::make_shared<OffscreenTarget>(m_device, m_allocator, m_pPhysicalDevice, VkExtent2D{ WIDTH, HEIGHT }, OFFSCREEN_IMAGE_COUNT);
+	}
+	else
+	{
+		m_pSwapchain = std::make_shared<Swapchain>(m_device, m_pSurface->GetSurface(), m_pVkWindow, m_pPhysicalDevice);
+	}
 }
 
 void Device::ShutDown()
 {
 	m_pQueue.reset();
 	m_pSwapchain.reset();
+	m_pOffscreenTarget.reset();
 
 	vmaDestroyAllocator(m_allocator);
 
@@ -66,7 +89,15 @@ void Device::ShutDown()
 
 	m_pVkWindow.reset();
 
-	glfwTerminate();
+	if (!m_isHeadless)
+	{
+		glfwTerminate();
+	}
+}
+
+bool Device::IsHeadless() const
+{
+	return m_isHeadless;
 }
 
 void Device::InitDebugMessenger()
@@ -148,6 +179,11 @@ VkInstance Device::GetInstance() const
 
 VkSurfaceKHR Device::GetSurface() const
 {
+	if (m_isHeadless)
+	{
+		return VK_NULL_HANDLE;
+	}
+
 	ASSERT_VK_SURFACE_CLASS(m_pSurface);
 	return m_pSurface->GetSurface();
 }
@@ -170,6 +206,22 @@ std::shared_ptr<Swapchain> Device::GetSwapchain() const
 	return m_pSwapchain;
 }
 
+std::shared_ptr<OffscreenTarget> Device::GetOffscreenTarget() const
+{
+	ASSERT_VK_RENDER_TARGET_CLASS(m_pOffscreenTarget);
+	return m_pOffscreenTarget;
+}
+
+std::shared_ptr<RenderTarget> Device::GetRenderTarget() const
+{
+	if (m_isHeadless)
+	{
+		return GetOffscreenTarget();
+	}
+
+	return GetSwapchain();
+}
+
 std::shared_ptr<Queue> Device::GetQueue() const
 {
 	ASSERT_VK_QUEUE_CLASS(m_pQueue);
@@ -178,8 +230,7 @@ std::shared_ptr<Queue> Device::GetQueue() const
 
 VkExtent2D Device::GetExtent() const
 {
-	ASSERT_VK_SWAPCHAIN_CLASS(m_pSwapchain);
-	return m_pSwapchain->GetExtent();
+	return GetRenderTarget()->GetExtent();
 }
 
 const VmaAllocator& Device::GetAllocator() const
@@ -191,7 +242,7 @@ void Device::CreateLogicalDevice(QueueFamilyIndices indices)
 {
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { indices.m_graphicsFamily.value(), indices.m_presentFamily.value(), indices.m_transferFamily.value()};
+	std::set<uint32_t> uniqueQueueFamilies = { indices.m_graphicsFamily.value(), indices.m_presentFamily.value(), indices.m_transferFamily.value(), indices.m_computeFamily.value() };
 
 	float queuePriority = 1.f;
 	for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -214,10 +265,15 @@ void Device::CreateLogicalDevice(QueueFamilyIndices indices)
 	dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
 	dynamicRenderingFeatures.pNext = nullptr;
 
+	VkPhysicalDeviceSynchronization2Features synchronization2Features{};
+	synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+	synchronization2Features.synchronization2 = VK_TRUE;
+	synchronization2Features.pNext = &dynamicRenderingFeatures;
+
 	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
 	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
 	timelineFeatures.timelineSemaphore = VK_TRUE;
-	timelineFeatures.pNext = &dynamicRenderingFeatures;
+	timelineFeatures.pNext = &synchronization2Features;
 
 	VkPhysicalDeviceShaderDemoteToHelperInvocationFeatures demoteFeature{};
 	demoteFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DEMOTE_TO_HELPER_INVOCATION_FEATURES;
@@ -234,8 +290,8 @@ void Device::CreateLogicalDevice(QueueFamilyIndices indices)
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pEnabledFeatures = nullptr;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(m_enabledDeviceExtensions.size());
+	createInfo.ppEnabledExtensionNames = m_enabledDeviceExtensions.data();
 	createInfo.pNext = &features2;
 
 	if (g_enableValidationLayers)
@@ -257,8 +313,13 @@ void Device::CreateLogicalDevice(QueueFamilyIndices indices)
 std::vector<const char*> Device::GetRequiredExtensions() const
 {
 	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	const char** glfwExtensions = nullptr;
+
+	// Surface extensions are only needed when there is a window to present to
+	if (!m_isHeadless)
+	{
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	}
 
 	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
@@ -278,7 +339,10 @@ std::vector<const char*> Device::GetRequiredExtensions() const
 	// Rids warning on MacOS, but removes compatibility with RenderDoc
 	//requiredGlfwExtensions.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
 
-	ValidateExtensionAvailability(requiredGlfwExtensions);
+	if (!requiredGlfwExtensions.empty())
+	{
+		ValidateExtensionAvailability(requiredGlfwExtensions);
+	}
 
 	return requiredGlfwExtensions;
 }
@@ -0,0 +1,94 @@
+#include "vkOffscreenTarget.h"
+
+#include "vkPhysicalDevice.h"
+
+#pragma warning(push, 0)
+#include <vma/vk_mem_alloc.h>
+#pragma warning(pop)
+
+OffscreenTarget::OffscreenTarget(VkDevice device, VmaAllocator allocator, std::shared_ptr<PhysicalDevice> physicalDevice, VkExtent2D extent, uint32_t imageCount) :
+	m_device(device), m_allocator(allocator), m_pPhysicalDevice(physicalDevice), m_extent(extent)
+{
+	assert(imageCount > 0 && "Offscreen target needs at least one image");
+
+	CreateColorResources(imageCount);
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+	for (size_t i = 0; i < m_images.size(); i++)
+	{
+		vkDestroyImageView(m_device, m_imageViews[i], nullptr);
+		vmaDestroyImage(m_allocator, m_images[i], m_allocations[i]);
+	}
+}
+
+uint32_t OffscreenTarget::AcquireNextImage()
+{
+	const uint32_t imageIndex = m_nextImage;
+	m_nextImage = (m_nextImage + 1) % static_cast<uint32_t>(m_images.size());
+
+	return imageIndex;
+}
+
+void OffscreenTarget::CreateColorResources(uint32_t imageCount)
+{
+	m_images.resize(imageCount);
+	m_allocations.resize(imageCount);
+	m_imageViews.resize(imageCount);
+
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		// Transfer source so the result can be read back (screenshots, image comparisons on CI)
+		CreateImage(m_imageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, m_images[i], m_allocations[i]);
+		m_imageViews[i] = CreateImageView(m_images[i], m_imageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+}
+
+void OffscreenTarget::CreateImage(VkFormat format, VkImageUsageFlags usage, VkImage& image, VmaAllocation& allocation) const
+{
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = m_extent.width;
+	imageInfo.extent.height = m_extent.height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = format;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = usage;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	if (vmaCreateImage(m_allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create offscreen image");
+	}
+}
+
+VkImageView OffscreenTarget::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) const
+{
+	VkImageViewCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	createInfo.image = image;
+	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	createInfo.format = format;
+	createInfo.subresourceRange.aspectMask = aspectFlags;
+	createInfo.subresourceRange.baseMipLevel = 0;
+	createInfo.subresourceRange.levelCount = 1;
+	createInfo.subresourceRange.baseArrayLayer = 0;
+	createInfo.subresourceRange.layerCount = 1;
+
+	VkImageView imageView;
+	if (vkCreateImageView(m_device, &createInfo, nullptr, &imageView) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create image view");
+	}
+
+	return imageView;
+}
@@ -5,8 +5,8 @@
 PhysicalDevice::PhysicalDevice(VkInstance instance, VkSurfaceKHR surface)
 {
 	ASSERT_VK_INSTANCE(instance);
-	assert(surface != VK_NULL_HANDLE && "Surface is either uninitialized or deleted");
 
+	// A null surface means the device is used headless, presentation support is not required then
 	PickPhysicalDevice(instance, surface);
 }
 
@@ -65,7 +65,6 @@ SwapChainSupportDetails PhysicalDevice::QuerrySwapChainSupport(VkPhysicalDevice
 QueueFamilyIndices PhysicalDevice::FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) const
 {
 	assert(device != VK_NULL_HANDLE && "Specified physical device is null");
-	assert(surface != VK_NULL_HANDLE && "Window surface is either uninitialized or deleted");
 
 	QueueFamilyIndices indices;
 
@@ -78,17 +77,26 @@ QueueFamilyIndices PhysicalDevice::FindQueueFamilies(VkPhysicalDevice device, Vk
 	int i = 0;
 	for (const auto& property : queueFamilyProperties)
 	{
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-
-		if (presentSupport)
+		if (surface != VK_NULL_HANDLE)
 		{
-			indices.m_presentFamily = i;
+			VkBool32 presentSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+
+			if (presentSupport)
+			{
+				indices.m_presentFamily = i;
+			}
 		}
 
 		if (property.queueFlags & VK_QUEUE_GRAPHICS_BIT)
 		{
 			indices.m_graphicsFamily = i;
+
+			// Nothing gets presented when headless, so the graphics family doubles as the "present" family
+			if (surface == VK_NULL_HANDLE)
+			{
+				indices.m_presentFamily = i;
+			}
 		}
 
 		if ((property.queueFlags & VK_QUEUE_TRANSFER_BIT) && (property.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0)
@@ -96,6 +104,11 @@ QueueFamilyIndices PhysicalDevice::FindQueueFamilies(VkPhysicalDevice device, Vk
 			indices.m_transferFamily = i;
 		}
 
+		if ((property.queueFlags & VK_QUEUE_COMPUTE_BIT) && (property.queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0)
+		{
+			indices.m_computeFamily = i;
+		}
+
 		if (indices.IsComplete())
 		{
 			break;
@@ -109,6 +122,12 @@ QueueFamilyIndices PhysicalDevice::FindQueueFamilies(VkPhysicalDevice device, Vk
 		indices.m_transferFamily = indices.m_graphicsFamily;
 	}
 
+	// A graphics family always supports compute as well, compute work then shares the graphics queue
+	if (indices.m_computeFamily.has_value() == false)
+	{
+		indices.m_computeFamily = indices.m_graphicsFamily;
+	}
+
 	return indices;
 }
 
@@ -196,10 +215,11 @@ bool PhysicalDevice::IsDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surf
 {
 	QueueFamilyIndices indices = FindQueueFamilies(device, surface);
 
-	bool extensionsSupported = CheckDeviceExtensionSupport(device);
+	const bool isHeadless = surface == VK_NULL_HANDLE;
+	bool extensionsSupported = CheckDeviceExtensionSupport(device, !isHeadless);
 
-	bool swapChainAdequate = false;
-	if (extensionsSupported)
+	bool swapChainAdequate = isHeadless;
+	if (extensionsSupported && !isHeadless)
 	{
 		SwapChainSupportDetails swapChainSupport = QuerrySwapChainSupport(device, surface);
 		swapChainAdequate = !swapChainSupport.m_formats.empty() && !swapChainSupport.m_presentModes.empty();
@@ -211,7 +231,7 @@ bool PhysicalDevice::IsDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surf
 	return indices.IsComplete() && extensionsSupported && swapChainAdequate && features.samplerAnisotropy;
 }
 
-bool PhysicalDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device) const
+bool PhysicalDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device, bool requirePresentation) const
 {
 	uint32_t extensionCount;
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -220,6 +240,10 @@ bool PhysicalDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device) const
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
 	std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	if (requirePresentation)
+	{
+		requiredExtensions.insert(presentDeviceExtensions.begin(), presentDeviceExtensions.end());
+	}
 
 	for (const auto& extension : availableExtensions) {
 		requiredExtensions.erase(extension.extensionName);
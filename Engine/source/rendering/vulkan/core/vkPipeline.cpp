@@ -5,6 +5,72 @@
 #include "vkDevice.h"
 
 #include "vkPipelineCache.h"
+#include "vkShaderReflection.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+void PipelineKey::Write(float value)
+{
+	// -0 and +0 describe the same state
+	if (value == 0.f)
+	{
+		value = 0.f;
+	}
+
+	WriteBytes(&value, sizeof(value));
+}
+
+void PipelineKey::Write(const char* string)
+{
+	const uint32_t length = string ? static_cast<uint32_t>(strlen(string)) : 0;
+
+	Write(length);
+	WriteBytes(string, length);
+}
+
+void PipelineKey::WriteBytes(const void* data, size_t size)
+{
+	assert(!m_isFinalized && "Pipeline key is already finalized");
+
+	if (size > PIPELINE_KEY_CAPACITY - m_size)
+	{
+		throw std::runtime_error("Pipeline state doesn't fit into a PipelineKey, raise PIPELINE_KEY_CAPACITY");
+	}
+
+	memcpy(m_data.data() + m_size, data, size);
+	m_size += static_cast<uint32_t>(size);
+}
+
+void PipelineKey::Finalize()
+{
+	m_hash = HashBytes(m_data.data(), m_size);
+	m_isFinalized = true;
+}
+
+uint64_t PipelineKey::GetHash() const
+{
+	assert(m_isFinalized && "Pipeline key has to be finalized before it can be hashed");
+	return m_hash;
+}
+
+size_t PipelineKey::GetSize() const
+{
+	return m_size;
+}
+
+bool PipelineKey::operator==(const PipelineKey& other) const
+{
+	// The hash rejects almost every mismatch before touching the data
+	return m_hash == other.m_hash && m_size == other.m_size &&
+		memcmp(m_data.data(), other.m_data.data(), m_size) == 0;
+}
+
+bool PipelineKey::operator!=(const PipelineKey& other) const
+{
+	return !(*this == other);
+}
 
 VkPipeline Pipeline::Get() const
 {
@@ -16,6 +82,50 @@ VkPipelineLayout Pipeline::GetLayout() const
 	return m_layout;
 }
 
+PipelineHandle::PipelineHandle(std::shared_future<std::shared_ptr<Pipeline>> future, std::shared_ptr<Pipeline> fallback) :
+	m_future(std::move(future)), m_fallback(std::move(fallback)), m_pHasFailed(std::make_shared<std::atomic<bool>>(false))
+{
+}
+
+bool PipelineHandle::IsReady() const
+{
+	return m_future.valid() && m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+bool PipelineHandle::HasFailed() const
+{
+	return m_pHasFailed && m_pHasFailed->load(std::memory_order_relaxed);
+}
+
+std::shared_ptr<Pipeline> PipelineHandle::Get() const
+{
+	if (!IsReady() || HasFailed())
+	{
+		return m_fallback;
+	}
+
+	try
+	{
+		return m_future.get();
+	}
+	catch (const std::exception& e)
+	{
+		// Called every frame, the failure must not take down the draw loop over and over
+		if (!m_pHasFailed->exchange(true))
+		{
+			std::cerr << "Pipeline compilation failed, drawing with the fallback pipeline: " << e.what() << "\n";
+		}
+
+		return m_fallback;
+	}
+}
+
+std::shared_ptr<Pipeline> PipelineHandle::Wait() const
+{
+	assert(m_future.valid() && "Pipeline handle doesn't reference a pipeline request");
+	return m_future.get();
+}
+
 void GraphicsPipelineInfo::SetShader(const std::string& filename, ShaderType type)
 {
 	assert(type != ShaderType::COMPUTE && "Compute shaders are not compatible with graphics pipelines");
@@ -32,26 +142,39 @@ void GraphicsPipelineInfo::SetShader(const std::string& filename, ShaderType typ
 	}
 #endif
 
-	m_shaderStages.emplace_back();
-	m_shaderStages.back() = ShaderCache::GetOrCreateShader(filename, type);
+	const Shader shader = ShaderCache::GetOrCreateShader(filename, type);
+	m_shaderStages.push_back(shader.m_stageInfo);
+	m_shaderReflections.push_back(shader.m_pReflection);
+	m_shaderCodeHashes.push_back(shader.m_codeHash);
 }
 
 void GraphicsPipelineInfo::SetDynamicStates(const std::vector<VkDynamicState>& dynamicStates)
 {
 	assert(!dynamicStates.empty() && "Dynamic states vector is empty");
 
+	m_dynamicStates = dynamicStates;
+
 	m_dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	m_dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	m_dynamicState.pDynamicStates = dynamicStates.data();
+	m_dynamicState.dynamicStateCount = static_cast<uint32_t>(m_dynamicStates.size());
 }
 
 void GraphicsPipelineInfo::SetVertexInputState(const std::vector<VkVertexInputBindingDescription>& bindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions)
 {
+	m_bindingDescriptions = bindingDescriptions;
+	m_attributeDescriptions = attributeDescriptions;
+
 	m_vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	m_vertexInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
-	m_vertexInputState.pVertexBindingDescriptions = bindingDescriptions.data();
-	m_vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	m_vertexInputState.pVertexAttributeDescriptions = attributeDescriptions.data();
+	m_vertexInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(m_bindingDescriptions.size());
+	m_vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(m_attributeDescriptions.size());
+}
+
+void GraphicsPipelineInfo::SetVertexInputStateFromReflection()
+{
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+	GetReflection().GetVertexInput(bindingDescriptions, attributeDescriptions);
+
+	SetVertexInputState(bindingDescriptions, attributeDescriptions);
 }
 
 void GraphicsPipelineInfo::SetInputAssemblyState(VkPrimitiveTopology topology, VkBool32 primitiveRestartEnable)
@@ -89,9 +212,16 @@ void GraphicsPipelineInfo::SetMultisampleState(VkBool32 sampleShadingEnable, VkS
 	m_multisampleState.sampleShadingEnable = sampleShadingEnable;
 	m_multisampleState.rasterizationSamples = rasterizationSamples;
 	m_multisampleState.minSampleShading = minSampleShading; // Optional
-	m_multisampleState.pSampleMask = pSampleMask; // Optional
 	m_multisampleState.alphaToCoverageEnable = alphaToCoverageEnable; // Optional
 	m_multisampleState.alphaToOneEnable = alphaToOneEnable; // Optional
+
+	// One mask word per 32 samples
+	m_sampleMask.clear();
+	if (pSampleMask)
+	{
+		const uint32_t wordCount = (static_cast<uint32_t>(rasterizationSamples) + 31) / 32;
+		m_sampleMask.assign(pSampleMask, pSampleMask + wordCount);
+	}
 }
 
 void GraphicsPipelineInfo::SetColorBlendState(VkBool32 logicOpEnable, VkLogicOp logicOp, const std::vector<VkPipelineColorBlendAttachmentState>& attachments, float blendConstant1, float blendConstant2, float blendConstant3, float blendConstant4)
@@ -99,8 +229,8 @@ void GraphicsPipelineInfo::SetColorBlendState(VkBool32 logicOpEnable, VkLogicOp
 	m_colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	m_colorBlendState.logicOpEnable = logicOpEnable;
 	m_colorBlendState.logicOp = logicOp; // Optional
-	m_colorBlendState.attachmentCount = static_cast<uint32_t>(attachments.size());
-	m_colorBlendState.pAttachments = attachments.data();
+	m_colorBlendAttachments = attachments;
+	m_colorBlendState.attachmentCount = static_cast<uint32_t>(m_colorBlendAttachments.size());
 	m_colorBlendState.blendConstants[0] = blendConstant1; // Optional
 	m_colorBlendState.blendConstants[1] = blendConstant2; // Optional
 	m_colorBlendState.blendConstants[2] = blendConstant3; // Optional
@@ -123,152 +253,180 @@ void GraphicsPipelineInfo::SetDepthStencilState(VkBool32 depthTestEnable, VkBool
 
 void GraphicsPipelineInfo::SetRenderInfo(const std::vector<VkFormat>& imageFormats, VkFormat depthFormat, VkFormat StencilFormat)
 {
+	m_colorAttachmentFormats = imageFormats;
+
 	m_renderInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
-	m_renderInfo.colorAttachmentCount = static_cast<uint32_t>(imageFormats.size());
-	m_renderInfo.pColorAttachmentFormats = imageFormats.data();
+	m_renderInfo.colorAttachmentCount = static_cast<uint32_t>(m_colorAttachmentFormats.size());
 	m_renderInfo.depthAttachmentFormat = depthFormat;
 	m_renderInfo.stencilAttachmentFormat = StencilFormat;
 }
 
-std::size_t GraphicsPipelineInfo::Hash() const
+PipelineKey GraphicsPipelineInfo::BuildKey() const
 {
 	assert(m_shaderStages.size() > 0 && "No shaders are specified in this pipeline.");
 
-	std::size_t result = 0;
-
-	// Shaders
-	for (std::size_t i = 0; i < m_shaderStages.size(); ++i)
-	{
-		HashCombine(result, m_shaderStages[i].stage);
-		HashCombine(result, reinterpret_cast<std::uintptr_t>(m_shaderStages[i].module));
-		// HashCombine(result, m_shaderStages[i].pName); // I think this causes issues
-	}
-	//
-
-	// Dynamic states
-	if (m_dynamicState.dynamicStateCount > 0 && m_dynamicState.pDynamicStates)
-	{
-		std::vector<VkDynamicState> states;
-		states.reserve(m_dynamicState.dynamicStateCount);
-
-		bool isSorted = true;
-		int lastEnum = std::numeric_limits<int>::min();
+	PipelineKey key;
 
-		for (uint32_t i = 0; i < m_dynamicState.dynamicStateCount; ++i)
-		{
-			states.push_back(m_dynamicState.pDynamicStates[i]);
-
-			if (m_dynamicState.pDynamicStates[i] < lastEnum)
-			{
-				isSorted = false;
-			}
+	WriteShaderStages(key);
 
-			lastEnum = m_dynamicState.pDynamicStates[i];
-		}
-
-		if (!isSorted)
-		{
-			std::sort(states.begin(), states.end(), [](const VkDynamicState& a, const VkDynamicState& b)
-				{return static_cast<int>(a) < static_cast<int>(b); });
-		}
+	// Dynamic states, sorted so the order they were specified in doesn't matter
+	std::vector<VkDynamicState> dynamicStates = m_dynamicStates;
+	std::sort(dynamicStates.begin(), dynamicStates.end());
 
-		for (const auto& state : states)
-		{
-			HashCombine(result, state);
-		}
+	key.Write(static_cast<uint32_t>(dynamicStates.size()));
+	for (const auto state : dynamicStates)
+	{
+		key.Write(state);
 	}
 	//
 
-	// TODO: Maybe only hash the attribute and binding counts? Less expensive but also less accurate
-	// 
 	// Vertex Descriptions
-	if (m_vertexInputState.vertexAttributeDescriptionCount > 0)
+	key.Write(static_cast<uint32_t>(m_bindingDescriptions.size()));
+	for (const auto& binding : m_bindingDescriptions)
 	{
-		for (uint32_t i = 0; i < m_vertexInputState.vertexAttributeDescriptionCount; ++i)
-		{
-			HashCombine(result, m_vertexInputState.pVertexAttributeDescriptions->binding);
-			HashCombine(result, m_vertexInputState.pVertexAttributeDescriptions->location);
-			HashCombine(result, m_vertexInputState.pVertexAttributeDescriptions->format);
-			HashCombine(result, m_vertexInputState.pVertexAttributeDescriptions->offset);
-		}
+		key.Write(binding.binding);
+		key.Write(binding.stride);
+		key.Write(binding.inputRate);
 	}
 
-	if (m_vertexInputState.vertexBindingDescriptionCount > 0)
+	key.Write(static_cast<uint32_t>(m_attributeDescriptions.size()));
+	for (const auto& attribute : m_attributeDescriptions)
 	{
-		for (uint32_t i = 0; i < m_vertexInputState.vertexBindingDescriptionCount; ++i)
-		{
-			HashCombine(result, m_vertexInputState.pVertexBindingDescriptions->binding);
-			HashCombine(result, m_vertexInputState.pVertexBindingDescriptions->stride);
-			HashCombine(result, m_vertexInputState.pVertexBindingDescriptions->inputRate);
-		}
+		key.Write(attribute.location);
+		key.Write(attribute.binding);
+		key.Write(attribute.format);
+		key.Write(attribute.offset);
 	}
 	//
 
 	// Input Assembly State
-	HashCombine(result, m_inputAssemblyState.topology);
-	HashCombine(result, m_inputAssemblyState.primitiveRestartEnable);
+	key.Write(m_inputAssemblyState.topology);
+	key.Write(m_inputAssemblyState.primitiveRestartEnable);
 	//
 
 	// Viewport State
-	HashCombine(result, m_viewportState.scissorCount);
-	HashCombine(result, m_viewportState.viewportCount);
+	key.Write(m_viewportState.viewportCount);
+	key.Write(m_viewportState.scissorCount);
 	//
 
 	// Rasterization State
-	HashCombine(result, m_rasterizationState.polygonMode);
-	HashCombine(result, m_rasterizationState.cullMode);
-	HashCombine(result, m_rasterizationState.frontFace);
-	HashCombine(result, m_rasterizationState.depthBiasEnable);
+	key.Write(m_rasterizationState.depthClampEnable);
+	key.Write(m_rasterizationState.rasterizerDiscardEnable);
+	key.Write(m_rasterizationState.polygonMode);
+	key.Write(m_rasterizationState.cullMode);
+	key.Write(m_rasterizationState.frontFace);
+	key.Write(m_rasterizationState.depthBiasEnable);
+	key.Write(m_rasterizationState.depthBiasConstantFactor);
+	key.Write(m_rasterizationState.depthBiasClamp);
+	key.Write(m_rasterizationState.depthBiasSlopeFactor);
+	key.Write(m_rasterizationState.lineWidth);
 	//
 
 	// Multisample State
-	HashCombine(result, m_multisampleState.rasterizationSamples);
-	HashCombine(result, m_multisampleState.alphaToCoverageEnable);
-	HashCombine(result, m_multisampleState.alphaToOneEnable);
-	HashCombine(result, m_multisampleState.sampleShadingEnable);
+	key.Write(m_multisampleState.rasterizationSamples);
+	key.Write(m_multisampleState.sampleShadingEnable);
+	key.Write(m_multisampleState.minSampleShading);
+	key.Write(m_multisampleState.alphaToCoverageEnable);
+	key.Write(m_multisampleState.alphaToOneEnable);
+
+	key.Write(static_cast<uint32_t>(m_sampleMask.size()));
+	for (const auto mask : m_sampleMask)
+	{
+		key.Write(mask);
+	}
 	//
 
 	// Color Blend State
-	HashCombine(result, m_colorBlendState.attachmentCount);
-	HashCombine(result, m_colorBlendState.logicOpEnable);
+	key.Write(m_colorBlendState.logicOpEnable);
+	key.Write(m_colorBlendState.logicOp);
+
+	key.Write(static_cast<uint32_t>(m_colorBlendAttachments.size()));
+	for (const auto& attachment : m_colorBlendAttachments)
+	{
+		key.Write(attachment.blendEnable);
+		key.Write(attachment.srcColorBlendFactor);
+		key.Write(attachment.dstColorBlendFactor);
+		key.Write(attachment.colorBlendOp);
+		key.Write(attachment.srcAlphaBlendFactor);
+		key.Write(attachment.dstAlphaBlendFactor);
+		key.Write(attachment.alphaBlendOp);
+		key.Write(attachment.colorWriteMask);
+	}
+
+	for (const float blendConstant : m_colorBlendState.blendConstants)
+	{
+		key.Write(blendConstant);
+	}
 	//
 
 	// Depth Stencil State
-	HashCombine(result, m_depthStencilState.depthBoundsTestEnable);
-	HashCombine(result, m_depthStencilState.depthTestEnable);
-	HashCombine(result, m_depthStencilState.depthWriteEnable);
-	HashCombine(result, m_depthStencilState.stencilTestEnable);
+	key.Write(m_depthStencilState.depthTestEnable);
+	key.Write(m_depthStencilState.depthWriteEnable);
+	key.Write(m_depthStencilState.depthCompareOp);
+	key.Write(m_depthStencilState.depthBoundsTestEnable);
+	key.Write(m_depthStencilState.minDepthBounds);
+	key.Write(m_depthStencilState.maxDepthBounds);
+	key.Write(m_depthStencilState.stencilTestEnable);
+
+	for (const VkStencilOpState& stencil : { m_depthStencilState.front, m_depthStencilState.back })
+	{
+		key.Write(stencil.failOp);
+		key.Write(stencil.passOp);
+		key.Write(stencil.depthFailOp);
+		key.Write(stencil.compareOp);
+		key.Write(stencil.compareMask);
+		key.Write(stencil.writeMask);
+		key.Write(stencil.reference);
+	}
 	//
 
-	// Layout Info 
-	// (I'm pretty sure that hashing the actual layouts & push constant ranges would cause issues, 
-	// since you can have multiple identical layouts in different memory locations)
-	// TODO: Look into caching Pipeline Layouts and Push Constant ranges.
-	HashCombine(result, m_layoutInfo.setLayoutCount);
-	HashCombine(result, m_layoutInfo.pushConstantRangeCount);
-	//
+	WriteLayout(key);
 
 	// Rendering Info
-	HashCombine(result, m_renderInfo.viewMask);
-	HashCombine(result, m_renderInfo.colorAttachmentCount);
-	if (m_renderInfo.colorAttachmentCount > 0)
+	key.Write(m_renderInfo.viewMask);
+
+	key.Write(static_cast<uint32_t>(m_colorAttachmentFormats.size()));
+	for (const auto format : m_colorAttachmentFormats)
 	{
-		for (uint32_t i = 0; i < m_renderInfo.colorAttachmentCount; ++i)
-		{
-			HashCombine(result, m_renderInfo.pColorAttachmentFormats[i]);
-		}
+		key.Write(format);
 	}
-	HashCombine(result, m_renderInfo.depthAttachmentFormat);
-	HashCombine(result, m_renderInfo.stencilAttachmentFormat);
+
+	key.Write(m_renderInfo.depthAttachmentFormat);
+	key.Write(m_renderInfo.stencilAttachmentFormat);
 	//
 
-	return result;
+	key.Finalize();
+
+	return key;
+}
+
+GraphicsPipelineInfo::CreateInfoStates GraphicsPipelineInfo::GetCreateInfoStates() const
+{
+	CreateInfoStates states{};
+
+	states.m_dynamicState = m_dynamicState;
+	states.m_dynamicState.pDynamicStates = m_dynamicStates.empty() ? nullptr : m_dynamicStates.data();
+
+	states.m_vertexInputState = m_vertexInputState;
+	states.m_vertexInputState.pVertexBindingDescriptions = m_bindingDescriptions.empty() ? nullptr : m_bindingDescriptions.data();
+	states.m_vertexInputState.pVertexAttributeDescriptions = m_attributeDescriptions.empty() ? nullptr : m_attributeDescriptions.data();
+
+	states.m_multisampleState = m_multisampleState;
+	states.m_multisampleState.pSampleMask = m_sampleMask.empty() ? nullptr : m_sampleMask.data();
+
+	states.m_colorBlendState = m_colorBlendState;
+	states.m_colorBlendState.pAttachments = m_colorBlendAttachments.empty() ? nullptr : m_colorBlendAttachments.data();
+
+	states.m_renderInfo = m_renderInfo;
+	states.m_renderInfo.pColorAttachmentFormats = m_colorAttachmentFormats.empty() ? nullptr : m_colorAttachmentFormats.data();
+
+	return states;
 }
 
 Pipeline::~Pipeline()
 {
+	// The layout is owned by the PipelineLayoutCache and shared with other pipelines
 	vkDestroyPipeline(Core::engine.GetDevice().GetVkDevice(), m_pipeline, nullptr);
-	vkDestroyPipelineLayout(Core::engine.GetDevice().GetVkDevice(), m_layout, nullptr);
 }
 
 void ComputePipelineInfo::SetShader(const std::string& filename, ShaderType type)
@@ -276,50 +434,102 @@ void ComputePipelineInfo::SetShader(const std::string& filename, ShaderType type
 	assert(type == ShaderType::COMPUTE && "Only compute shaders are compatible with the compute pipeline");
 	assert(m_shaderStages.size() <= 1 && "Compute pipelines can only have a single shader");
 
-	m_shaderStages.emplace_back();
-	m_shaderStages[0] = ShaderCache::GetOrCreateShader(filename, type);
+	const Shader shader = ShaderCache::GetOrCreateShader(filename, type);
+	m_shaderStages.push_back(shader.m_stageInfo);
+	m_shaderReflections.push_back(shader.m_pReflection);
+	m_shaderCodeHashes.push_back(shader.m_codeHash);
 }
 
-std::size_t ComputePipelineInfo::Hash() const
+PipelineKey ComputePipelineInfo::BuildKey() const
 {
 	assert(m_shaderStages.size() > 0 && "No shaders are specified in this pipeline.");
 
-	std::size_t result = 0;
+	PipelineKey key;
 
-	// Shaders
-	for (std::size_t i = 0; i < m_shaderStages.size(); ++i)
-	{
-		HashCombine(result, m_shaderStages[i].stage);
-		HashCombine(result, reinterpret_cast<std::uintptr_t>(m_shaderStages[i].module));
-		// HashCombine(result, m_shaderStages[i].pName); // I think this causes issues
-	}
-	//
+	WriteShaderStages(key);
+	WriteLayout(key);
 
-	// Layout Info 
-	// (I'm pretty sure that hashing the actual layouts & push constant ranges would cause issues, 
-	// since you can have multiple identical layouts in different memory locations)
-	// TODO: Look into caching Pipeline Layouts and Push Constant ranges.
-	HashCombine(result, m_layoutInfo.setLayoutCount);
-	HashCombine(result, m_layoutInfo.pushConstantRangeCount);
-	//
+	key.Finalize();
 
-	return result;
+	return key;
 }
 
 void BasePipelineInfo::SetLayoutInfo(const std::vector<VkDescriptorSetLayout>& layouts)
 {
-	m_layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	m_layoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
-	m_layoutInfo.pSetLayouts = layouts.data();
-	m_layoutInfo.pushConstantRangeCount = 0;
-	m_layoutInfo.pPushConstantRanges = nullptr;
+	SetLayoutInfo(layouts, {});
 }
 
 void BasePipelineInfo::SetLayoutInfo(const std::vector<VkDescriptorSetLayout>& layouts, const std::vector<VkPushConstantRange>& pushConstants)
 {
+	m_setLayouts = layouts;
+	m_pushConstantRanges = pushConstants;
+
 	m_layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	m_layoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
-	m_layoutInfo.pSetLayouts = layouts.data();
-	m_layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
-	m_layoutInfo.pPushConstantRanges = pushConstants.data();
+	m_layoutInfo.setLayoutCount = static_cast<uint32_t>(m_setLayouts.size());
+	m_layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(m_pushConstantRanges.size());
+}
+
+void BasePipelineInfo::SetLayoutFromReflection()
+{
+	const ShaderReflection reflection = GetReflection();
+
+	SetLayoutInfo(reflection.CreateSetLayouts(PipelineCache::GetDescriptorLayoutCache()), reflection.GetPushConstantRanges());
+}
+
+ShaderReflection BasePipelineInfo::GetReflection() const
+{
+	assert(!m_shaderReflections.empty() && "No shaders are specified in this pipeline.");
+
+	ShaderReflection reflection;
+	for (const auto& pReflection : m_shaderReflections)
+	{
+		reflection.Merge(*pReflection);
+	}
+
+	return reflection;
+}
+
+void BasePipelineInfo::WriteShaderStages(PipelineKey& key) const
+{
+	assert(m_shaderCodeHashes.size() == m_shaderStages.size() && "Shader stages have to be specified through SetShader");
+
+	// The ShaderCache shares modules between identical SPIR-V, so the code hash identifies the module
+	key.Write(static_cast<uint32_t>(m_shaderStages.size()));
+	for (size_t i = 0; i < m_shaderStages.size(); i++)
+	{
+		const auto& shaderStage = m_shaderStages[i];
+
+		assert(!shaderStage.pSpecializationInfo && "Specialization constants are not part of the pipeline key yet");
+
+		key.Write(shaderStage.stage);
+		key.Write(m_shaderCodeHashes[i]);
+		key.Write(shaderStage.pName);
+	}
+}
+
+void BasePipelineInfo::WriteLayout(PipelineKey& key) const
+{
+	// Layouts created through the DescriptorLayoutCache share a handle when their bindings are identical
+	key.Write(static_cast<uint32_t>(m_setLayouts.size()));
+	for (const auto setLayout : m_setLayouts)
+	{
+		key.Write(setLayout);
+	}
+
+	key.Write(static_cast<uint32_t>(m_pushConstantRanges.size()));
+	for (const auto& range : m_pushConstantRanges)
+	{
+		key.Write(range.stageFlags);
+		key.Write(range.offset);
+		key.Write(range.size);
+	}
+}
+
+VkPipelineLayoutCreateInfo BasePipelineInfo::GetLayoutCreateInfo() const
+{
+	VkPipelineLayoutCreateInfo layoutInfo = m_layoutInfo;
+	layoutInfo.pSetLayouts = m_setLayouts.empty() ? nullptr : m_setLayouts.data();
+	layoutInfo.pPushConstantRanges = m_pushConstantRanges.empty() ? nullptr : m_pushConstantRanges.data();
+
+	return layoutInfo;
 }
@@ -1,53 +1,130 @@
 #include "vkPipelineCache.h"
 
 #include "fileIO.h"
+#include "hash.h"
 #include "engine.h"
 #include "vkDevice.h"
+#include "vkPhysicalDevice.h"
 #include "vkPipeline.h"
+#include "vkPipelineLayoutCache.h"
+#include "vkDescriptorLayoutCache.h"
+#include "vkShaderReflection.h"
+#include "threadPool.h"
 
 #include <algorithm>
+#include <filesystem>
+#include <cstring>
 
-VkPipelineShaderStageCreateInfo ShaderCache::GetOrCreateShader(const std::string& filename, ShaderType type)
+// Prepended to the driver's cache blob. The Vulkan header only carries vendor/device ID and the cache UUID,
+// the driver version and a checksum are added so stale or corrupted files are never handed to the driver.
+struct PipelineCacheFileHeader
 {
-	auto it = m_shaderCache.find(filename);
-	if (it != m_shaderCache.end())
+	uint32_t m_magic;
+	uint32_t m_version;
+	uint32_t m_vendorID;
+	uint32_t m_deviceID;
+	uint32_t m_driverVersion;
+	uint8_t m_pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t m_dataSize;
+	uint64_t m_dataHash;
+};
+
+static constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x43504b56; // "VKPC"
+static constexpr uint32_t PIPELINE_CACHE_VERSION = 2; // 2: checksum switched to MurmurHash64A
+
+Shader ShaderCache::GetOrCreateShader(const std::string& filename, ShaderType type)
+{
+	const auto shaderStageFlag = GetShaderStageFlag(type);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto filenameIt = m_filenameIndex.find(filename);
+	if (filenameIt != m_filenameIndex.end())
 	{
-		return it->second;
+		const Shader& shader = m_shaderCache.at(filenameIt->second).m_shader;
+
+		CheckStage(shader, shaderStageFlag, filename);
+		return shader;
 	}
-	else
+
+	const auto shaderCode = ReadFile(filename);
+
+	assert(!shaderCode.empty() && "Shader code vector is empty");
+
+	// On a collision with different code the hash is reseeded until it's unique, the code hash has to identify
+	// the code in pipeline keys too
+	uint64_t seed = 0;
+	uint64_t codeHash = HashBytes(shaderCode.data(), shaderCode.size(), seed);
+
+	auto it = m_shaderCache.find(codeHash);
+	while (it != m_shaderCache.end() && it->second.m_code != shaderCode)
 	{
-		const auto shaderCode = ReadFile(filename);
+		codeHash = HashBytes(shaderCode.data(), shaderCode.size(), ++seed);
+		it = m_shaderCache.find(codeHash);
+	}
 
-		assert(!shaderCode.empty() && "Shader code vector is empty");
+	if (it != m_shaderCache.end())
+	{
+		CheckStage(it->second.m_shader, shaderStageFlag, filename);
 
-		const auto shaderStageFlag = GetShaderStageFlag(type);
+		m_filenameIndex[filename] = codeHash;
+
+		return it->second.m_shader;
+	}
+	else
+	{
 		const VkShaderModule shaderModule = CreateShaderModule(shaderCode);
 
-		VkPipelineShaderStageCreateInfo shaderStageInfo{};
-		shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		shaderStageInfo.stage = shaderStageFlag;
-		shaderStageInfo.module = shaderModule;
-		shaderStageInfo.pName = "main";
+		Shader shader{};
+		shader.m_stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shader.m_stageInfo.stage = shaderStageFlag;
+		shader.m_stageInfo.module = shaderModule;
+		shader.m_stageInfo.pName = "main";
+		shader.m_codeHash = codeHash;
+
+		try
+		{
+			shader.m_pReflection = std::make_shared<const ShaderReflection>(ShaderReflection::Reflect(shaderCode, shaderStageFlag));
+		}
+		catch (...)
+		{
+			vkDestroyShaderModule(Core::engine.GetDevice().GetVkDevice(), shaderModule, nullptr);
+			throw;
+		}
 
-		m_shaderCache[filename] = shaderStageInfo;
+		m_shaderCache[codeHash] = { shader, shaderCode };
+		m_filenameIndex[filename] = codeHash;
 
-		return shaderStageInfo;
+		return shader;
 	}
 }
 	
 void ShaderCache::Reset()
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
 	VkDevice device = Core::engine.GetDevice().GetVkDevice();
 
-	for (auto& [key, shader] : m_shaderCache) 
+	for (auto& [key, cachedShader] : m_shaderCache) 
 	{
-		if (shader.module != VK_NULL_HANDLE)
+		const Shader& shader = cachedShader.m_shader;
+		if (shader.m_stageInfo.module != VK_NULL_HANDLE)
 		{
-			vkDestroyShaderModule(device, shader.module, nullptr);
+			vkDestroyShaderModule(device, shader.m_stageInfo.module, nullptr);
 		}
 	}
 
 	m_shaderCache.clear();
+	m_filenameIndex.clear();
+}
+
+void ShaderCache::CheckStage(const Shader& shader, VkShaderStageFlagBits stage, const std::string& filename)
+{
+	// SPIR-V names its entry points per stage, the same code can't be used as another stage
+	if (shader.m_stageInfo.stage != stage)
+	{
+		throw std::runtime_error("Shader " + filename + " is already used with a different stage");
+	}
 }
 
 VkShaderModule ShaderCache::CreateShaderModule(const std::vector<char>& code)
@@ -76,53 +153,315 @@ VkShaderStageFlagBits ShaderCache::GetShaderStageFlag(ShaderType type)
 	case ShaderType::FRAGMENT:
 		return VK_SHADER_STAGE_FRAGMENT_BIT;
 		break;
+	case ShaderType::COMPUTE:
+		return VK_SHADER_STAGE_COMPUTE_BIT;
+		break;
 	default:
 		throw std::runtime_error("Specified shader type is not yet implemented");
 		break;
 	}
 }
 
-// The hash is pretty expensive so try to call this function only in initialization, afterwards store it for reuse.
 std::shared_ptr<Pipeline> PipelineCache::GetOrCreateGraphicsPipeline(const GraphicsPipelineInfo& info)
 {
-	size_t hash = info.Hash();
+	PipelineKey key = info.BuildKey();
 
-	auto it = m_graphicsPipelineCache.find(hash);
-	if (it != m_graphicsPipelineCache.end())
+	std::shared_future<std::shared_ptr<Pipeline>> pending;
 	{
-		return it->second;
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto it = m_graphicsPipelineCache.find(key);
+		if (it != m_graphicsPipelineCache.end())
+		{
+			return it->second;
+		}
+
+		auto pendingIt = m_pendingGraphicsPipelines.find(key);
+		if (pendingIt != m_pendingGraphicsPipelines.end())
+		{
+			pending = pendingIt->second;
+		}
 	}
-	else
-	{
-		const auto pipeline = CreateGraphicsPipeline(info);
-		m_graphicsPipelineCache[hash] = pipeline;
 
-		return pipeline;
+	// Already compiling on a worker, waiting for it is cheaper than compiling it twice
+	if (pending.valid())
+	{
+		return pending.get();
 	}
+
+	// Compiled outside of the lock so other threads can keep looking up pipelines in the meantime
+	const auto pipeline = CreateGraphicsPipeline(info);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Another thread might have created the same pipeline in the meantime, keep the first one so it's shared
+	auto [it, inserted] = m_graphicsPipelineCache.emplace(key, pipeline);
+	return it->second;
 }
 
 std::shared_ptr<Pipeline> PipelineCache::GetOrCreateComputePipeline(const ComputePipelineInfo& info)
 {
-	size_t hash = info.Hash();
+	PipelineKey key = info.BuildKey();
 
-	auto it = m_computePipelineCache.find(hash);
-	if (it != m_computePipelineCache.end())
 	{
-		return it->second;
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto it = m_computePipelineCache.find(key);
+		if (it != m_computePipelineCache.end())
+		{
+			return it->second;
+		}
 	}
-	else
+
+	const auto pipeline = CreateComputePipeline(info);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto [it, inserted] = m_computePipelineCache.emplace(key, pipeline);
+	return it->second;
+}
+
+std::shared_ptr<Pipeline> PipelineCache::FindGraphicsPipeline(const PipelineKey& key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_graphicsPipelineCache.find(key);
+	return it != m_graphicsPipelineCache.end() ? it->second : nullptr;
+}
+
+PipelineHandle PipelineCache::GetOrCreateGraphicsPipelineAsync(const GraphicsPipelineInfo& info, std::shared_ptr<Pipeline> fallback)
+{
+	PipelineKey key = info.BuildKey();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_graphicsPipelineCache.find(key);
+	if (it != m_graphicsPipelineCache.end())
 	{
-		const auto pipeline = CreateComputePipeline(info);
-		m_computePipelineCache[hash] = pipeline;
+		std::promise<std::shared_ptr<Pipeline>> ready;
+		ready.set_value(it->second);
 
-		return pipeline;
+		return PipelineHandle(ready.get_future().share(), fallback);
+	}
+
+	auto pendingIt = m_pendingGraphicsPipelines.find(key);
+	if (pendingIt != m_pendingGraphicsPipelines.end())
+	{
+		return PipelineHandle(pendingIt->second, fallback);
+	}
+
+	// The job gets its own copy of the info, the caller's one is usually gone by the time it runs.
+	// The pending entry is inserted before m_mutex is released, so the job can't erase it before it exists.
+	std::shared_future<std::shared_ptr<Pipeline>> future = Core::engine.GetThreadPool().Submit([info, key]()
+		{
+			std::shared_ptr<Pipeline> pipeline;
+
+			try
+			{
+				pipeline = CreateGraphicsPipeline(info);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_pendingGraphicsPipelines.erase(key);
+				throw;
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto [it, inserted] = m_graphicsPipelineCache.emplace(key, pipeline);
+			m_pendingGraphicsPipelines.erase(key);
+
+			return it->second;
+		}).share();
+
+	m_pendingGraphicsPipelines[key] = future;
+
+	return PipelineHandle(future, fallback);
+}
+
+void PipelineCache::WaitForPendingPipelines()
+{
+	while (true)
+	{
+		std::vector<std::shared_future<std::shared_ptr<Pipeline>>> pending;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_pendingGraphicsPipelines.empty())
+			{
+				return;
+			}
+
+			for (const auto& [pendingKey, future] : m_pendingGraphicsPipelines)
+			{
+				pending.push_back(future);
+			}
+		}
+
+		// wait() instead of get(), failed compilations rethrow for whoever holds their handle
+		for (const auto& future : pending)
+		{
+			future.wait();
+		}
+	}
+}
+
+void PipelineCache::Initialize(const std::string& cacheFilename)
+{
+	assert(m_vkPipelineCache == VK_NULL_HANDLE && "Pipeline cache is already initialized");
+
+	m_cacheFilename = cacheFilename;
+
+	m_pPipelineLayoutCache = std::make_shared<PipelineLayoutCache>(Core::engine.GetDevice().GetVkDevice());
+	m_pDescriptorLayoutCache = std::make_shared<DescriptorLayoutCache>(Core::engine.GetDevice().GetVkDevice());
+
+	const auto properties = Core::engine.GetDevice().GetPhysicalDevice()->GetProperties();
+	const std::vector<char> initialData = LoadFromDisk(cacheFilename, properties);
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = initialData.size();
+	createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+	if (vkCreatePipelineCache(Core::engine.GetDevice().GetVkDevice(), &createInfo, nullptr, &m_vkPipelineCache) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create pipeline cache");
 	}
 }
 
 void PipelineCache::Reset()
 {
-	m_graphicsPipelineCache.clear();
-	m_computePipelineCache.clear();
+	WaitForPendingPipelines();
+
+	if (m_vkPipelineCache != VK_NULL_HANDLE)
+	{
+		SaveToDisk();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_graphicsPipelineCache.clear();
+		m_computePipelineCache.clear();
+	}
+
+	// Pipelines only borrow their layout, so the layouts go after the pipelines
+	m_pPipelineLayoutCache.reset();
+	m_pDescriptorLayoutCache.reset();
+
+	if (m_vkPipelineCache != VK_NULL_HANDLE)
+	{
+		vkDestroyPipelineCache(Core::engine.GetDevice().GetVkDevice(), m_vkPipelineCache, nullptr);
+		m_vkPipelineCache = VK_NULL_HANDLE;
+	}
+}
+
+PipelineLayoutCache& PipelineCache::GetPipelineLayoutCache()
+{
+	assert(m_pPipelineLayoutCache && "Pipeline cache is not initialized");
+	return *m_pPipelineLayoutCache;
+}
+
+DescriptorLayoutCache& PipelineCache::GetDescriptorLayoutCache()
+{
+	assert(m_pDescriptorLayoutCache && "Pipeline cache is not initialized");
+	return *m_pDescriptorLayoutCache;
+}
+
+void PipelineCache::SaveToDisk()
+{
+	assert(m_vkPipelineCache != VK_NULL_HANDLE && "Pipeline cache is not initialized");
+
+	const VkDevice device = Core::engine.GetDevice().GetVkDevice();
+
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(device, m_vkPipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+	{
+		return;
+	}
+
+	std::vector<char> fileData(sizeof(PipelineCacheFileHeader) + dataSize);
+	char* pCacheData = fileData.data() + sizeof(PipelineCacheFileHeader);
+
+	if (vkGetPipelineCacheData(device, m_vkPipelineCache, &dataSize, pCacheData) != VK_SUCCESS)
+	{
+		return;
+	}
+
+	const auto properties = Core::engine.GetDevice().GetPhysicalDevice()->GetProperties();
+
+	PipelineCacheFileHeader header{};
+	header.m_magic = PIPELINE_CACHE_MAGIC;
+	header.m_version = PIPELINE_CACHE_VERSION;
+	header.m_vendorID = properties.vendorID;
+	header.m_deviceID = properties.deviceID;
+	header.m_driverVersion = properties.driverVersion;
+	memcpy(header.m_pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.m_dataSize = dataSize;
+	header.m_dataHash = HashBytes(pCacheData, dataSize);
+
+	memcpy(fileData.data(), &header, sizeof(header));
+
+	// A cache that can't be written only costs compile time on the next launch
+	try
+	{
+		WriteBinaryFile(m_cacheFilename, fileData.data(), sizeof(PipelineCacheFileHeader) + dataSize);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Failed to save pipeline cache: " << e.what() << "\n";
+	}
+}
+
+std::vector<char> PipelineCache::LoadFromDisk(const std::string& cacheFilename, const VkPhysicalDeviceProperties& properties)
+{
+	std::error_code error;
+	if (!std::filesystem::exists(cacheFilename, error))
+	{
+		return {};
+	}
+
+	std::vector<char> fileData = ReadFile(cacheFilename);
+
+	if (fileData.size() < sizeof(PipelineCacheFileHeader))
+	{
+		return {};
+	}
+
+	PipelineCacheFileHeader header{};
+	memcpy(&header, fileData.data(), sizeof(header));
+
+	const char* pCacheData = fileData.data() + sizeof(PipelineCacheFileHeader);
+	const size_t dataSize = fileData.size() - sizeof(PipelineCacheFileHeader);
+
+	const bool isValid =
+		header.m_magic == PIPELINE_CACHE_MAGIC &&
+		header.m_version == PIPELINE_CACHE_VERSION &&
+		header.m_vendorID == properties.vendorID &&
+		header.m_deviceID == properties.deviceID &&
+		header.m_driverVersion == properties.driverVersion &&
+		memcmp(header.m_pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+		header.m_dataSize == dataSize &&
+		header.m_dataHash == HashBytes(pCacheData, dataSize);
+
+	// Drivers are supposed to reject incompatible data themselves, but not all of them do so gracefully
+	VkPipelineCacheHeaderVersionOne vkHeader{};
+	if (!isValid || dataSize < sizeof(vkHeader))
+	{
+		return {};
+	}
+
+	memcpy(&vkHeader, pCacheData, sizeof(vkHeader));
+
+	if (vkHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+		vkHeader.vendorID != properties.vendorID ||
+		vkHeader.deviceID != properties.deviceID ||
+		memcmp(vkHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		return {};
+	}
+
+	return std::vector<char>(pCacheData, pCacheData + dataSize);
 }
 
 std::shared_ptr<Pipeline> PipelineCache::CreateGraphicsPipeline(const GraphicsPipelineInfo& info)
@@ -131,31 +470,31 @@ std::shared_ptr<Pipeline> PipelineCache::CreateGraphicsPipeline(const GraphicsPi
 
 	std::shared_ptr<Pipeline> output = std::make_shared<Pipeline>();
 
-	if (vkCreatePipelineLayout(Core::engine.GetDevice().GetVkDevice(), &info.m_layoutInfo, nullptr, &output.get()->m_layout) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create pipeline layout");
-	}
+	const VkPipelineLayoutCreateInfo layoutInfo = info.GetLayoutCreateInfo();
+	output->m_layout = GetPipelineLayoutCache().GetOrCreatePipelineLayout(&layoutInfo);
+
+	const auto states = info.GetCreateInfoStates();
 
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 	pipelineInfo.stageCount = static_cast<uint32_t>(info.m_shaderStages.size());
 	pipelineInfo.pStages = info.m_shaderStages.data();
-	pipelineInfo.pVertexInputState = &info.m_vertexInputState;
+	pipelineInfo.pVertexInputState = &states.m_vertexInputState;
 	pipelineInfo.pInputAssemblyState = &info.m_inputAssemblyState;
 	pipelineInfo.pViewportState = &info.m_viewportState;
 	pipelineInfo.pRasterizationState = &info.m_rasterizationState;
-	pipelineInfo.pMultisampleState = &info.m_multisampleState;
+	pipelineInfo.pMultisampleState = &states.m_multisampleState;
 	pipelineInfo.pDepthStencilState = &info.m_depthStencilState;
-	pipelineInfo.pColorBlendState = &info.m_colorBlendState;
-	pipelineInfo.pDynamicState = &info.m_dynamicState;
+	pipelineInfo.pColorBlendState = &states.m_colorBlendState;
+	pipelineInfo.pDynamicState = &states.m_dynamicState;
 	pipelineInfo.layout = output->GetLayout();
 	pipelineInfo.renderPass = nullptr;
 	pipelineInfo.subpass = 0;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 	pipelineInfo.basePipelineIndex = -1; // Optional
-	pipelineInfo.pNext = &info.m_renderInfo;
+	pipelineInfo.pNext = &states.m_renderInfo;
 
-	if (vkCreateGraphicsPipelines(Core::engine.GetDevice().GetVkDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &output.get()->m_pipeline) != VK_SUCCESS)
+	if (vkCreateGraphicsPipelines(Core::engine.GetDevice().GetVkDevice(), m_vkPipelineCache, 1, &pipelineInfo, nullptr, &output.get()->m_pipeline) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create graphics pipeline");
 	}
@@ -169,10 +508,8 @@ std::shared_ptr<Pipeline> PipelineCache::CreateComputePipeline(const ComputePipe
 
 	std::shared_ptr<Pipeline> output = std::make_shared<Pipeline>();
 
-	if (vkCreatePipelineLayout(Core::engine.GetDevice().GetVkDevice(), &info.m_layoutInfo, nullptr, &output.get()->m_layout) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create pipeline layout");
-	}
+	const VkPipelineLayoutCreateInfo layoutInfo = info.GetLayoutCreateInfo();
+	output->m_layout = GetPipelineLayoutCache().GetOrCreatePipelineLayout(&layoutInfo);
 
 	VkComputePipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -181,7 +518,7 @@ std::shared_ptr<Pipeline> PipelineCache::CreateComputePipeline(const ComputePipe
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 	pipelineInfo.basePipelineIndex = -1; // Optional
 
-	if (vkCreateComputePipelines(Core::engine.GetDevice().GetVkDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &output.get()->m_pipeline))
+	if (vkCreateComputePipelines(Core::engine.GetDevice().GetVkDevice(), m_vkPipelineCache, 1, &pipelineInfo, nullptr, &output.get()->m_pipeline))
 	{
 		throw std::runtime_error("Failed to create compute pipeline");
 	}
@@ -0,0 +1,912 @@
+#include "vkRenderGraph.h"
+
+#include "vkDevice.h"
+
+#include <algorithm>
+#include <numeric>
+
+#pragma warning(push, 0)
+#include <vma/vk_mem_alloc.h>
+#pragma warning(pop)
+
+static constexpr VkAccessFlags2 WRITE_ACCESS_MASK =
+	VK_ACCESS_2_SHADER_WRITE_BIT |
+	VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+	VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_TRANSFER_WRITE_BIT |
+	VK_ACCESS_2_HOST_WRITE_BIT |
+	VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+static VkImageAspectFlags GetAspectMask(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	case VK_FORMAT_S8_UINT:
+		return VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+// PassBuilder
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::WriteColorAttachment(RenderGraphImage image, bool loadContents)
+{
+	VkAccessFlags2 accessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+	uint32_t accessType = ACCESS_WRITE | ACCESS_OVERWRITE;
+	if (loadContents)
+	{
+		accessMask |= VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;
+		accessType |= ACCESS_READ;
+	}
+
+	return AddImage(image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, accessMask,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, accessType);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::WriteDepthAttachment(RenderGraphImage image, bool loadContents)
+{
+	// The depth test reads the attachment either way, that doesn't make its earlier contents matter
+	return AddImage(image, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, loadContents ? ACCESS_READ | ACCESS_WRITE : ACCESS_WRITE | ACCESS_OVERWRITE);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::ReadDepthAttachment(RenderGraphImage image)
+{
+	return AddImage(image, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, ACCESS_READ);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::ReadTexture(RenderGraphImage image, VkPipelineStageFlags2 stageMask)
+{
+	return AddImage(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, stageMask, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+		VK_IMAGE_USAGE_SAMPLED_BIT, ACCESS_READ);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::ReadStorageImage(RenderGraphImage image, VkPipelineStageFlags2 stageMask)
+{
+	return AddImage(image, VK_IMAGE_LAYOUT_GENERAL, stageMask, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_USAGE_STORAGE_BIT, ACCESS_READ);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::WriteStorageImage(RenderGraphImage image, VkPipelineStageFlags2 stageMask)
+{
+	// Storage writes can be partial, so they never discard
+	return AddImage(image, VK_IMAGE_LAYOUT_GENERAL, stageMask, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_USAGE_STORAGE_BIT, ACCESS_WRITE);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::ReadTransfer(RenderGraphImage image)
+{
+	return AddImage(image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT, ACCESS_READ);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::WriteTransfer(RenderGraphImage image)
+{
+	return AddImage(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT, ACCESS_WRITE);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::ReadBuffer(RenderGraphBuffer buffer, VkBufferUsageFlagBits usage, VkPipelineStageFlags2 stageMask)
+{
+	VkPipelineStageFlags2 defaultStages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 accessMask = VK_ACCESS_2_NONE;
+
+	switch (usage)
+	{
+	case VK_BUFFER_USAGE_VERTEX_BUFFER_BIT:
+		defaultStages = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT;
+		accessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT;
+		break;
+	case VK_BUFFER_USAGE_INDEX_BUFFER_BIT:
+		defaultStages = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT;
+		accessMask = VK_ACCESS_2_INDEX_READ_BIT;
+		break;
+	case VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT:
+		defaultStages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+		accessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+		break;
+	case VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT:
+		defaultStages = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+		accessMask = VK_ACCESS_2_UNIFORM_READ_BIT;
+		break;
+	case VK_BUFFER_USAGE_STORAGE_BUFFER_BIT:
+		defaultStages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+		break;
+	case VK_BUFFER_USAGE_TRANSFER_SRC_BIT:
+		defaultStages = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+		accessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+		break;
+	default:
+		throw std::runtime_error("Render graph buffers can't be read through this usage");
+	}
+
+	return AddBuffer(buffer, stageMask != VK_PIPELINE_STAGE_2_NONE ? stageMask : defaultStages, accessMask, usage, ACCESS_READ);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::WriteBuffer(RenderGraphBuffer buffer, VkBufferUsageFlagBits usage, VkPipelineStageFlags2 stageMask)
+{
+	VkPipelineStageFlags2 defaultStages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 accessMask = VK_ACCESS_2_NONE;
+
+	switch (usage)
+	{
+	case VK_BUFFER_USAGE_STORAGE_BUFFER_BIT:
+		defaultStages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		accessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+		break;
+	case VK_BUFFER_USAGE_TRANSFER_DST_BIT:
+		defaultStages = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+		accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		break;
+	default:
+		throw std::runtime_error("Render graph buffers can't be written through this usage");
+	}
+
+	return AddBuffer(buffer, stageMask != VK_PIPELINE_STAGE_2_NONE ? stageMask : defaultStages, accessMask, usage, ACCESS_WRITE);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::SetSideEffects()
+{
+	m_graph.m_passes[m_passIndex].m_hasSideEffects = true;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::AddImage(RenderGraphImage image, VkImageLayout layout, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask,
+	VkImageUsageFlags usage, uint32_t accessType)
+{
+	assert(image.m_index < m_graph.m_images.size() && "Invalid render graph image");
+
+	m_graph.m_images[image.m_index].m_usage |= usage;
+
+	auto& accesses = m_graph.m_passes[m_passIndex].m_images;
+	const auto it = std::find_if(accesses.begin(), accesses.end(), [&](const ResourceAccess& access) { return access.m_resource == image.m_index; });
+	if (it == accesses.end())
+	{
+		accesses.push_back({ image.m_index, layout, stageMask, accessMask, accessType });
+		return *this;
+	}
+
+	// An image has a single layout for the whole pass
+	if (it->m_layout != layout)
+	{
+		throw std::runtime_error("Render graph pass uses an image in two different layouts");
+	}
+
+	it->m_stageMask |= stageMask;
+	it->m_accessMask |= accessMask;
+	it->m_type |= accessType;
+	if (it->m_type & ACCESS_READ)
+	{
+		it->m_type &= ~ACCESS_OVERWRITE;
+	}
+
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::AddBuffer(RenderGraphBuffer buffer, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask,
+	VkBufferUsageFlags usage, uint32_t accessType)
+{
+	assert(buffer.m_index < m_graph.m_buffers.size() && "Invalid render graph buffer");
+
+	m_graph.m_buffers[buffer.m_index].m_usage |= usage;
+
+	auto& accesses = m_graph.m_passes[m_passIndex].m_buffers;
+	const auto it = std::find_if(accesses.begin(), accesses.end(), [&](const ResourceAccess& access) { return access.m_resource == buffer.m_index; });
+	if (it == accesses.end())
+	{
+		accesses.push_back({ buffer.m_index, VK_IMAGE_LAYOUT_UNDEFINED, stageMask, accessMask, accessType });
+		return *this;
+	}
+
+	it->m_stageMask |= stageMask;
+	it->m_accessMask |= accessMask;
+	it->m_type |= accessType;
+
+	return *this;
+}
+
+// RenderGraph
+
+RenderGraph::RenderGraph(std::shared_ptr<Device> device) :
+	m_pDevice(device)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+	DestroyTransientResources();
+}
+
+void RenderGraph::Reset()
+{
+	m_passes.clear();
+	m_images.clear();
+	m_buffers.clear();
+	m_isCompiled = false;
+}
+
+void RenderGraph::ForgetImportedImages()
+{
+	m_importedImageStates.clear();
+}
+
+RenderGraphImage RenderGraph::ImportImage(const std::string& name, const ImportedImageInfo& info)
+{
+	ImageResource resource{};
+	resource.m_name = name;
+	resource.m_desc = { info.m_extent, info.m_format };
+	resource.m_aspect = GetAspectMask(info.m_format);
+	resource.m_isImported = true;
+	resource.m_import = info;
+
+	m_images.push_back(resource);
+	return { static_cast<uint32_t>(m_images.size() - 1) };
+}
+
+RenderGraphBuffer RenderGraph::ImportBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize size)
+{
+	BufferResource resource{};
+	resource.m_name = name;
+	resource.m_desc = { size };
+	resource.m_isImported = true;
+	resource.m_importedBuffer = buffer;
+
+	m_buffers.push_back(resource);
+	return { static_cast<uint32_t>(m_buffers.size() - 1) };
+}
+
+RenderGraphImage RenderGraph::CreateImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+	ImageResource resource{};
+	resource.m_name = name;
+	resource.m_desc = desc;
+	resource.m_aspect = GetAspectMask(desc.m_format);
+
+	m_images.push_back(resource);
+	return { static_cast<uint32_t>(m_images.size() - 1) };
+}
+
+RenderGraphBuffer RenderGraph::CreateBuffer(const std::string& name, const RenderGraphBufferDesc& desc)
+{
+	BufferResource resource{};
+	resource.m_name = name;
+	resource.m_desc = desc;
+
+	m_buffers.push_back(resource);
+	return { static_cast<uint32_t>(m_buffers.size() - 1) };
+}
+
+RenderGraph::PassBuilder RenderGraph::AddPass(const std::string& name, ExecuteFunction execute)
+{
+	Pass pass{};
+	pass.m_name = name;
+	pass.m_execute = std::move(execute);
+
+	m_passes.push_back(std::move(pass));
+	return PassBuilder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+}
+
+void RenderGraph::Compile()
+{
+	CullPasses();
+	ComputeLifetimes();
+
+	std::vector<uint64_t> transientKey = BuildTransientKey();
+	if (transientKey != m_transientKey)
+	{
+		m_transientKey = std::move(transientKey);
+		CreateTransientResources();
+	}
+
+	uint32_t physicalImage = 0;
+	for (auto& image : m_images)
+	{
+		if (!image.m_isImported && image.m_firstPass != UINT32_MAX)
+		{
+			image.m_physical = physicalImage++;
+		}
+	}
+
+	uint32_t physicalBuffer = 0;
+	for (auto& buffer : m_buffers)
+	{
+		if (!buffer.m_isImported && buffer.m_firstPass != UINT32_MAX)
+		{
+			buffer.m_physical = physicalBuffer++;
+		}
+	}
+
+	m_statistics.m_passCount = static_cast<uint32_t>(m_passes.size());
+	m_statistics.m_culledPassCount = static_cast<uint32_t>(std::count_if(m_passes.begin(), m_passes.end(), [](const Pass& pass) { return pass.m_isCulled; }));
+
+	m_isCompiled = true;
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walks the passes backwards, keeping track of which resources a pass that runs later still needs.
+	// Imported resources outlive the graph, so writing them is always needed.
+	std::vector<bool> isImageNeeded(m_images.size());
+	std::vector<bool> isBufferNeeded(m_buffers.size());
+
+	for (size_t i = 0; i < m_images.size(); i++)
+	{
+		isImageNeeded[i] = m_images[i].m_isImported;
+	}
+
+	for (size_t i = 0; i < m_buffers.size(); i++)
+	{
+		isBufferNeeded[i] = m_buffers[i].m_isImported;
+	}
+
+	for (auto pass = m_passes.rbegin(); pass != m_passes.rend(); ++pass)
+	{
+		bool isNeeded = pass->m_hasSideEffects;
+		for (const auto& access : pass->m_images)
+		{
+			isNeeded |= (access.m_type & ACCESS_WRITE) && isImageNeeded[access.m_resource];
+		}
+
+		for (const auto& access : pass->m_buffers)
+		{
+			isNeeded |= (access.m_type & ACCESS_WRITE) && isBufferNeeded[access.m_resource];
+		}
+
+		pass->m_isCulled = !isNeeded;
+		if (pass->m_isCulled)
+		{
+			continue;
+		}
+
+		// Nothing written before an overwrite is visible after it
+		for (const auto& access : pass->m_images)
+		{
+			if (access.m_type & ACCESS_OVERWRITE)
+			{
+				isImageNeeded[access.m_resource] = false;
+			}
+		}
+
+		for (const auto& access : pass->m_images)
+		{
+			if (access.m_type & ACCESS_READ)
+			{
+				isImageNeeded[access.m_resource] = true;
+			}
+		}
+
+		for (const auto& access : pass->m_buffers)
+		{
+			if (access.m_type & ACCESS_READ)
+			{
+				isBufferNeeded[access.m_resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); passIndex++)
+	{
+		const Pass& pass = m_passes[passIndex];
+		if (pass.m_isCulled)
+		{
+			continue;
+		}
+
+		for (const auto& access : pass.m_images)
+		{
+			auto& image = m_images[access.m_resource];
+			image.m_firstPass = std::min(image.m_firstPass, passIndex);
+			image.m_lastPass = passIndex;
+		}
+
+		for (const auto& access : pass.m_buffers)
+		{
+			auto& buffer = m_buffers[access.m_resource];
+			buffer.m_firstPass = std::min(buffer.m_firstPass, passIndex);
+			buffer.m_lastPass = passIndex;
+		}
+	}
+}
+
+std::vector<uint64_t> RenderGraph::BuildTransientKey() const
+{
+	std::vector<uint64_t> key;
+
+	for (const auto& image : m_images)
+	{
+		if (image.m_isImported || image.m_firstPass == UINT32_MAX)
+		{
+			continue;
+		}
+
+		key.push_back((static_cast<uint64_t>(image.m_desc.m_extent.width) << 32) | image.m_desc.m_extent.height);
+		key.push_back((static_cast<uint64_t>(image.m_desc.m_format) << 32) | image.m_usage);
+		key.push_back((static_cast<uint64_t>(image.m_firstPass) << 32) | image.m_lastPass);
+	}
+
+	// Keeps image and buffer entries from lining up differently
+	key.push_back(UINT64_MAX);
+
+	for (const auto& buffer : m_buffers)
+	{
+		if (buffer.m_isImported || buffer.m_firstPass == UINT32_MAX)
+		{
+			continue;
+		}
+
+		key.push_back(buffer.m_desc.m_size);
+		key.push_back(buffer.m_usage);
+		key.push_back((static_cast<uint64_t>(buffer.m_firstPass) << 32) | buffer.m_lastPass);
+	}
+
+	return key;
+}
+
+void RenderGraph::CreateTransientResources()
+{
+	const VkDevice vkDevice = m_pDevice->GetVkDevice();
+	const VmaAllocator allocator = m_pDevice->GetAllocator();
+
+	// Earlier frames may still use the old resources
+	if (!m_memoryBlocks.empty())
+	{
+		vkDeviceWaitIdle(vkDevice);
+		DestroyTransientResources();
+	}
+
+	std::vector<uint32_t> images;
+	for (uint32_t i = 0; i < m_images.size(); i++)
+	{
+		if (!m_images[i].m_isImported && m_images[i].m_firstPass != UINT32_MAX)
+		{
+			images.push_back(i);
+		}
+	}
+
+	std::vector<uint32_t> buffers;
+	for (uint32_t i = 0; i < m_buffers.size(); i++)
+	{
+		if (!m_buffers[i].m_isImported && m_buffers[i].m_firstPass != UINT32_MAX)
+		{
+			buffers.push_back(i);
+		}
+	}
+
+	m_physicalImages.resize(images.size());
+	m_physicalBuffers.resize(buffers.size());
+	m_statistics.m_transientMemoryUnaliased = 0;
+
+	std::vector<VkMemoryRequirements> imageRequirements(images.size());
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const ImageResource& resource = m_images[images[i]];
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = resource.m_desc.m_extent.width;
+		imageInfo.extent.height = resource.m_desc.m_extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.m_desc.m_format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = resource.m_usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(vkDevice, &imageInfo, nullptr, &m_physicalImages[i].m_image) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph image");
+		}
+
+		vkGetImageMemoryRequirements(vkDevice, m_physicalImages[i].m_image, &imageRequirements[i]);
+		m_statistics.m_transientMemoryUnaliased += imageRequirements[i].size;
+	}
+
+	std::vector<VkMemoryRequirements> bufferRequirements(buffers.size());
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		const BufferResource& resource = m_buffers[buffers[i]];
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = resource.m_desc.m_size;
+		bufferInfo.usage = resource.m_usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(vkDevice, &bufferInfo, nullptr, &m_physicalBuffers[i].m_buffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph buffer");
+		}
+
+		vkGetBufferMemoryRequirements(vkDevice, m_physicalBuffers[i].m_buffer, &bufferRequirements[i]);
+		m_statistics.m_transientMemoryUnaliased += bufferRequirements[i].size;
+	}
+
+	// Largest first, so smaller resources fill the blocks of bigger ones instead of growing their own.
+	// Images and buffers get separate blocks, they'd rarely fit the same memory types anyway.
+	std::vector<VkMemoryRequirements> blockRequirements;
+
+	{
+		std::vector<std::vector<std::pair<uint32_t, uint32_t>>> blockLifetimes;
+		std::vector<size_t> order(images.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return imageRequirements[a].size > imageRequirements[b].size; });
+
+		for (const size_t i : order)
+		{
+			const ImageResource& resource = m_images[images[i]];
+			m_physicalImages[i].m_memoryBlock = AssignMemoryBlock(blockLifetimes, blockRequirements, imageRequirements[i], resource.m_firstPass, resource.m_lastPass);
+		}
+	}
+
+	{
+		const uint32_t firstBufferBlock = static_cast<uint32_t>(blockRequirements.size());
+		std::vector<std::vector<std::pair<uint32_t, uint32_t>>> blockLifetimes;
+		std::vector<VkMemoryRequirements> bufferBlockRequirements;
+		std::vector<size_t> order(buffers.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bufferRequirements[a].size > bufferRequirements[b].size; });
+
+		for (const size_t i : order)
+		{
+			const BufferResource& resource = m_buffers[buffers[i]];
+			m_physicalBuffers[i].m_memoryBlock = firstBufferBlock +
+				AssignMemoryBlock(blockLifetimes, bufferBlockRequirements, bufferRequirements[i], resource.m_firstPass, resource.m_lastPass);
+		}
+
+		blockRequirements.insert(blockRequirements.end(), bufferBlockRequirements.begin(), bufferBlockRequirements.end());
+	}
+
+	m_memoryBlocks.resize(blockRequirements.size());
+	m_statistics.m_transientMemory = 0;
+
+	for (size_t i = 0; i < blockRequirements.size(); i++)
+	{
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		if (vmaAllocateMemory(allocator, &blockRequirements[i], &allocInfo, &m_memoryBlocks[i].m_allocation, nullptr) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate render graph memory");
+		}
+
+		m_memoryBlocks[i].m_size = blockRequirements[i].size;
+		m_statistics.m_transientMemory += blockRequirements[i].size;
+	}
+
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		PhysicalImage& physical = m_physicalImages[i];
+		const ImageResource& resource = m_images[images[i]];
+
+		vmaBindImageMemory(allocator, m_memoryBlocks[physical.m_memoryBlock].m_allocation, physical.m_image);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = physical.m_image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = resource.m_desc.m_format;
+		viewInfo.subresourceRange.aspectMask = resource.m_aspect;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(vkDevice, &viewInfo, nullptr, &physical.m_view) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph image view");
+		}
+	}
+
+	for (const PhysicalBuffer& physical : m_physicalBuffers)
+	{
+		vmaBindBufferMemory(allocator, m_memoryBlocks[physical.m_memoryBlock].m_allocation, physical.m_buffer);
+	}
+}
+
+void RenderGraph::DestroyTransientResources()
+{
+	const VkDevice vkDevice = m_pDevice->GetVkDevice();
+
+	for (const PhysicalImage& physical : m_physicalImages)
+	{
+		vkDestroyImageView(vkDevice, physical.m_view, nullptr);
+		vkDestroyImage(vkDevice, physical.m_image, nullptr);
+	}
+
+	for (const PhysicalBuffer& physical : m_physicalBuffers)
+	{
+		vkDestroyBuffer(vkDevice, physical.m_buffer, nullptr);
+	}
+
+	for (const MemoryBlock& block : m_memoryBlocks)
+	{
+		vmaFreeMemory(m_pDevice->GetAllocator(), block.m_allocation);
+	}
+
+	m_physicalImages.clear();
+	m_physicalBuffers.clear();
+	m_memoryBlocks.clear();
+}
+
+uint32_t RenderGraph::AssignMemoryBlock(std::vector<std::vector<std::pair<uint32_t, uint32_t>>>& blockLifetimes,
+	std::vector<VkMemoryRequirements>& blockRequirements, const VkMemoryRequirements& requirements, uint32_t firstPass, uint32_t lastPass) const
+{
+	for (uint32_t block = 0; block < blockRequirements.size(); block++)
+	{
+		const uint32_t memoryTypeBits = blockRequirements[block].memoryTypeBits & requirements.memoryTypeBits;
+		if (memoryTypeBits == 0)
+		{
+			continue;
+		}
+
+		const auto& lifetimes = blockLifetimes[block];
+		const bool overlaps = std::any_of(lifetimes.begin(), lifetimes.end(), [&](const std::pair<uint32_t, uint32_t>& lifetime)
+			{
+				return firstPass <= lifetime.second && lifetime.first <= lastPass;
+			});
+
+		if (overlaps)
+		{
+			continue;
+		}
+
+		// Everything is bound at offset 0, so the block has to satisfy the strictest of its resources
+		blockRequirements[block].size = std::max(blockRequirements[block].size, requirements.size);
+		blockRequirements[block].alignment = std::max(blockRequirements[block].alignment, requirements.alignment);
+		blockRequirements[block].memoryTypeBits = memoryTypeBits;
+		blockLifetimes[block].push_back({ firstPass, lastPass });
+
+		return block;
+	}
+
+	blockRequirements.push_back(requirements);
+	blockLifetimes.push_back({ { firstPass, lastPass } });
+
+	return static_cast<uint32_t>(blockRequirements.size() - 1);
+}
+
+void RenderGraph::Execute(CommandBuffer& commandBuffer)
+{
+	assert(m_isCompiled && "Render graph has to be compiled before it's executed");
+
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); passIndex++)
+	{
+		const Pass& pass = m_passes[passIndex];
+		if (pass.m_isCulled)
+		{
+			continue;
+		}
+
+		RecordBarriers(commandBuffer, passIndex);
+		pass.m_execute(commandBuffer);
+
+		// The next resource in the same memory has to wait for this one's last accesses
+		for (const auto& access : pass.m_images)
+		{
+			const ImageResource& image = m_images[access.m_resource];
+			if (!image.m_isImported && image.m_lastPass == passIndex)
+			{
+				const PhysicalImage& physical = m_physicalImages[image.m_physical];
+				m_memoryBlocks[physical.m_memoryBlock].m_state = { physical.m_state.m_writeStageMask | physical.m_state.m_readStageMask, physical.m_state.m_writeAccessMask };
+			}
+		}
+
+		for (const auto& access : pass.m_buffers)
+		{
+			const BufferResource& buffer = m_buffers[access.m_resource];
+			if (!buffer.m_isImported && buffer.m_lastPass == passIndex)
+			{
+				const PhysicalBuffer& physical = m_physicalBuffers[buffer.m_physical];
+				m_memoryBlocks[physical.m_memoryBlock].m_state = { physical.m_state.m_writeStageMask | physical.m_state.m_readStageMask, physical.m_state.m_writeAccessMask };
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < m_images.size(); i++)
+	{
+		const ImageResource& image = m_images[i];
+		if (image.m_isImported && image.m_firstPass != UINT32_MAX && image.m_import.m_finalLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			// Whatever consumes the image next synchronizes with a semaphore, nothing in this submission waits on it
+			commandBuffer.TransitionImage(image.m_import.m_image, GetImageState(i), image.m_import.m_finalLayout,
+				VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, image.m_aspect);
+		}
+	}
+
+	commandBuffer.FlushBarriers();
+}
+
+void RenderGraph::RecordBarriers(CommandBuffer& commandBuffer, uint32_t passIndex)
+{
+	const Pass& pass = m_passes[passIndex];
+
+	for (const auto& access : pass.m_images)
+	{
+		const ImageResource& image = m_images[access.m_resource];
+		ImageState& state = GetImageState(access.m_resource);
+		const bool isFirstUse = image.m_firstPass == passIndex;
+
+		if (isFirstUse && image.m_isImported && image.m_import.m_waitStageMask != VK_PIPELINE_STAGE_2_NONE)
+		{
+			// The semaphore wait is the image's last "write", the first barrier chains to it
+			state.m_writeStageMask = image.m_import.m_waitStageMask;
+			state.m_writeAccessMask = VK_ACCESS_2_NONE;
+			state.m_readStageMask = VK_PIPELINE_STAGE_2_NONE;
+			state.m_readAccessMask = VK_ACCESS_2_NONE;
+		}
+		else if (isFirstUse && !image.m_isImported)
+		{
+			const PhysicalImage& physical = m_physicalImages[image.m_physical];
+			const BufferState& memoryState = m_memoryBlocks[physical.m_memoryBlock].m_state;
+			state.m_writeStageMask = memoryState.m_writeStageMask;
+			state.m_writeAccessMask = memoryState.m_writeAccessMask;
+			state.m_readStageMask = VK_PIPELINE_STAGE_2_NONE;
+			state.m_readAccessMask = VK_ACCESS_2_NONE;
+		}
+
+		// Transient contents are undefined at their first use, whoever used the memory before left something else in it
+		const bool discardContents = (access.m_type & ACCESS_OVERWRITE) || (isFirstUse && !image.m_isImported);
+
+		commandBuffer.TransitionImage(GetImage({ access.m_resource }), state, access.m_layout, access.m_stageMask, access.m_accessMask,
+			image.m_aspect, discardContents);
+	}
+
+	for (const auto& access : pass.m_buffers)
+	{
+		const BufferResource& buffer = m_buffers[access.m_resource];
+		BufferState& state = GetBufferState(access.m_resource);
+
+		if (buffer.m_firstPass == passIndex && !buffer.m_isImported)
+		{
+			state = m_memoryBlocks[m_physicalBuffers[buffer.m_physical].m_memoryBlock].m_state;
+		}
+
+		RecordBufferBarrier(commandBuffer, GetBuffer({ access.m_resource }), state, access.m_stageMask, access.m_accessMask);
+	}
+
+	commandBuffer.FlushBarriers();
+}
+
+void RenderGraph::RecordBufferBarrier(CommandBuffer& commandBuffer, VkBuffer buffer, BufferState& state, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask)
+{
+	const bool isWrite = (accessMask & WRITE_ACCESS_MASK) != 0;
+
+	VkBufferMemoryBarrier2 barrier{};
+	if (!isWrite)
+	{
+		// Nothing written yet, or an earlier barrier already made the write visible to this scope
+		const bool isVisible = (stageMask & ~state.m_readStageMask) == 0 && (accessMask & ~state.m_readAccessMask) == 0;
+		if (state.m_writeStageMask == VK_PIPELINE_STAGE_2_NONE || isVisible)
+		{
+			state.m_readStageMask |= stageMask;
+			state.m_readAccessMask |= accessMask;
+			return;
+		}
+
+		barrier.srcStageMask = state.m_writeStageMask;
+		barrier.srcAccessMask = state.m_writeAccessMask;
+	}
+	else
+	{
+		// The first access, nothing to wait for
+		if ((state.m_writeStageMask | state.m_readStageMask) == VK_PIPELINE_STAGE_2_NONE)
+		{
+			state = { stageMask, accessMask & WRITE_ACCESS_MASK, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE };
+			return;
+		}
+
+		// Reads since the write only need an execution dependency
+		barrier.srcStageMask = state.m_writeStageMask | state.m_readStageMask;
+		barrier.srcAccessMask = state.m_writeAccessMask;
+	}
+
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+	barrier.dstStageMask = stageMask;
+	barrier.dstAccessMask = accessMask;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	commandBuffer.AddBufferBarrier(barrier);
+
+	if (isWrite)
+	{
+		state = { stageMask, accessMask & WRITE_ACCESS_MASK, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE };
+	}
+	else
+	{
+		state.m_readStageMask |= stageMask;
+		state.m_readAccessMask |= accessMask;
+	}
+}
+
+ImageState& RenderGraph::GetImageState(uint32_t image)
+{
+	const ImageResource& resource = m_images[image];
+	if (resource.m_isImported)
+	{
+		return m_importedImageStates[resource.m_import.m_image];
+	}
+
+	return m_physicalImages[resource.m_physical].m_state;
+}
+
+RenderGraph::BufferState& RenderGraph::GetBufferState(uint32_t buffer)
+{
+	const BufferResource& resource = m_buffers[buffer];
+	if (resource.m_isImported)
+	{
+		return m_importedBufferStates[resource.m_importedBuffer];
+	}
+
+	return m_physicalBuffers[resource.m_physical].m_state;
+}
+
+VkImage RenderGraph::GetImage(RenderGraphImage image) const
+{
+	assert(image.m_index < m_images.size() && "Invalid render graph image");
+
+	const ImageResource& resource = m_images[image.m_index];
+	if (resource.m_isImported)
+	{
+		return resource.m_import.m_image;
+	}
+
+	assert(resource.m_physical != UINT32_MAX && "Render graph image isn't used by any pass");
+	return m_physicalImages[resource.m_physical].m_image;
+}
+
+VkImageView RenderGraph::GetImageView(RenderGraphImage image) const
+{
+	assert(image.m_index < m_images.size() && "Invalid render graph image");
+
+	const ImageResource& resource = m_images[image.m_index];
+	if (resource.m_isImported)
+	{
+		return resource.m_import.m_view;
+	}
+
+	assert(resource.m_physical != UINT32_MAX && "Render graph image isn't used by any pass");
+	return m_physicalImages[resource.m_physical].m_view;
+}
+
+VkBuffer RenderGraph::GetBuffer(RenderGraphBuffer buffer) const
+{
+	assert(buffer.m_index < m_buffers.size() && "Invalid render graph buffer");
+
+	const BufferResource& resource = m_buffers[buffer.m_index];
+	if (resource.m_isImported)
+	{
+		return resource.m_importedBuffer;
+	}
+
+	assert(resource.m_physical != UINT32_MAX && "Render graph buffer isn't used by any pass");
+	return m_physicalBuffers[resource.m_physical].m_buffer;
+}
+
+const RenderGraphStatistics& RenderGraph::GetStatistics() const
+{
+	return m_statistics;
+}
@@ -0,0 +1,616 @@
+#include "vkShaderReflection.h"
+
+#include "vkDescriptorLayoutCache.h"
+
+#include <spirv-headers/spirv.h>
+
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace
+{
+	// Only the instructions that describe interface variables and their types are kept
+	struct SpirvType
+	{
+		SpvOp m_op = SpvOpNop;
+		std::vector<uint32_t> m_operands; // Everything after the result id
+	};
+
+	struct SpirvDecorations
+	{
+		std::optional<uint32_t> m_set;
+		std::optional<uint32_t> m_binding;
+		std::optional<uint32_t> m_location;
+		std::optional<uint32_t> m_arrayStride;
+		bool m_isBlock = false;
+		bool m_isBufferBlock = false;
+		bool m_isBuiltIn = false;
+	};
+
+	struct SpirvMemberDecorations
+	{
+		uint32_t m_offset = 0;
+		uint32_t m_matrixStride = 0;
+	};
+
+	struct SpirvVariable
+	{
+		uint32_t m_id;
+		uint32_t m_pointerType;
+		SpvStorageClass m_storageClass;
+	};
+
+	class SpirvModule
+	{
+	public:
+		explicit SpirvModule(const std::vector<char>& code);
+
+		const SpirvType& GetType(uint32_t id) const;
+		const SpirvDecorations& GetDecorations(uint32_t id) const;
+		const SpirvMemberDecorations& GetMemberDecorations(uint32_t structId, uint32_t member) const;
+		uint32_t GetConstant(uint32_t id) const;
+
+		// Size of a type inside a block, matrixStride comes from the member that holds the matrix
+		uint32_t GetSize(uint32_t typeId, uint32_t matrixStride) const;
+
+		const std::vector<SpirvVariable>& GetVariables() const { return m_variables; }
+
+	private:
+		std::unordered_map<uint32_t, SpirvType> m_types;
+		std::unordered_map<uint32_t, uint32_t> m_constants;
+		std::unordered_map<uint32_t, SpirvDecorations> m_decorations;
+		std::unordered_map<uint32_t, std::vector<SpirvMemberDecorations>> m_memberDecorations;
+		std::vector<SpirvVariable> m_variables;
+	};
+
+	SpirvModule::SpirvModule(const std::vector<char>& code)
+	{
+		if (code.size() % sizeof(uint32_t) != 0 || code.size() < 5 * sizeof(uint32_t))
+		{
+			throw std::runtime_error("Shader code is not valid SPIR-V");
+		}
+
+		// The char buffer isn't guaranteed to be 4 byte aligned
+		std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+		memcpy(words.data(), code.data(), code.size());
+
+		if (words[0] != SpvMagicNumber)
+		{
+			throw std::runtime_error("Shader code is not valid SPIR-V");
+		}
+
+		// Skip the header (magic, version, generator, bound, schema)
+		size_t i = 5;
+		while (i < words.size())
+		{
+			const uint32_t wordCount = words[i] >> SpvWordCountShift;
+			const SpvOp op = static_cast<SpvOp>(words[i] & SpvOpCodeMask);
+
+			if (wordCount == 0 || i + wordCount > words.size())
+			{
+				throw std::runtime_error("Shader code is not valid SPIR-V");
+			}
+
+			const uint32_t* operands = &words[i + 1];
+			const uint32_t operandCount = wordCount - 1;
+
+			switch (op)
+			{
+			case SpvOpDecorate:
+			{
+				SpirvDecorations& decorations = m_decorations[operands[0]];
+				const uint32_t literal = operandCount > 2 ? operands[2] : 0;
+
+				switch (static_cast<SpvDecoration>(operands[1]))
+				{
+				case SpvDecorationDescriptorSet: decorations.m_set = literal; break;
+				case SpvDecorationBinding: decorations.m_binding = literal; break;
+				case SpvDecorationLocation: decorations.m_location = literal; break;
+				case SpvDecorationArrayStride: decorations.m_arrayStride = literal; break;
+				case SpvDecorationBlock: decorations.m_isBlock = true; break;
+				case SpvDecorationBufferBlock: decorations.m_isBufferBlock = true; break;
+				case SpvDecorationBuiltIn: decorations.m_isBuiltIn = true; break;
+				default: break;
+				}
+				break;
+			}
+			case SpvOpMemberDecorate:
+			{
+				auto& members = m_memberDecorations[operands[0]];
+				const uint32_t member = operands[1];
+				if (members.size() <= member)
+				{
+					members.resize(member + 1);
+				}
+
+				const uint32_t literal = operandCount > 3 ? operands[3] : 0;
+
+				switch (static_cast<SpvDecoration>(operands[2]))
+				{
+				case SpvDecorationOffset: members[member].m_offset = literal; break;
+				case SpvDecorationMatrixStride: members[member].m_matrixStride = literal; break;
+				default: break;
+				}
+				break;
+			}
+			case SpvOpTypeVoid:
+			case SpvOpTypeBool:
+			case SpvOpTypeInt:
+			case SpvOpTypeFloat:
+			case SpvOpTypeVector:
+			case SpvOpTypeMatrix:
+			case SpvOpTypeImage:
+			case SpvOpTypeSampler:
+			case SpvOpTypeSampledImage:
+			case SpvOpTypeArray:
+			case SpvOpTypeRuntimeArray:
+			case SpvOpTypeStruct:
+			case SpvOpTypePointer:
+			case SpvOpTypeAccelerationStructureKHR:
+			{
+				SpirvType& type = m_types[operands[0]];
+				type.m_op = op;
+				type.m_operands.assign(operands + 1, operands + operandCount);
+				break;
+			}
+			case SpvOpConstant:
+			case SpvOpSpecConstant:
+			{
+				// Array lengths, only the low word matters
+				m_constants[operands[1]] = operandCount > 2 ? operands[2] : 0;
+				break;
+			}
+			case SpvOpVariable:
+			{
+				m_variables.push_back({ operands[1], operands[0], static_cast<SpvStorageClass>(operands[2]) });
+				break;
+			}
+			default:
+				break;
+			}
+
+			i += wordCount;
+		}
+	}
+
+	const SpirvType& SpirvModule::GetType(uint32_t id) const
+	{
+		auto it = m_types.find(id);
+		if (it == m_types.end())
+		{
+			throw std::runtime_error("SPIR-V references an unknown type");
+		}
+
+		return it->second;
+	}
+
+	const SpirvDecorations& SpirvModule::GetDecorations(uint32_t id) const
+	{
+		static const SpirvDecorations none{};
+
+		auto it = m_decorations.find(id);
+		return it != m_decorations.end() ? it->second : none;
+	}
+
+	const SpirvMemberDecorations& SpirvModule::GetMemberDecorations(uint32_t structId, uint32_t member) const
+	{
+		static const SpirvMemberDecorations none{};
+
+		auto it = m_memberDecorations.find(structId);
+		if (it == m_memberDecorations.end() || member >= it->second.size())
+		{
+			return none;
+		}
+
+		return it->second[member];
+	}
+
+	uint32_t SpirvModule::GetConstant(uint32_t id) const
+	{
+		auto it = m_constants.find(id);
+		if (it == m_constants.end())
+		{
+			throw std::runtime_error("SPIR-V array length is not a constant");
+		}
+
+		return it->second;
+	}
+
+	uint32_t SpirvModule::GetSize(uint32_t typeId, uint32_t matrixStride) const
+	{
+		const SpirvType& type = GetType(typeId);
+
+		switch (type.m_op)
+		{
+		case SpvOpTypeBool:
+			return 4;
+		case SpvOpTypeInt:
+		case SpvOpTypeFloat:
+			return type.m_operands[0] / 8;
+		case SpvOpTypeVector:
+			return GetSize(type.m_operands[0], 0) * type.m_operands[1];
+		case SpvOpTypeMatrix:
+		{
+			const uint32_t columnCount = type.m_operands[1];
+			const uint32_t stride = matrixStride != 0 ? matrixStride : GetSize(type.m_operands[0], 0);
+			return stride * columnCount;
+		}
+		case SpvOpTypeArray:
+		{
+			const uint32_t length = GetConstant(type.m_operands[1]);
+			const auto arrayStride = GetDecorations(typeId).m_arrayStride;
+			const uint32_t stride = arrayStride ? *arrayStride : GetSize(type.m_operands[0], matrixStride);
+			return stride * length;
+		}
+		case SpvOpTypeRuntimeArray:
+			return 0;
+		case SpvOpTypeStruct:
+		{
+			uint32_t size = 0;
+			for (uint32_t member = 0; member < type.m_operands.size(); member++)
+			{
+				const auto& memberDecorations = GetMemberDecorations(typeId, member);
+				size = std::max(size, memberDecorations.m_offset + GetSize(type.m_operands[member], memberDecorations.m_matrixStride));
+			}
+			return size;
+		}
+		default:
+			throw std::runtime_error("SPIR-V type has no size");
+		}
+	}
+
+	VkDescriptorType GetDescriptorType(const SpirvModule& module, SpvStorageClass storageClass, uint32_t typeId)
+	{
+		const SpirvType& type = module.GetType(typeId);
+
+		switch (storageClass)
+		{
+		case SpvStorageClassUniform:
+			// Before SPIR-V 1.3 storage buffers are uniforms decorated as BufferBlock
+			return module.GetDecorations(typeId).m_isBufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		case SpvStorageClassStorageBuffer:
+			return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		case SpvStorageClassUniformConstant:
+			break;
+		default:
+			throw std::runtime_error("Unsupported storage class for a descriptor binding");
+		}
+
+		switch (type.m_op)
+		{
+		case SpvOpTypeSampler:
+			return VK_DESCRIPTOR_TYPE_SAMPLER;
+		case SpvOpTypeSampledImage:
+			return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		case SpvOpTypeAccelerationStructureKHR:
+			return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+		case SpvOpTypeImage:
+		{
+			// Operands: sampled type, dim, depth, arrayed, multisampled, sampled, format
+			const SpvDim dim = static_cast<SpvDim>(type.m_operands[1]);
+			const uint32_t sampled = type.m_operands[5];
+
+			if (dim == SpvDimSubpassData)
+			{
+				return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			}
+
+			if (dim == SpvDimBuffer)
+			{
+				return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+
+			return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		}
+		default:
+			throw std::runtime_error("Unsupported descriptor type in shader");
+		}
+	}
+
+	VkFormat GetVertexFormat(const SpirvModule& module, uint32_t typeId, uint32_t& size)
+	{
+		const SpirvType& type = module.GetType(typeId);
+
+		uint32_t componentCount = 1;
+		const SpirvType* pComponentType = &type;
+		if (type.m_op == SpvOpTypeVector)
+		{
+			componentCount = type.m_operands[1];
+			pComponentType = &module.GetType(type.m_operands[0]);
+		}
+
+		if (pComponentType->m_operands.empty() || pComponentType->m_operands[0] != 32)
+		{
+			throw std::runtime_error("Only 32 bit vertex inputs are supported by shader reflection");
+		}
+
+		size = componentCount * 4;
+
+		static constexpr VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+		static constexpr VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+		static constexpr VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+		assert(componentCount >= 1 && componentCount <= 4 && "Vector has an invalid component count");
+
+		switch (pComponentType->m_op)
+		{
+		case SpvOpTypeFloat:
+			return floatFormats[componentCount - 1];
+		case SpvOpTypeInt:
+			// Second operand is the signedness
+			return pComponentType->m_operands[1] ? intFormats[componentCount - 1] : uintFormats[componentCount - 1];
+		default:
+			throw std::runtime_error("Unsupported vertex input type");
+		}
+	}
+}
+
+ShaderReflection ShaderReflection::Reflect(const std::vector<char>& code, VkShaderStageFlagBits stage)
+{
+	const SpirvModule module(code);
+
+	ShaderReflection reflection;
+
+	for (const SpirvVariable& variable : module.GetVariables())
+	{
+		const SpirvType& pointerType = module.GetType(variable.m_pointerType);
+		assert(pointerType.m_op == SpvOpTypePointer && "Variables always have a pointer type");
+
+		uint32_t typeId = pointerType.m_operands[1];
+		const SpirvDecorations& decorations = module.GetDecorations(variable.m_id);
+
+		switch (variable.m_storageClass)
+		{
+		case SpvStorageClassUniform:
+		case SpvStorageClassUniformConstant:
+		case SpvStorageClassStorageBuffer:
+		{
+			if (!decorations.m_binding.has_value())
+			{
+				continue;
+			}
+
+			// Arrays of descriptors, multi dimensional arrays multiply their lengths
+			uint32_t descriptorCount = 1;
+			while (module.GetType(typeId).m_op == SpvOpTypeArray || module.GetType(typeId).m_op == SpvOpTypeRuntimeArray)
+			{
+				const SpirvType& arrayType = module.GetType(typeId);
+				if (arrayType.m_op == SpvOpTypeRuntimeArray)
+				{
+					throw std::runtime_error("Runtime sized descriptor arrays are not supported by shader reflection");
+				}
+
+				descriptorCount *= module.GetConstant(arrayType.m_operands[1]);
+				typeId = arrayType.m_operands[0];
+			}
+
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = *decorations.m_binding;
+			binding.descriptorType = GetDescriptorType(module, variable.m_storageClass, typeId);
+			binding.descriptorCount = descriptorCount;
+			binding.stageFlags = stage;
+			binding.pImmutableSamplers = nullptr;
+
+			reflection.m_sets[decorations.m_set.value_or(0)].push_back(binding);
+			break;
+		}
+		case SpvStorageClassPushConstant:
+		{
+			// One push constant block per entry point, its range starts at the first member that is used
+			const SpirvType& blockType = module.GetType(typeId);
+			uint32_t offset = UINT32_MAX;
+			for (uint32_t member = 0; member < blockType.m_operands.size(); member++)
+			{
+				offset = std::min(offset, module.GetMemberDecorations(typeId, member).m_offset);
+			}
+
+			if (offset == UINT32_MAX)
+			{
+				continue;
+			}
+
+			reflection.m_pushConstantStages = stage;
+			reflection.m_pushConstantOffset = offset;
+			reflection.m_pushConstantSize = module.GetSize(typeId, 0) - offset;
+			break;
+		}
+		case SpvStorageClassInput:
+		{
+			// Built-ins (gl_VertexIndex, ...) don't consume vertex attributes
+			if (stage != VK_SHADER_STAGE_VERTEX_BIT || decorations.m_isBuiltIn || !decorations.m_location.has_value())
+			{
+				continue;
+			}
+
+			ReflectedVertexInput input{};
+			input.m_location = *decorations.m_location;
+			input.m_format = GetVertexFormat(module, typeId, input.m_size);
+
+			reflection.m_vertexInputs.push_back(input);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	for (auto& [set, bindings] : reflection.m_sets)
+	{
+		std::sort(bindings.begin(), bindings.end(),
+			[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+	}
+
+	std::sort(reflection.m_vertexInputs.begin(), reflection.m_vertexInputs.end(),
+		[](const ReflectedVertexInput& a, const ReflectedVertexInput& b) { return a.m_location < b.m_location; });
+
+	return reflection;
+}
+
+void ShaderReflection::Merge(const ShaderReflection& other)
+{
+	for (const auto& [set, otherBindings] : other.m_sets)
+	{
+		auto& bindings = m_sets[set];
+
+		for (const auto& otherBinding : otherBindings)
+		{
+			auto it = std::find_if(bindings.begin(), bindings.end(),
+				[&otherBinding](const VkDescriptorSetLayoutBinding& binding) { return binding.binding == otherBinding.binding; });
+
+			if (it == bindings.end())
+			{
+				bindings.push_back(otherBinding);
+				continue;
+			}
+
+			if (it->descriptorType != otherBinding.descriptorType || it->descriptorCount != otherBinding.descriptorCount)
+			{
+				throw std::runtime_error("Shader stages declare set " + std::to_string(set) + ", binding " + std::to_string(otherBinding.binding) + " differently");
+			}
+
+			it->stageFlags |= otherBinding.stageFlags;
+		}
+
+		std::sort(bindings.begin(), bindings.end(),
+			[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+	}
+
+	if (!other.m_vertexInputs.empty())
+	{
+		assert(m_vertexInputs.empty() && "Only the vertex stage has vertex inputs");
+		m_vertexInputs = other.m_vertexInputs;
+	}
+
+	// A single range visible to every stage that uses push constants, vkCmdPushConstants then needs one set of stage flags
+	if (other.m_pushConstantSize > 0)
+	{
+		if (m_pushConstantSize == 0)
+		{
+			m_pushConstantOffset = other.m_pushConstantOffset;
+			m_pushConstantSize = other.m_pushConstantSize;
+		}
+		else
+		{
+			const uint32_t begin = std::min(m_pushConstantOffset, other.m_pushConstantOffset);
+			const uint32_t end = std::max(m_pushConstantOffset + m_pushConstantSize, other.m_pushConstantOffset + other.m_pushConstantSize);
+
+			m_pushConstantOffset = begin;
+			m_pushConstantSize = end - begin;
+		}
+
+		m_pushConstantStages |= other.m_pushConstantStages;
+	}
+}
+
+std::vector<VkDescriptorSetLayout> ShaderReflection::CreateSetLayouts(DescriptorLayoutCache& layoutCache) const
+{
+	std::vector<VkDescriptorSetLayout> layouts;
+	if (m_sets.empty())
+	{
+		return layouts;
+	}
+
+	const uint32_t setCount = m_sets.rbegin()->first + 1;
+	layouts.reserve(setCount);
+
+	for (uint32_t set = 0; set < setCount; set++)
+	{
+		auto it = m_sets.find(set);
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = it != m_sets.end() ? static_cast<uint32_t>(it->second.size()) : 0;
+		layoutInfo.pBindings = it != m_sets.end() ? it->second.data() : nullptr;
+
+#ifdef _DEBUG
+		// Gaps in the binding numbers still cost descriptor memory on some implementations
+		if (it != m_sets.end() && it->second.back().binding + 1 != it->second.size())
+		{
+			std::cout << "WARNING: Set " << set << " has gaps in its binding numbers, pack them to save descriptor memory" << "\n";
+		}
+#endif
+
+		layouts.push_back(layoutCache.GetOrCreateDescriptorLayout(&layoutInfo));
+	}
+
+	return layouts;
+}
+
+std::vector<VkPushConstantRange> ShaderReflection::GetPushConstantRanges() const
+{
+	if (m_pushConstantSize == 0)
+	{
+		return {};
+	}
+
+	VkPushConstantRange range{};
+	range.stageFlags = m_pushConstantStages;
+	range.offset = m_pushConstantOffset;
+	range.size = m_pushConstantSize;
+
+	return { range };
+}
+
+void ShaderReflection::GetVertexInput(std::vector<VkVertexInputBindingDescription>& bindingDescriptions, std::vector<VkVertexInputAttributeDescription>& attributeDescriptions) const
+{
+	bindingDescriptions.clear();
+	attributeDescriptions.clear();
+
+	if (m_vertexInputs.empty())
+	{
+		return;
+	}
+
+	uint32_t offset = 0;
+	for (const auto& input : m_vertexInputs)
+	{
+		VkVertexInputAttributeDescription attribute{};
+		attribute.binding = 0;
+		attribute.location = input.m_location;
+		attribute.format = input.m_format;
+		attribute.offset = offset;
+
+		attributeDescriptions.push_back(attribute);
+		offset += input.m_size;
+	}
+
+	VkVertexInputBindingDescription binding{};
+	binding.binding = 0;
+	binding.stride = offset;
+	binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	bindingDescriptions.push_back(binding);
+}
+
+std::vector<VkDescriptorPoolSize> ShaderReflection::GetPoolSizes(uint32_t setCount) const
+{
+	std::map<VkDescriptorType, uint32_t> descriptorCounts;
+	for (const auto& [set, bindings] : m_sets)
+	{
+		for (const auto& binding : bindings)
+		{
+			descriptorCounts[binding.descriptorType] += binding.descriptorCount * setCount;
+		}
+	}
+
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	poolSizes.reserve(descriptorCounts.size());
+	for (const auto& [type, count] : descriptorCounts)
+	{
+		poolSizes.push_back({ type, count });
+	}
+
+	return poolSizes;
+}
+
+const std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>>& ShaderReflection::GetSets() const
+{
+	return m_sets;
+}
+
+const std::vector<ReflectedVertexInput>& ShaderReflection::GetVertexInputs() const
+{
+	return m_vertexInputs;
+}
@@ -11,7 +11,6 @@ Swapchain::Swapchain(const VkDevice& device, const VkSurfaceKHR& surface, std::s
 {
 	CreateSwapchain();
 	CreateImageViews();
-	CreateDepthResources();
 }
 
 Swapchain::~Swapchain()
@@ -83,13 +82,12 @@ void Swapchain::CreateSwapchain()
 
 void Swapchain::RecreateSwapchain()
 {
-	int width = 0, height = 0;
-	auto window = m_pVkWindow->GetWindow();
-
-	while (width == 0 || height == 0)
+	// Minimized, the swapchain stays out of date and frames are skipped until the main thread's event polling sees
+	// the window restored. Waiting for events here would block the render thread on GLFW, which is main thread only.
+	const VkExtent2D framebufferExtent = m_pVkWindow->GetFramebufferExtent();
+	if (framebufferExtent.width == 0 || framebufferExtent.height == 0)
 	{
-		glfwGetFramebufferSize(window, &width, &height);
-		glfwWaitEvents();
+		return;
 	}
 
 	vkDeviceWaitIdle(m_device);
@@ -100,7 +98,6 @@ void Swapchain::RecreateSwapchain()
 
 	CreateSwapchain();
 	CreateImageViews();
-	CreateDepthResources();
 }
 
 void Swapchain::CreateImageViews()
@@ -131,70 +128,8 @@ void Swapchain::CreateImageViews()
 	}
 }
 
-// TODO: Put image creations & image view creation in functions
-void Swapchain::CreateDepthResources()
-{
-	VkFormat depthFormat = m_pPhysicalDevice->FindSupportedFormat( VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-
-	VkImageCreateInfo imageInfo{};
-	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageInfo.extent.width = static_cast<uint32_t>(m_extent.width);
-	imageInfo.extent.height = static_cast<uint32_t>(m_extent.height);
-	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
-	imageInfo.arrayLayers = 1;
-	imageInfo.format = depthFormat;
-	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	imageInfo.flags = 0;
-
-	if (vkCreateImage(m_device, &imageInfo, nullptr, &m_depthImage) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create image");
-	}
-
-	VkMemoryRequirements memoryRequirements;
-	vkGetImageMemoryRequirements(m_device, m_depthImage, &memoryRequirements);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memoryRequirements.size;
-	allocInfo.memoryTypeIndex = m_pPhysicalDevice->FindMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &m_depthImageMemory) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate image memory");
-	}
-
-	vkBindImageMemory(m_device, m_depthImage, m_depthImageMemory, 0);
-
-	VkImageViewCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	createInfo.image = m_depthImage;
-	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	createInfo.format = depthFormat;
-	createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-	createInfo.subresourceRange.baseMipLevel = 0;
-	createInfo.subresourceRange.levelCount = 1;
-	createInfo.subresourceRange.baseArrayLayer = 0;
-	createInfo.subresourceRange.layerCount = 1;
-
-	if (vkCreateImageView(m_device, &createInfo, nullptr, &m_depthImageView) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create image view");
-	}
-}
-
 void Swapchain::CleanUp()
 {
-	vkDestroyImageView(m_device, m_depthImageView, nullptr);
-	vkDestroyImage(m_device, m_depthImage, nullptr);
-	vkFreeMemory(m_device, m_depthImageMemory, nullptr);
-
 	for (const auto& imageView : m_imageViews)
 	{
 		vkDestroyImageView(m_device, imageView, nullptr);
@@ -3,10 +3,12 @@
 #include <stdexcept>
 #include <cassert>
 #include <algorithm>
+#include <limits>
 
-static void FramebufferResizeCallback(GLFWwindow* window, int, int)
+static void FramebufferResizeCallback(GLFWwindow* window, int width, int height)
 {
 	Window* vkWindow = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window));
+	vkWindow->SetFramebufferExtent(width, height);
 	vkWindow->SetFrameBufferResized(true);
 }
 
@@ -20,6 +22,10 @@ Window::Window()
 	m_pVkWindow = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
 	glfwSetWindowUserPointer(m_pVkWindow, this);
 	glfwSetFramebufferSizeCallback(m_pVkWindow, FramebufferResizeCallback);
+
+	int width, height;
+	glfwGetFramebufferSize(m_pVkWindow, &width, &height);
+	SetFramebufferExtent(width, height);
 }
 
 Window::~Window()
@@ -35,13 +41,7 @@ VkExtent2D Window::ChooseExtent(const VkSurfaceCapabilitiesKHR& capabilities) co
 	}
 	else
 	{
-		int width, height;
-		glfwGetFramebufferSize(m_pVkWindow, &width, &height);
-
-		VkExtent2D actualExtent = {
-			static_cast<uint32_t>(width),
-			static_cast<uint32_t>(height)
-		};
+		VkExtent2D actualExtent = GetFramebufferExtent();
 
 		actualExtent.width = std::clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
 		actualExtent.height = std::clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
@@ -50,7 +50,18 @@ VkExtent2D Window::ChooseExtent(const VkSurfaceCapabilitiesKHR& capabilities) co
 	}
 }
 
+VkExtent2D Window::GetFramebufferExtent() const
+{
+	return { m_framebufferWidth.load(), m_framebufferHeight.load() };
+}
+
 void Window::SetFrameBufferResized(const bool isResized)
 {
 	m_isFramebufferResized = isResized;
 }
+
+void Window::SetFramebufferExtent(int width, int height)
+{
+	m_framebufferWidth = static_cast<uint32_t>(width);
+	m_framebufferHeight = static_cast<uint32_t>(height);
+}
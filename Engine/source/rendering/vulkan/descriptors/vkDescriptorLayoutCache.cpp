@@ -42,6 +42,8 @@ VkDescriptorSetLayout DescriptorLayoutCache::GetOrCreateDescriptorLayout(const V
 			[](VkDescriptorSetLayoutBinding& a, VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
 	}
 
+	std::lock_guard<std::mutex> lock(m_mutex);
+
 	auto it = m_layoutCache.find(layoutInfo);
 	if (it != m_layoutCache.end())
 	{
@@ -0,0 +1,87 @@
+#include "vkPipelineLayoutCache.h"
+
+#include "hash.h"
+
+PipelineLayoutCache::PipelineLayoutCache(VkDevice device) :
+	m_device(device)
+{
+}
+
+PipelineLayoutCache::~PipelineLayoutCache()
+{
+	for (const auto& pair : m_layoutCache)
+	{
+		vkDestroyPipelineLayout(m_device, pair.second, nullptr);
+	}
+}
+
+VkPipelineLayout PipelineLayoutCache::GetOrCreatePipelineLayout(const VkPipelineLayoutCreateInfo* info)
+{
+	PipelineLayoutInfo layoutInfo;
+	layoutInfo.m_setLayouts.assign(info->pSetLayouts, info->pSetLayouts + info->setLayoutCount);
+	layoutInfo.m_pushConstantRanges.assign(info->pPushConstantRanges, info->pPushConstantRanges + info->pushConstantRangeCount);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_layoutCache.find(layoutInfo);
+	if (it != m_layoutCache.end())
+	{
+		return it->second;
+	}
+	else
+	{
+		VkPipelineLayout layout;
+		if (vkCreatePipelineLayout(m_device, info, nullptr, &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline layout");
+		}
+
+		m_layoutCache[layoutInfo] = layout;
+
+		return layout;
+	}
+}
+
+bool PipelineLayoutCache::PipelineLayoutInfo::operator==(const PipelineLayoutInfo& other) const
+{
+	if (other.m_setLayouts != m_setLayouts || other.m_pushConstantRanges.size() != m_pushConstantRanges.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < m_pushConstantRanges.size(); i++)
+	{
+		if (other.m_pushConstantRanges[i].stageFlags != m_pushConstantRanges[i].stageFlags ||
+			other.m_pushConstantRanges[i].offset != m_pushConstantRanges[i].offset ||
+			other.m_pushConstantRanges[i].size != m_pushConstantRanges[i].size)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+size_t PipelineLayoutCache::PipelineLayoutInfo::Hash() const
+{
+	size_t result = std::hash<size_t>()(m_setLayouts.size());
+
+	for (const VkDescriptorSetLayout setLayout : m_setLayouts)
+	{
+		HashCombine(result, setLayout);
+	}
+
+	for (const VkPushConstantRange& range : m_pushConstantRanges)
+	{
+		HashCombine(result, range.stageFlags);
+		HashCombine(result, range.offset);
+		HashCombine(result, range.size);
+	}
+
+	return result;
+}
+
+std::size_t PipelineLayoutCache::PipelineLayoutHash::operator()(const PipelineLayoutInfo& other) const
+{
+	return other.Hash();
+}
@@ -0,0 +1,416 @@
+#include "vkUploadManager.h"
+
+#include "vkDevice.h"
+#include "vkPhysicalDevice.h"
+#include "vkQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Every read an uploaded buffer can see on the graphics queue, the uploader doesn't know what the buffer is used for
+static constexpr VkAccessFlags2 BUFFER_READ_ACCESS = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_UNIFORM_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT;
+
+// Keeps image copies aligned to their texel size (up to 16 byte formats) and buffer copies to 4 bytes
+static constexpr VkDeviceSize MIN_STAGING_ALIGNMENT = 16;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+UploadManager::UploadManager(std::shared_ptr<Device> device, VkDeviceSize stagingSize) :
+	m_pDevice(device)
+{
+	const VkDevice vkDevice = m_pDevice->GetVkDevice();
+	const auto properties = m_pDevice->GetPhysicalDevice()->GetProperties();
+
+	// FindQueueFamilies falls back to the graphics family when there is no transfer-only family
+	const auto& queueFamilyIndices = m_pDevice->GetQueue()->GetQueueFamilyIndices();
+	m_transferQueue = m_pDevice->GetQueue()->GetQueue(QueueType::TRANSFER);
+	m_transferFamily = queueFamilyIndices.m_transferFamily.value();
+	m_graphicsFamily = queueFamilyIndices.m_graphicsFamily.value();
+	m_isOwnershipTransferNeeded = m_transferFamily != m_graphicsFamily;
+
+	// The ring size is a multiple of the alignment, so aligned positions stay aligned after wrapping
+	m_alignment = std::max(MIN_STAGING_ALIGNMENT, properties.limits.optimalBufferCopyOffsetAlignment);
+	m_stagingSize = AlignUp(stagingSize, m_alignment);
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = m_stagingSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VmaAllocationCreateInfo allocCreateInfo{};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	allocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VmaAllocationInfo allocInfo{};
+	if (vmaCreateBuffer(m_pDevice->GetAllocator(), &bufferInfo, &allocCreateInfo, &m_stagingBuffer, &m_stagingAllocation, &allocInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate staging ring");
+	}
+
+	m_pMappedStaging = static_cast<uint8_t*>(allocInfo.pMappedData);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = m_transferFamily;
+
+	if (vkCreateCommandPool(vkDevice, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create upload command pool");
+	}
+
+	VkSemaphoreTypeCreateInfo timelineCreateInfo{};
+	timelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineCreateInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineCreateInfo;
+
+	if (vkCreateSemaphore(vkDevice, &semaphoreInfo, nullptr, &m_timelineSemaphore) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create upload timeline semaphore");
+	}
+}
+
+UploadManager::~UploadManager()
+{
+	const VkDevice vkDevice = m_pDevice->GetVkDevice();
+
+	// Copies that were recorded but never flushed are dropped together with the pool
+	WaitIdle();
+
+	vkDestroySemaphore(vkDevice, m_timelineSemaphore, nullptr);
+	vkDestroyCommandPool(vkDevice, m_commandPool, nullptr);
+	vmaDestroyBuffer(m_pDevice->GetAllocator(), m_stagingBuffer, m_stagingAllocation);
+}
+
+void UploadManager::UploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset)
+{
+	assert(data && size > 0 && "Nothing to upload");
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	while (size > 0)
+	{
+		const VkDeviceSize copySize = std::min(size, m_stagingSize);
+		const VkDeviceSize stagingOffset = Allocate(copySize);
+
+		memcpy(m_pMappedStaging + stagingOffset, bytes, static_cast<size_t>(copySize));
+
+		VkBufferCopy region{};
+		region.srcOffset = stagingOffset;
+		region.dstOffset = dstOffset;
+		region.size = copySize;
+		GetCommandBuffer().CopyBuffer(m_stagingBuffer, dst, 1, &region);
+
+		// Within one queue family the timeline semaphore alone makes the copy visible
+		if (m_isOwnershipTransferNeeded)
+		{
+			VkBufferMemoryBarrier2 release{};
+			release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+			release.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+			release.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			release.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+			release.dstAccessMask = VK_ACCESS_2_NONE;
+			release.srcQueueFamilyIndex = m_transferFamily;
+			release.dstQueueFamilyIndex = m_graphicsFamily;
+			release.buffer = dst;
+			release.offset = dstOffset;
+			release.size = copySize;
+			m_bufferReleases.push_back(release);
+		}
+
+		bytes += copySize;
+		dstOffset += copySize;
+		size -= copySize;
+	}
+}
+
+void UploadManager::UploadImage(VkImage dst, const void* data, VkDeviceSize size, uint32_t width, uint32_t height)
+{
+	assert(data && size > 0 && "Nothing to upload");
+
+	if (size > m_stagingSize)
+	{
+		throw std::runtime_error("Image doesn't fit in the staging ring");
+	}
+
+	const VkDeviceSize stagingOffset = Allocate(size);
+	memcpy(m_pMappedStaging + stagingOffset, data, static_cast<size_t>(size));
+
+	CommandBuffer& commandBuffer = GetCommandBuffer();
+
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = dst;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	// The old contents are overwritten, so there is nothing to preserve or wait for
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+	barrier.srcAccessMask = VK_ACCESS_2_NONE;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	commandBuffer.AddImageBarrier(barrier);
+	commandBuffer.FlushBarriers();
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = stagingOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+	commandBuffer.CopyBufferToImage(m_stagingBuffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	// Transition to the sampled layout, recorded with the other barriers of the batch.
+	// With a dedicated transfer family this also releases the image, the graphics queue performs the matching acquire.
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+	// The destination scope of a release is ignored, the timeline semaphore orders it before the acquire
+	barrier.dstStageMask = m_isOwnershipTransferNeeded ? VK_PIPELINE_STAGE_2_NONE : static_cast<VkPipelineStageFlags2>(WAIT_STAGES);
+	barrier.dstAccessMask = m_isOwnershipTransferNeeded ? VK_ACCESS_2_NONE : VK_ACCESS_2_SHADER_READ_BIT;
+
+	if (m_isOwnershipTransferNeeded)
+	{
+		barrier.srcQueueFamilyIndex = m_transferFamily;
+		barrier.dstQueueFamilyIndex = m_graphicsFamily;
+	}
+
+	m_imageReleases.push_back(barrier);
+}
+
+uint64_t UploadManager::Flush()
+{
+	Retire();
+
+	if (!m_isRecording)
+	{
+		return m_submittedValue;
+	}
+
+	RecordReleaseBarriers();
+
+	m_commandBuffer.EndCommandBuffer();
+	m_isRecording = false;
+
+	const uint64_t signalValue = m_submittedValue + 1;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = m_commandBuffer.GetVkPtr();
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &m_timelineSemaphore;
+
+	if (vkQueueSubmit(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit uploads");
+	}
+
+	m_submittedValue = signalValue;
+	m_submissions.push_back({ m_commandBuffer, signalValue, m_ringHead });
+
+	return signalValue;
+}
+
+void UploadManager::WaitIdle()
+{
+	Retire(m_submittedValue);
+}
+
+void UploadManager::RecordAcquireBarriers(CommandBuffer& graphicsCommandBuffer)
+{
+	for (const auto& barrier : m_bufferAcquires)
+	{
+		graphicsCommandBuffer.AddBufferBarrier(barrier);
+	}
+
+	for (const auto& barrier : m_imageAcquires)
+	{
+		graphicsCommandBuffer.AddImageBarrier(barrier);
+	}
+
+	m_bufferAcquires.clear();
+	m_imageAcquires.clear();
+}
+
+VkSemaphore UploadManager::GetTimelineSemaphore() const
+{
+	return m_timelineSemaphore;
+}
+
+uint64_t UploadManager::GetSubmittedValue() const
+{
+	return m_submittedValue;
+}
+
+VkDeviceSize UploadManager::Allocate(VkDeviceSize size)
+{
+	assert(size <= m_stagingSize && "Allocation is larger than the staging ring");
+
+	while (true)
+	{
+		// Nothing in flight or recorded, the whole ring is free. Restarting at a boundary keeps the padding a wrap
+		// would skip from counting against an allocation that needs the whole ring.
+		if (m_submissions.empty() && !m_isRecording)
+		{
+			m_ringHead = AlignUp(m_ringHead, m_stagingSize);
+			m_ringTail = m_ringHead;
+		}
+
+		uint64_t start = AlignUp(m_ringHead, m_alignment);
+
+		// Allocations are contiguous, when one doesn't fit before the end of the buffer the rest of it is skipped
+		if (start % m_stagingSize + size > m_stagingSize)
+		{
+			start = AlignUp(start, m_stagingSize);
+		}
+
+		if (start + size - m_ringTail <= m_stagingSize)
+		{
+			m_ringHead = start + size;
+			return static_cast<VkDeviceSize>(start % m_stagingSize);
+		}
+
+		// The ring is full, the space only comes back once the oldest submission finished.
+		// Copies that are still being recorded use ring space as well, so they have to be submitted first.
+		if (m_submissions.empty())
+		{
+			Flush();
+		}
+
+		assert(!m_submissions.empty() && "Staging ring is full without any uploads in flight");
+		Retire(m_submissions.front().m_timelineValue);
+	}
+}
+
+CommandBuffer& UploadManager::GetCommandBuffer()
+{
+	if (m_isRecording)
+	{
+		return m_commandBuffer;
+	}
+
+	if (!m_freeCommandBuffers.empty())
+	{
+		m_commandBuffer = m_freeCommandBuffers.back();
+		m_freeCommandBuffers.pop_back();
+	}
+	else
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = m_commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(m_pDevice->GetVkDevice(), &allocInfo, m_commandBuffer.GetVkPtr()) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate upload command buffer");
+		}
+	}
+
+	// The pool allows resetting individual command buffers, beginning one resets it implicitly
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	m_commandBuffer.BeginCommandBuffer(&beginInfo);
+	m_isRecording = true;
+
+	return m_commandBuffer;
+}
+
+void UploadManager::Retire(uint64_t waitValue)
+{
+	const VkDevice vkDevice = m_pDevice->GetVkDevice();
+
+	if (waitValue > 0)
+	{
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_timelineSemaphore;
+		waitInfo.pValues = &waitValue;
+
+		vkWaitSemaphores(vkDevice, &waitInfo, UINT64_MAX);
+	}
+
+	uint64_t completedValue = 0;
+	vkGetSemaphoreCounterValue(vkDevice, m_timelineSemaphore, &completedValue);
+
+	while (!m_submissions.empty() && m_submissions.front().m_timelineValue <= completedValue)
+	{
+		m_ringTail = m_submissions.front().m_ringEnd;
+		m_freeCommandBuffers.push_back(m_submissions.front().m_commandBuffer);
+		m_submissions.pop_front();
+	}
+}
+
+void UploadManager::RecordReleaseBarriers()
+{
+	// Buffers are only released to another family, within one family the semaphore alone covers them
+	for (const auto& barrier : m_bufferReleases)
+	{
+		m_commandBuffer.AddBufferBarrier(barrier);
+	}
+
+	for (const auto& barrier : m_imageReleases)
+	{
+		m_commandBuffer.AddImageBarrier(barrier);
+	}
+
+	m_commandBuffer.FlushBarriers();
+
+	if (m_isOwnershipTransferNeeded)
+	{
+		// Acquires repeat the ownership transfer and layout transition with the graphics queue's scope.
+		// The semaphore wait covers WAIT_STAGES, using them as source stages chains the acquire to that wait.
+		for (VkBufferMemoryBarrier2 acquire : m_bufferReleases)
+		{
+			acquire.srcStageMask = WAIT_STAGES;
+			acquire.srcAccessMask = VK_ACCESS_2_NONE;
+			acquire.dstStageMask = WAIT_STAGES;
+			acquire.dstAccessMask = BUFFER_READ_ACCESS;
+			m_bufferAcquires.push_back(acquire);
+		}
+
+		for (VkImageMemoryBarrier2 acquire : m_imageReleases)
+		{
+			acquire.srcStageMask = WAIT_STAGES;
+			acquire.srcAccessMask = VK_ACCESS_2_NONE;
+			acquire.dstStageMask = WAIT_STAGES;
+			acquire.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
+			m_imageAcquires.push_back(acquire);
+		}
+	}
+
+	m_bufferReleases.clear();
+	m_imageReleases.clear();
+}
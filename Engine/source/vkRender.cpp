@@ -3,6 +3,8 @@
 #include "engine.h"
 #include "transform.h"
 #include "fileIO.h"
+#include "timer.h"
+#include "jobSystem.h"
 #include "renderComponents.h"
 
 #include "vkPhysicalDevice.h"
@@ -25,6 +27,8 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
 
+#include <glm/gtc/packing.hpp>
+
 #include <stdexcept>
 #include <array>
 #include <set>
@@ -36,38 +40,6 @@ struct Vertex
 	glm::vec3 color;
 	glm::vec2 texCoord;
 
-	static VkVertexInputBindingDescription GetBindingDescription()
-	{
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		return bindingDescription;
-	}
-
-	static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions()
-	{
-		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
-		attributeDescriptions.resize(3);
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-		return attributeDescriptions;
-	}
-
 	bool operator==(const Vertex& other) const
 	{
 		return pos == other.pos && color == other.color && texCoord == other.texCoord;
@@ -87,20 +59,34 @@ namespace std
 	};
 }
 
-struct MVP
+struct CameraUniforms
 {
-	alignas(16) glm::mat4 model;
 	alignas(16) glm::mat4 view;
 	alignas(16) glm::mat4 projection;
 };
 
+// Matches the vertex shader's std430 ObjectData
+struct ObjectData
+{
+	alignas(16) glm::mat4 model;
+	alignas(16) glm::vec4 color;
+};
+
+// Uploaded meshes are copied into the shared vertex buffer as they are
+static_assert(sizeof(MeshVertex) == sizeof(Vertex) && offsetof(MeshVertex, m_color) == offsetof(Vertex, color) && offsetof(MeshVertex, m_texCoord) == offsetof(Vertex, texCoord),
+	"MeshVertex has to match the renderer's vertex layout");
+
 std::vector<Vertex> vertices;
 std::vector<uint32_t> indices;
 
 Renderer::Renderer(std::shared_ptr<Device> device) :
 	m_pDevice(device)
 {
-	CreateDescriptorSetLayout();
+	PipelineCache::Initialize();
+
+	m_pUploadManager = std::make_unique<UploadManager>(m_pDevice);
+	m_pRenderGraph = std::make_unique<RenderGraph>(m_pDevice);
+
 	CreateGraphicsPipeline();
 	ChooseSharingMode();
 	CreateTextureImage();
@@ -108,18 +94,33 @@ Renderer::Renderer(std::shared_ptr<Device> device) :
 	CreateTextureSampler();
 	LoadModel();
 
+	m_vertexCount = static_cast<uint32_t>(vertices.size());
+	m_indexCount = static_cast<uint32_t>(indices.size());
+	m_vertexCapacity = std::max(m_vertexCount, SHARED_VERTEX_CAPACITY);
+	m_indexCapacity = std::max(m_indexCount, SHARED_INDEX_CAPACITY);
+
+	// The model is the first mesh, meshes uploaded through render commands are appended behind it
+	m_meshes.push_back({ 0, m_indexCount, 0 });
+	m_pCommandQueue = std::make_unique<RenderCommandQueue>(RENDER_COMMAND_CAPACITY, static_cast<uint32_t>(m_meshes.size()),
+		m_vertexCapacity - m_vertexCount, m_indexCapacity - m_indexCount);
+
 	// Vertex data
-	const VkDeviceSize vertexBufferSize = sizeof(vertices[0]) * vertices.size();
-	CreateBufferWithStaging(vertexBufferSize, m_vertexBuffer, m_vertexAllocation, vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	CreateBuffer(sizeof(Vertex) * m_vertexCapacity, m_vertexBuffer, m_vertexAllocation, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	m_pUploadManager->UploadBuffer(m_vertexBuffer, vertices.data(), sizeof(Vertex) * m_vertexCount);
 
 	// Index data
-	const VkDeviceSize indexBufferSize = sizeof(indices[0]) * indices.size();
-	CreateBufferWithStaging(indexBufferSize, m_indexBuffer, m_indexAllocation, indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	CreateBuffer(sizeof(uint32_t) * m_indexCapacity, m_indexBuffer, m_indexAllocation, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	m_pUploadManager->UploadBuffer(m_indexBuffer, indices.data(), sizeof(uint32_t) * m_indexCount);
+
+	// All loading uploads go out in a single submission, the first frame waits on it
+	m_pUploadManager->Flush();
 
 	CreateUniformBuffers();
 	CreateDescriptorPool();
 	CreateDescriptorSets();
+	CreateObjectBuffers();
 	CreateSyncObjects();
+	CreateTimestampQueryPool();
 }
 
 Renderer::~Renderer()
@@ -128,6 +129,12 @@ Renderer::~Renderer()
 
 	vkDeviceWaitIdle(vkDevice);
 
+	m_pipeline = {};
+	m_defaultPipeline.reset();
+
+	m_pUploadManager.reset();
+	m_pRenderGraph.reset();
+
 	PipelineCache::Reset();
 	ShaderCache::Reset();
 
@@ -140,11 +147,11 @@ Renderer::~Renderer()
 
 	vkFreeDescriptorSets(vkDevice, m_descriptorPool, static_cast<uint32_t>(m_descriptorSets.size()), m_descriptorSets.data());
 	vkDestroyDescriptorPool(vkDevice, m_descriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(vkDevice, m_descriptorSetLayout, nullptr);
 
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
 	{
 		vmaDestroyBuffer(m_pDevice->GetAllocator(), m_uniformBuffers[i], m_uniformAllocations[i]);
+		vmaDestroyBuffer(m_pDevice->GetAllocator(), m_objectBuffers[i], m_objectAllocations[i]);
 	}
 
 	/*for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
@@ -160,7 +167,10 @@ Renderer::~Renderer()
 	//vkDestroyBuffer(vkDevice, m_vertexBuffer, nullptr);
 	//vkFreeMemory(vkDevice, m_vertexBufferMemory, nullptr);
 
+	if (m_timestampQueryPool) vkDestroyQueryPool(vkDevice, m_timestampQueryPool, nullptr);
+
 	vkDestroySemaphore(vkDevice, m_globalTimelineSemaphore, nullptr);
+	vkDestroySemaphore(vkDevice, m_computeTimelineSemaphore, nullptr);
 
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
@@ -168,19 +178,46 @@ Renderer::~Renderer()
 	}
 }
 
-void Renderer::Update()
+void Renderer::Extract(entt::registry& registry, FrameSnapshot& snapshot) const
 {
-	UpdateMVP(m_currentFrame);
+	// Rendered entities have a Transform too, the camera is the one with a Camera
+	const auto cameraEntity = registry.view<Camera, Transform>().front();
+	assert(cameraEntity != entt::null && "There's no entity with a Camera and a Transform to render from");
+
+	const Transform& cameraTransform = registry.get<Transform>(cameraEntity);
+	const Camera& camera = registry.get<Camera>(cameraEntity);
+
+	const glm::vec3 localForward = glm::vec3(0.f, 0.f, 1.f);
+	const glm::vec3 worldUp = glm::vec3(0.f, 1.f, 0.f);
+
+	snapshot.m_cameraPosition = cameraTransform.GetTranslation();
+	snapshot.m_cameraForward = glm::normalize(glm::rotate(cameraTransform.GetRotation(), localForward));
+	snapshot.m_view = glm::lookAtRH(snapshot.m_cameraPosition, snapshot.m_cameraPosition + snapshot.m_cameraForward, worldUp);
+	snapshot.m_projection = camera.projection;
+
+	const Material defaultMaterial{};
+
+	snapshot.m_objects.clear();
+	for (auto [entity, transform, meshRenderer] : registry.view<Transform, MeshRenderer>().each())
+	{
+		if (!meshRenderer.visible)
+		{
+			continue;
+		}
+
+		assert(meshRenderer.mesh < GetMeshCount() && "MeshRenderer references a mesh that doesn't exist");
+
+		const Material* pMaterial = registry.try_get<Material>(entity);
+		snapshot.m_objects.push_back({ transform.World(), (pMaterial ? *pMaterial : defaultMaterial).color, meshRenderer.mesh });
+	}
 }
 
-void Renderer::Render()
+void Renderer::Render(const FrameSnapshot& snapshot)
 {
-	FrameContext frame = m_frameContexts[m_currentFrame];
-	CommandBuffer commandBuffer = m_pDevice->GetQueue()->GetOrCreateCommandBuffer(QueueType::GRAPHICS, m_currentFrame);
-	const VkCommandBuffer* pVkCommandBuffer = commandBuffer.GetVkPtr(); // Needed for submit info
+	FrameContext& frame = m_frameContexts[m_currentFrame];
 
 	const auto vkDevice = m_pDevice->GetVkDevice();
-	const auto swapchain = m_pDevice->GetSwapchain()->GetVkSwapChain();
+	const bool isHeadless = m_pDevice->IsHeadless();
 
 	VkSemaphoreWaitInfo waitInfo{};
 	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
@@ -191,27 +228,38 @@ void Renderer::Render()
 
 	vkWaitSemaphores(vkDevice, &waitInfo, UINT64_MAX);
 
-	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(vkDevice, swapchain, UINT64_MAX, frame.m_imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-
-	const auto& swapchainRef = m_pDevice->GetSwapchain();
-	const auto& image = swapchainRef->GetImages()[imageIndex];
-	const auto imageFormat = swapchainRef->GetImageFormat();
-
-	TransitionImageLayout(image, imageFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	ReadTimestamps(frame);
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	uint32_t imageIndex;
+	if (!AcquireNextImage(frame, imageIndex))
 	{
-		m_pDevice->GetSwapchain()->RecreateSwapchain();
 		return;
 	}
-	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
-	{
-		throw std::runtime_error("Failed to acquire swapchain image");
-	}
 
+	// Before the upload flush below, so uploaded meshes are there for this frame's draws
+	ApplyRenderCommands();
+
+	// The frame's object buffer is free again after the timeline wait
+	BuildDraws(snapshot);
+
+	// Resets the frame's pools as a whole, including the ones secondary command buffers were recorded from
 	m_pDevice->GetQueue()->ResetCommandBuffers(m_currentFrame);
+	CommandBuffer commandBuffer = m_pDevice->GetQueue()->GetOrCreateCommandBuffer(QueueType::GRAPHICS, m_currentFrame);
+	const VkCommandBuffer* pVkCommandBuffer = commandBuffer.GetVkPtr(); // Needed for submit info
+
+	// Uploads issued since the last frame are submitted in one batch ahead of this frame,
+	// the frame's command buffer acquires them from the transfer queue
+	const uint64_t uploadValue = m_pUploadManager->Flush();
+	const uint64_t computeValue = SubmitAsyncCompute();
+
+	Timer recordTimer;
 	RecordCommandBuffer(commandBuffer, imageIndex);
+	m_frameStatistics.m_recordTimeMs = recordTimer.GetDeltaTime(Unit::MILLI);
+	frame.m_hasTimestamps = SupportsGpuTimestamps();
+
+	// The command buffer only references the uniform buffer, its contents can change up to the submit. The simulation
+	// of the next frame may have latched a newer camera by now.
+	UpdateCameraUniforms(snapshot);
 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -219,83 +267,214 @@ void Renderer::Render()
 	uint64_t signalValue = ++m_currentTimelineValue;
 	frame.m_timelineValue = signalValue;
 
+	// Binary semaphores ignore their value, but the array still needs an entry for every signal semaphore
+	uint64_t signalValues[] = { signalValue, 0 };
+	uint64_t waitValues[] = { uploadValue, computeValue, 0 };
+
 	VkTimelineSemaphoreSubmitInfo timelineInfo{};
 	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
-	timelineInfo.signalSemaphoreValueCount = 2;
-	timelineInfo.pSignalSemaphoreValues = &signalValue;
-
-	VkSemaphore waitSemaphores[] = { frame.m_imageAvailableSemaphore };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
+	timelineInfo.signalSemaphoreValueCount = isHeadless ? 1 : 2;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+	timelineInfo.waitSemaphoreValueCount = isHeadless ? 2 : 3;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+
+	// Offscreen images aren't shared with a presentation engine, so there is nothing to wait on or signal for them
+	// Always waiting on the last compute submission also keeps the frame's compute pool from being reset while in use
+	VkSemaphore waitSemaphores[] = { m_pUploadManager->GetTimelineSemaphore(), m_computeTimelineSemaphore, frame.m_imageAvailableSemaphore };
+	VkPipelineStageFlags waitStages[] = { UploadManager::WAIT_STAGES, COMPUTE_WAIT_STAGES, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	submitInfo.waitSemaphoreCount = isHeadless ? 2 : 3;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 
 	VkSemaphore signalSemaphores[] = { m_globalTimelineSemaphore, frame.m_renderFinishedSemaphore };
-	submitInfo.signalSemaphoreCount = 2;
+	submitInfo.signalSemaphoreCount = isHeadless ? 1 : 2;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 	submitInfo.pNext = &timelineInfo;
 
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = pVkCommandBuffer;
 
+	Timer submitTimer;
 	if (vkQueueSubmit(m_pDevice->GetQueue()->GetQueue(QueueType::GRAPHICS), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to submit draw command buffer");
 	}
+	m_frameStatistics.m_submitTimeMs = submitTimer.GetDeltaTime(Unit::MILLI);
 
-	VkPresentInfoKHR presentInfo{};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &frame.m_renderFinishedSemaphore;
+	if (!isHeadless)
+	{
+		PresentImage(frame, imageIndex);
+	}
 
-	VkSwapchainKHR swapChains[] = { swapchain };
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = swapChains;
-	presentInfo.pImageIndices = &imageIndex;
-	presentInfo.pResults = nullptr; // Optional
+	{
+		std::lock_guard<std::mutex> lock(m_statisticsMutex);
+		m_lastFrameStatistics = m_frameStatistics;
+	}
 
-	TransitionImageLayout(image, imageFormat, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
 
-	result = vkQueuePresentKHR(m_pDevice->GetQueue()->GetQueue(QueueType::PRESENT), &presentInfo);
+void Renderer::EnqueueAsyncCompute(std::function<void(CommandBuffer&)> record, bool waitForPreviousFrame)
+{
+	std::lock_guard<std::mutex> lock(m_asyncComputeMutex);
+	m_asyncComputeWork.push_back(std::move(record));
+	m_isComputeWaitingForGraphics |= waitForPreviousFrame;
+}
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+uint64_t Renderer::SubmitAsyncCompute()
+{
+	std::vector<std::function<void(CommandBuffer&)>> asyncComputeWork;
+	bool isComputeWaitingForGraphics = false;
+	{
+		std::lock_guard<std::mutex> lock(m_asyncComputeMutex);
+		asyncComputeWork.swap(m_asyncComputeWork);
+		std::swap(isComputeWaitingForGraphics, m_isComputeWaitingForGraphics);
+	}
+
+	if (asyncComputeWork.empty())
+	{
+		return m_computeTimelineValue;
+	}
+
+	CommandBuffer commandBuffer = m_pDevice->GetQueue()->GetOrCreateCommandBuffer(QueueType::COMPUTE, m_currentFrame);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	commandBuffer.BeginCommandBuffer(&beginInfo);
+	for (const auto& record : asyncComputeWork)
+	{
+		record(commandBuffer);
+	}
+	commandBuffer.EndCommandBuffer();
+
+	const uint64_t signalValue = ++m_computeTimelineValue;
+	const uint64_t waitValue = m_currentTimelineValue;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+	timelineInfo.waitSemaphoreValueCount = isComputeWaitingForGraphics ? 1 : 0;
+	timelineInfo.pWaitSemaphoreValues = &waitValue;
+
+	const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = isComputeWaitingForGraphics ? 1 : 0;
+	submitInfo.pWaitSemaphores = &m_globalTimelineSemaphore;
+	submitInfo.pWaitDstStageMask = &waitStage;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = commandBuffer.GetVkPtr();
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &m_computeTimelineSemaphore;
+
+	if (vkQueueSubmit(m_pDevice->GetQueue()->GetQueue(QueueType::COMPUTE), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit compute command buffer");
+	}
+
+	return signalValue;
+}
+
+RenderCommandQueue& Renderer::GetCommandQueue()
+{
+	return *m_pCommandQueue;
+}
+
+uint32_t Renderer::GetMeshCount() const
+{
+	return m_pCommandQueue->GetMeshCount();
+}
+
+FrameStatistics Renderer::GetFrameStatistics() const
+{
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	return m_lastFrameStatistics;
+}
+
+bool Renderer::SupportsGpuTimestamps() const
+{
+	return m_timestampQueryPool != VK_NULL_HANDLE;
+}
+
+void Renderer::ReadTimestamps(FrameContext& frame)
+{
+	if (!frame.m_hasTimestamps)
 	{
-		m_pDevice->GetSwapchain()->RecreateSwapchain();
 		return;
 	}
+
+	const uint32_t firstQuery = m_currentFrame * 2;
+
+	std::array<uint64_t, 2> timestamps{};
+	const VkResult result = vkGetQueryPoolResults(m_pDevice->GetVkDevice(), m_timestampQueryPool, firstQuery, static_cast<uint32_t>(timestamps.size()),
+		sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	// The timeline wait guarantees completion, VK_NOT_READY would mean the queries were never written
+	if (result == VK_SUCCESS)
+	{
+		// Ticks to nanoseconds to milliseconds
+		m_frameStatistics.m_gpuTimeMs = static_cast<float>(static_cast<double>(timestamps[1] - timestamps[0]) * m_timestampPeriod / 1e6);
+	}
+
+	frame.m_hasTimestamps = false;
+}
+
+bool Renderer::AcquireNextImage(const FrameContext& frame, uint32_t& imageIndex)
+{
+	if (m_pDevice->IsHeadless())
+	{
+		imageIndex = m_pDevice->GetOffscreenTarget()->AcquireNextImage();
+		return true;
+	}
+
+	const auto swapchain = m_pDevice->GetSwapchain();
+
+	VkResult result = vkAcquireNextImageKHR(m_pDevice->GetVkDevice(), swapchain->GetVkSwapChain(), UINT64_MAX, frame.m_imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		swapchain->RecreateSwapchain();
+		m_pRenderGraph->ForgetImportedImages();
+		return false;
+	}
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
 	{
 		throw std::runtime_error("Failed to acquire swapchain image");
 	}
 
-	m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	return true;
 }
 
-void Renderer::CreateDescriptorSetLayout()
+void Renderer::PresentImage(const FrameContext& frame, uint32_t imageIndex)
 {
-	VkDescriptorSetLayoutBinding uniformLayoutBinding{};
-	uniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	uniformLayoutBinding.binding = 0;
-	uniformLayoutBinding.descriptorCount = 1;
-	uniformLayoutBinding.pImmutableSamplers = nullptr;
-	uniformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerLayoutBinding.binding = 1;
-	samplerLayoutBinding.descriptorCount = 1;
-	samplerLayoutBinding.pImmutableSamplers = nullptr;
-	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	std::array< VkDescriptorSetLayoutBinding, 2> bindings = { uniformLayoutBinding , samplerLayoutBinding };
-	VkDescriptorSetLayoutCreateInfo layoutInfo{};
-	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-	layoutInfo.pBindings = bindings.data();
-
-	if (vkCreateDescriptorSetLayout(m_pDevice->GetVkDevice(), &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
+	const auto swapchain = m_pDevice->GetSwapchain();
+
+	VkPresentInfoKHR presentInfo{};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = &frame.m_renderFinishedSemaphore;
+
+	VkSwapchainKHR swapChains[] = { swapchain->GetVkSwapChain() };
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = swapChains;
+	presentInfo.pImageIndices = &imageIndex;
+	presentInfo.pResults = nullptr; // Optional
+
+	VkResult result = vkQueuePresentKHR(m_pDevice->GetQueue()->GetQueue(QueueType::PRESENT), &presentInfo);
+
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
-		throw std::runtime_error("Failed to create descriptor set layout");
+		swapchain->RecreateSwapchain();
+		m_pRenderGraph->ForgetImportedImages();
+	}
+	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+	{
+		throw std::runtime_error("Failed to present swapchain image");
 	}
 }
 
@@ -307,10 +486,6 @@ void Renderer::CreateGraphicsPipeline()
 		VK_DYNAMIC_STATE_SCISSOR
 	};
 
-	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
-	bindingDescriptions.push_back(Vertex::GetBindingDescription());
-	std::vector<VkVertexInputAttributeDescription> attributeDescriptions = Vertex::GetAttributeDescriptions();
-
 	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
 	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 	colorBlendAttachment.blendEnable = VK_FALSE;
@@ -324,28 +499,41 @@ void Renderer::CreateGraphicsPipeline()
 	std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
 	colorBlendAttachments.push_back(colorBlendAttachment);
 
-	std::vector<VkDescriptorSetLayout> layouts;
-	layouts.push_back(m_descriptorSetLayout);
-
 	std::vector<VkFormat> imageFormats;
-	imageFormats.push_back(m_pDevice->GetSwapchain()->GetImageFormat());
+	imageFormats.push_back(m_pDevice->GetRenderTarget()->GetImageFormat());
 
 	GraphicsPipelineInfo pipelineInfo{};
 	pipelineInfo.SetShader("../Engine/shaders/vert.spv", ShaderType::VERTEX);
 	pipelineInfo.SetShader("../Engine/shaders/frag.spv", ShaderType::FRAGMENT);
 	pipelineInfo.SetDynamicStates(dynamicStates);
-	pipelineInfo.SetVertexInputState(bindingDescriptions, attributeDescriptions);
+	pipelineInfo.SetVertexInputStateFromReflection();
 	pipelineInfo.SetInputAssemblyState(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_FALSE);
 	pipelineInfo.SetViewportState();
 	pipelineInfo.SetRasterizationState(VK_FALSE, VK_FALSE, VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
 	pipelineInfo.SetMultisampleState(VK_FALSE, VK_SAMPLE_COUNT_1_BIT);
 	pipelineInfo.SetColorBlendState(VK_FALSE, VK_LOGIC_OP_COPY, colorBlendAttachments);
-	pipelineInfo.SetLayoutInfo(layouts);
+	pipelineInfo.SetLayoutFromReflection();
 	pipelineInfo.SetDepthStencilState(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS, VK_FALSE);
-	pipelineInfo.SetRenderInfo(imageFormats, m_pDevice->GetPhysicalDevice()->FindSupportedFormat(
-		VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT));
+	// Same lookup the render targets create their depth image with
+	m_depthFormat = m_pDevice->GetPhysicalDevice()->FindSupportedFormat(VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+	pipelineInfo.SetRenderInfo(imageFormats, m_depthFormat);
+
+	m_shaderReflection = pipelineInfo.GetReflection();
+
+	// Vertex data is uploaded as an array of Vertex, the shader's inputs have to cover it exactly
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+	m_shaderReflection.GetVertexInput(bindingDescriptions, attributeDescriptions);
+	assert(bindingDescriptions.size() == 1 && bindingDescriptions[0].stride == sizeof(Vertex) && "Vertex shader inputs don't match the Vertex struct");
+
+	assert(pipelineInfo.m_setLayouts.size() == 1 && "The renderer only allocates descriptor sets for set 0");
+	m_descriptorSetLayout = pipelineInfo.m_setLayouts[0];
+
+	m_defaultPipeline = PipelineCache::GetOrCreateGraphicsPipeline(pipelineInfo);
 
-	m_pipeline = PipelineCache::GetOrCreateGraphicsPipeline(pipelineInfo);
+	// Same state as the default pipeline for now, so this resolves straight from the cache. Pipelines for other
+	// materials go through the same call and render with the default pipeline until their compilation is done.
+	m_pipeline = PipelineCache::GetOrCreateGraphicsPipelineAsync(pipelineInfo, m_defaultPipeline);
 }
 
 void Renderer::CreateTextureImage()
@@ -359,32 +547,6 @@ void Renderer::CreateTextureImage()
 
 	VkDeviceSize imageSize = texWidth * texHeight * 4;
 
-	// -------------------------
-	// Create staging buffer
-	// -------------------------
-	VkBuffer stagingBuffer;
-	VmaAllocation stagingAllocation;
-	{
-		VkBufferCreateInfo bufferInfo{};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.size = imageSize;
-		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VmaAllocationCreateInfo allocInfo{};
-		allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-
-		vmaCreateBuffer(m_pDevice->GetAllocator(), &bufferInfo, &allocInfo,
-			&stagingBuffer, &stagingAllocation, nullptr);
-
-		void* data;
-		vmaMapMemory(m_pDevice->GetAllocator(), stagingAllocation, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vmaUnmapMemory(m_pDevice->GetAllocator(), stagingAllocation);
-	}
-
-	stbi_image_free(pixels);
-
 	// -------------------------
 	// Create GPU texture image
 	// -------------------------
@@ -414,17 +576,11 @@ void Renderer::CreateTextureImage()
 	// -------------------------
 	// Transfer data to the image
 	// -------------------------
-	TransitionImageLayout(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB,
-		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	CopyBufferToImage(stagingBuffer, m_textureImage,
+	// Copied into the staging ring right away, so the pixels can be freed before the upload is flushed
+	m_pUploadManager->UploadImage(m_textureImage, pixels, imageSize,
 		static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-	TransitionImageLayout(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-	// -------------------------
-	// Cleanup staging buffer
-	// -------------------------
-	vmaDestroyBuffer(m_pDevice->GetAllocator(), stagingBuffer, stagingAllocation);
+	stbi_image_free(pixels);
 }
 
 void Renderer::CreateTextureImageView()
@@ -462,7 +618,7 @@ void Renderer::CreateTextureSampler()
 
 void Renderer::CreateUniformBuffers()
 {
-	const auto bufferSize = sizeof(MVP);
+	const auto bufferSize = sizeof(CameraUniforms);
 
 	m_uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 	m_uniformAllocations.resize(MAX_FRAMES_IN_FLIGHT);
@@ -490,6 +646,64 @@ void Renderer::CreateUniformBuffers()
 	}
 }
 
+void Renderer::CreateObjectBuffers()
+{
+	m_objectBuffers.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+	m_objectAllocations.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+	m_mappedObjectBuffers.resize(MAX_FRAMES_IN_FLIGHT, nullptr);
+	m_objectCapacities.resize(MAX_FRAMES_IN_FLIGHT, 0);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		ResizeObjectBuffer(i, INITIAL_OBJECT_CAPACITY);
+	}
+}
+
+void Renderer::ResizeObjectBuffer(uint32_t frame, uint32_t capacity)
+{
+	assert(capacity > 0 && "Object buffers can't be empty, the descriptor sets always reference one");
+
+	if (m_objectBuffers[frame] != VK_NULL_HANDLE)
+	{
+		vmaDestroyBuffer(m_pDevice->GetAllocator(), m_objectBuffers[frame], m_objectAllocations[frame]);
+	}
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = sizeof(ObjectData) * capacity;
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VmaAllocationCreateInfo allocCreateInfo{};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	allocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VmaAllocationInfo allocInfo{};
+	if (vmaCreateBuffer(m_pDevice->GetAllocator(), &bufferInfo, &allocCreateInfo, &m_objectBuffers[frame], &m_objectAllocations[frame], &allocInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Memory allocation failed");
+	}
+
+	m_mappedObjectBuffers[frame] = allocInfo.pMappedData;
+	m_objectCapacities[frame] = capacity;
+
+	VkDescriptorBufferInfo descriptorBufferInfo{};
+	descriptorBufferInfo.buffer = m_objectBuffers[frame];
+	descriptorBufferInfo.offset = 0;
+	descriptorBufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_descriptorSets[frame];
+	descriptorWrite.dstBinding = 2;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pBufferInfo = &descriptorBufferInfo;
+
+	vkUpdateDescriptorSets(m_pDevice->GetVkDevice(), 1, &descriptorWrite, 0, nullptr);
+}
+
 void Renderer::CreateSyncObjects()
 {
 	VkSemaphoreTypeCreateInfo timelineCreateInfo{};
@@ -502,6 +716,7 @@ void Renderer::CreateSyncObjects()
 	createInfo.pNext = &timelineCreateInfo;
 
 	vkCreateSemaphore(m_pDevice->GetVkDevice(), &createInfo, nullptr, &m_globalTimelineSemaphore);
+	vkCreateSemaphore(m_pDevice->GetVkDevice(), &createInfo, nullptr, &m_computeTimelineSemaphore);
 
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
@@ -509,13 +724,34 @@ void Renderer::CreateSyncObjects()
 	}
 }
 
+void Renderer::CreateTimestampQueryPool()
+{
+	const auto properties = m_pDevice->GetPhysicalDevice()->GetProperties();
+	const auto& limits = properties.limits;
+
+	// GPU timings are optional, frame statistics simply report 0 when the graphics queue can't write timestamps
+	if (!limits.timestampComputeAndGraphics || limits.timestampPeriod <= 0.f)
+	{
+		return;
+	}
+
+	m_timestampPeriod = limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	createInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2;
+
+	if (vkCreateQueryPool(m_pDevice->GetVkDevice(), &createInfo, nullptr, &m_timestampQueryPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create timestamp query pool");
+	}
+}
+
 void Renderer::CreateDescriptorPool()
 {
-	std::array<VkDescriptorPoolSize, 2> poolSizes{};
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	// Sized exactly for one set per frame in flight of what the shaders declare
+	const std::vector<VkDescriptorPoolSize> poolSizes = m_shaderReflection.GetPoolSizes(MAX_FRAMES_IN_FLIGHT);
 
 	VkDescriptorPoolCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -550,7 +786,7 @@ void Renderer::CreateDescriptorSets()
 		VkDescriptorBufferInfo bufferInfo{};
 		bufferInfo.buffer = m_uniformBuffers[i];
 		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(MVP);
+		bufferInfo.range = sizeof(CameraUniforms);
 
 		VkDescriptorImageInfo imageInfo{};
 		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -626,7 +862,7 @@ void Renderer::ChooseSharingMode()
 {
 	QueueFamilyIndices queueFamilyIndices = m_pDevice->GetPhysicalDevice()->FindQueueFamilies(m_pDevice->GetPhysicalDevice()->GetDevice(), m_pDevice->GetSurface());
 
-	std::set<uint32_t> queueSet = { queueFamilyIndices.m_graphicsFamily.value(), queueFamilyIndices.m_transferFamily.value() };
+	std::set<uint32_t> queueSet = { queueFamilyIndices.m_graphicsFamily.value(), queueFamilyIndices.m_transferFamily.value(), queueFamilyIndices.m_computeFamily.value() };
 	std::vector<uint32_t> uniqueQueueFamilyIndices;
 
 	// Iterator-based loop for practice
@@ -759,39 +995,6 @@ VkImageView Renderer::CreateImageView(VkImage image, VkFormat format, VkImageAsp
 //	vkBindBufferMemory(vkDevice, buffer, bufferMemory, 0);
 //}
 
-void Renderer::CopyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size) const
-{
-	CommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0;
-	copyRegion.dstOffset = 0;
-	copyRegion.size = size;
-	commandBuffer.CopyBuffer(src, dst, 1, &copyRegion);
-
-	EndSingleTimeCommands(commandBuffer);
-}
-
-void Renderer::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) const
-{
-	CommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { width, height, 1 };
-
-	commandBuffer.CopyBufferToImage(buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	EndSingleTimeCommands(commandBuffer);
-}
-
 void Renderer::CreateBuffer(VkDeviceSize size, VkBuffer& buffer, VmaAllocation& allocation, VkBufferUsageFlagBits bufferUsageFlags, VmaMemoryUsage memoryUsageFlags)
 {
 	VkBufferCreateInfo bufferInfo{};
@@ -810,101 +1013,194 @@ void Renderer::CreateBuffer(VkDeviceSize size, VkBuffer& buffer, VmaAllocation&
 template <typename T>
 void Renderer::CreateBufferWithStaging(VkDeviceSize size, VkBuffer& buffer, VmaAllocation& allocation, std::vector<T>& bufferData, VkBufferUsageFlagBits usageFlag)
 {
-	// Create staging buffer
-	VkBuffer stagingBuffer;
-	VmaAllocation stagingAllocation;
-	{
-		/*VkBufferCreateInfo bufferInfo{};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.size = size;
-		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	CreateBufferWithStaging(size, buffer, allocation, static_cast<void*>(bufferData.data()), usageFlag);
+}
 
-		VmaAllocationCreateInfo allocInfo{};
-		allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+void Renderer::CreateBufferWithStaging(VkDeviceSize size, VkBuffer& buffer, VmaAllocation& allocation, void* bufferData, VkBufferUsageFlagBits usageFlag)
+{
+	// Create buffer in device local memory
+	CreateBuffer(size, buffer, allocation, usageFlag, VMA_MEMORY_USAGE_GPU_ONLY);
 
-		vmaCreateBuffer(m_pDevice->GetAllocator(), &bufferInfo, &allocInfo,
-			&stagingBuffer, &stagingAllocation, nullptr);*/
+	m_pUploadManager->UploadBuffer(buffer, bufferData, size);
+}
 
-		CreateBuffer(size, stagingBuffer, stagingAllocation, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+void Renderer::LatchCamera(const glm::mat4& view, const glm::mat4& projection)
+{
+	std::lock_guard<std::mutex> lock(m_latchedCameraMutex);
+	m_latchedView = view;
+	m_latchedProjection = projection;
+	m_hasLatchedCamera = true;
+}
 
-		void* data;
-		vmaMapMemory(m_pDevice->GetAllocator(), stagingAllocation, &data);
-		memcpy(data, bufferData.data(), static_cast<size_t>(size));
-		vmaUnmapMemory(m_pDevice->GetAllocator(), stagingAllocation);
-	}
+void Renderer::ClearLatchedCamera()
+{
+	std::lock_guard<std::mutex> lock(m_latchedCameraMutex);
+	m_hasLatchedCamera = false;
+}
 
-	// Create vertex buffer in device local memory
-	CreateBuffer(size, buffer, allocation, usageFlag, VMA_MEMORY_USAGE_GPU_ONLY);
+void Renderer::UpdateCameraUniforms(const FrameSnapshot& snapshot)
+{
+	CameraUniforms ubo{};
+	ubo.view = snapshot.m_view;
+	ubo.projection = snapshot.m_projection;
 
-	CopyBuffer(stagingBuffer, buffer, size);
+	{
+		std::lock_guard<std::mutex> lock(m_latchedCameraMutex);
+		if (m_hasLatchedCamera)
+		{
+			ubo.view = m_latchedView;
+			ubo.projection = m_latchedProjection;
+		}
+	}
 
-	// Cleanup staging
-	vmaDestroyBuffer(m_pDevice->GetAllocator(), stagingBuffer, stagingAllocation);
+	memcpy(m_mappedUniformBuffers[m_currentFrame], &ubo, sizeof(ubo));
+	// CPU_TO_GPU memory isn't guaranteed to be host coherent, the flush is a no-op when it is
+	vmaFlushAllocation(m_pDevice->GetAllocator(), m_uniformAllocations[m_currentFrame], 0, VK_WHOLE_SIZE);
 }
 
-void Renderer::CreateBufferWithStaging(VkDeviceSize size, VkBuffer& buffer, VmaAllocation& allocation, void* bufferData, VkBufferUsageFlagBits usageFlag)
+void Renderer::ApplyRenderCommands()
 {
-	// Create staging buffer
-	VkBuffer stagingBuffer;
-	VmaAllocation stagingAllocation;
+	m_frameStatistics.m_renderCommandCount = m_pCommandQueue->Consume([this](const RenderCommand& command)
+		{
+			switch (command.m_type)
+			{
+			case RenderCommandType::SPAWN_RENDERABLE:
+				if (command.m_target >= m_retainedRenderables.size())
+				{
+					m_retainedRenderables.resize(command.m_target + 1);
+				}
+				m_retainedRenderables[command.m_target].m_object = { RenderCommand::DecodeModel(command.m_spawn.m_model), glm::unpackUnorm4x8(command.m_spawn.m_color), command.m_spawn.m_mesh };
+				m_retainedRenderables[command.m_target].m_isAlive = true;
+				break;
+			// The queue only accepts ids it handed out, but another thread's spawn may not have been applied yet
+			case RenderCommandType::DESPAWN_RENDERABLE:
+				if (command.m_target < m_retainedRenderables.size())
+				{
+					m_retainedRenderables[command.m_target].m_isAlive = false;
+				}
+				break;
+			case RenderCommandType::UPDATE_TRANSFORM:
+				if (command.m_target < m_retainedRenderables.size())
+				{
+					m_retainedRenderables[command.m_target].m_object.m_model = RenderCommand::DecodeModel(command.m_transform.m_model);
+				}
+				break;
+			case RenderCommandType::SET_COLOR:
+				if (command.m_target < m_retainedRenderables.size())
+				{
+					m_retainedRenderables[command.m_target].m_object.m_color = glm::unpackUnorm4x8(command.m_color.m_color);
+				}
+				break;
+			case RenderCommandType::UPLOAD_MESH:
+				UploadMesh(command.m_target, *command.m_upload.m_pMesh);
+				break;
+			}
+		});
+
+	// Mesh ids can be handed out before their upload command is applied, snapshots may already reference them
+	const uint32_t meshCount = m_pCommandQueue->GetMeshCount();
+	if (meshCount > m_meshes.size())
 	{
-		/*VkBufferCreateInfo bufferInfo{};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.size = size;
-		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		m_meshes.resize(meshCount);
+	}
+}
 
-		VmaAllocationCreateInfo allocInfo{};
-		allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+void Renderer::UploadMesh(uint32_t mesh, const MeshUpload& upload)
+{
+	const uint32_t vertexCount = static_cast<uint32_t>(upload.m_vertices.size());
+	const uint32_t indexCount = static_cast<uint32_t>(upload.m_indices.size());
 
-		vmaCreateBuffer(m_pDevice->GetAllocator(), &bufferInfo, &allocInfo,
-			&stagingBuffer, &stagingAllocation, nullptr);*/
+	// The queue reserved the room when the mesh was queued
+	assert(vertexCount <= m_vertexCapacity - m_vertexCount && indexCount <= m_indexCapacity - m_indexCount && "Uploaded mesh doesn't fit into the shared vertex and index buffers");
 
-		CreateBuffer(size, stagingBuffer, stagingAllocation, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+	// Ranges behind the used ones were never drawn from, frames in flight don't read them
+	m_pUploadManager->UploadBuffer(m_vertexBuffer, upload.m_vertices.data(), sizeof(Vertex) * vertexCount, sizeof(Vertex) * m_vertexCount);
+	m_pUploadManager->UploadBuffer(m_indexBuffer, upload.m_indices.data(), sizeof(uint32_t) * indexCount, sizeof(uint32_t) * m_indexCount);
 
-		void* data;
-		vmaMapMemory(m_pDevice->GetAllocator(), stagingAllocation, &data);
-		memcpy(data, bufferData, static_cast<size_t>(size));
-		vmaUnmapMemory(m_pDevice->GetAllocator(), stagingAllocation);
+	if (mesh >= m_meshes.size())
+	{
+		m_meshes.resize(mesh + 1);
 	}
+	m_meshes[mesh] = { m_indexCount, indexCount, static_cast<int32_t>(m_vertexCount) };
 
-	// Create vertex buffer in device local memory
-	CreateBuffer(size, buffer, allocation, usageFlag, VMA_MEMORY_USAGE_GPU_ONLY);
-
-	CopyBuffer(stagingBuffer, buffer, size);
-
-	// Cleanup staging
-	vmaDestroyBuffer(m_pDevice->GetAllocator(), stagingBuffer, stagingAllocation);
+	m_vertexCount += vertexCount;
+	m_indexCount += indexCount;
 }
 
-void Renderer::UpdateMVP(const int currentImage)
+void Renderer::BuildDraws(const FrameSnapshot& snapshot)
 {
-	assert(currentImage < MAX_FRAMES_IN_FLIGHT && "Current frame value is higher than the amount of frames in flight");
+	const auto& objects = snapshot.m_objects;
+	const uint32_t snapshotObjectCount = static_cast<uint32_t>(objects.size());
+	const uint32_t retainedCount = static_cast<uint32_t>(m_retainedRenderables.size());
 
-	const auto cameraEntity = Core::engine.GetRegistry().view<Transform>().front();
-	auto& cameraTransform = Core::engine.GetRegistry().get<Transform>(cameraEntity);
-	const auto& camera = Core::engine.GetRegistry().get<Camera>(cameraEntity);
+	const auto getObject = [&](uint32_t index) -> const FrameSnapshot::Object&
+		{
+			return index < snapshotObjectCount ? objects[index] : m_retainedRenderables[index - snapshotObjectCount].m_object;
+		};
 
-	Transform transform{};
-	transform.SetTranslation(glm::vec3(1.f, 2.f, 5.f));
+	m_drawList.Clear();
+	for (uint32_t i = 0; i < snapshotObjectCount + retainedCount; i++)
+	{
+		if (i >= snapshotObjectCount && !m_retainedRenderables[i - snapshotObjectCount].m_isAlive)
+		{
+			continue;
+		}
 
-	const glm::vec3 trans = cameraTransform.GetTranslation();
-	const glm::quat rot = cameraTransform.GetRotation();
+		const FrameSnapshot::Object& object = getObject(i);
 
-	const glm::vec3 localForward = glm::vec3(0.f, 0.f, 1.f);
-	const glm::vec3 forward = glm::normalize(glm::rotate(rot, localForward));
+		// Depth along the view direction, the extraction built the view matrix from the same camera
+		const float viewDepth = glm::dot(glm::vec3(object.m_model[3]) - snapshot.m_cameraPosition, snapshot.m_cameraForward);
 
-	const glm::vec3 focusPoint = trans + forward;
-	const glm::vec3 worldUp = glm::vec3(0.f, 1.f, 0.f);
+		// Everything is drawn with the default pipeline and the material's color is instance data,
+		// so their ids stay 0 until there are pipelines and materials that need their own binds
+		const uint64_t key = DrawSortKey::Make(OPAQUE_PASS, 0, 0, object.m_mesh, DrawSortKey::QuantizeDepth(viewDepth));
+		m_drawList.Add(key, i);
+	}
+
+	const uint32_t instanceCount = m_drawList.GetSize();
+	if (instanceCount > m_objectCapacities[m_currentFrame])
+	{
+		ResizeObjectBuffer(m_currentFrame, std::max(instanceCount, m_objectCapacities[m_currentFrame] * 2));
+	}
 
-	MVP ubo{};
-	auto world = glm::rotate(transform.World(), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	ubo.model = glm::rotate(world, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
-	ubo.view = glm::lookAtRH(trans, focusPoint, worldUp);
-	ubo.projection = camera.projection;
+	m_drawList.Sort();
 
-	memcpy(m_mappedUniformBuffers[(currentImage)], &ubo, sizeof(ubo));
+	// Mapped memory is written sequentially and never read back
+	ObjectData* pObjects = static_cast<ObjectData*>(m_mappedObjectBuffers[m_currentFrame]);
+	const auto& entries = m_drawList.GetEntries();
+
+	m_draws.clear();
+	uint64_t batch = UINT64_MAX;
+	for (uint32_t instance = 0; instance < instanceCount; instance++)
+	{
+		const DrawList::Entry& entry = entries[instance];
+		const FrameSnapshot::Object& object = getObject(entry.m_index);
+
+		ObjectData& objectData = pObjects[instance];
+		objectData.model = object.m_model;
+		objectData.color = object.m_color;
+
+		if (DrawSortKey::GetBatch(entry.m_key) != batch)
+		{
+			batch = DrawSortKey::GetBatch(entry.m_key);
+
+			const MeshRange& range = m_meshes[object.m_mesh];
+			m_draws.push_back({ range.m_firstIndex, range.m_indexCount, range.m_vertexOffset, instance, 0 });
+		}
+
+		m_draws.back().m_instanceCount++;
+	}
+
+	// CPU_TO_GPU memory isn't guaranteed to be host coherent, the flush is a no-op when it is
+	if (instanceCount > 0)
+	{
+		vmaFlushAllocation(m_pDevice->GetAllocator(), m_objectAllocations[m_currentFrame], 0, sizeof(ObjectData) * instanceCount);
+	}
+
+	const uint32_t drawCount = static_cast<uint32_t>(m_draws.size());
+	m_frameStatistics.m_instanceCount = instanceCount;
+	m_frameStatistics.m_drawCount = drawCount;
+	m_frameStatistics.m_collapsedDrawCount = instanceCount - drawCount;
 }
 
 VkShaderModule Renderer::CreateShaderModule(const std::vector<char>& code)
@@ -923,7 +1219,7 @@ VkShaderModule Renderer::CreateShaderModule(const std::vector<char>& code)
 	return shaderModule;
 }
 
-void Renderer::RecordCommandBuffer(CommandBuffer commandBuffer, uint32_t imageIndex) const
+void Renderer::RecordCommandBuffer(CommandBuffer commandBuffer, uint32_t imageIndex)
 {
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -932,37 +1228,124 @@ void Renderer::RecordCommandBuffer(CommandBuffer commandBuffer, uint32_t imageIn
 
 	commandBuffer.BeginCommandBuffer(&beginInfo);
 
-	const auto swapchain = m_pDevice->GetSwapchain();
-	const auto& extent = swapchain->GetExtent();
-	const auto& imageViews = swapchain->GetImageViews();
-
-	VkRenderingAttachmentInfo colorAttachment{};
-	colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-	colorAttachment.imageView = imageViews[imageIndex];
-	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.clearValue.color = { 0.f, 0.f, 0.f, 0.f };
-
-	VkRenderingAttachmentInfo depthAttachment{};
-	depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-	depthAttachment.imageView = swapchain->GetDepthView();
-	depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.clearValue.color = { 1.f, 0.f };
-
-	VkRenderingInfo renderInfo{};
-	renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
-	renderInfo.renderArea.offset = { 0, 0 };
-	renderInfo.renderArea.extent = extent;
-	renderInfo.layerCount = 1;
-	renderInfo.colorAttachmentCount = 1;
-	renderInfo.pColorAttachments = &colorAttachment;
-	renderInfo.pDepthAttachment = &depthAttachment;
-
-	commandBuffer.BeginRendering(&renderInfo);
+	m_frameStatistics.m_issuedStateCalls = 0;
+	m_frameStatistics.m_skippedStateCalls = 0;
+
+	const uint32_t firstQuery = m_currentFrame * 2;
+	if (SupportsGpuTimestamps())
+	{
+		commandBuffer.ResetQueryPool(m_timestampQueryPool, firstQuery, 2);
+		commandBuffer.WriteTimestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryPool, firstQuery);
+	}
+
+	const auto renderTarget = m_pDevice->GetRenderTarget();
+	const auto& extent = renderTarget->GetExtent();
+	const bool isHeadless = m_pDevice->IsHeadless();
+
+	m_pRenderGraph->Reset();
+
+	ImportedImageInfo backbufferInfo{};
+	backbufferInfo.m_image = renderTarget->GetImages()[imageIndex];
+	backbufferInfo.m_view = renderTarget->GetImageViews()[imageIndex];
+	backbufferInfo.m_format = renderTarget->GetImageFormat();
+	backbufferInfo.m_extent = extent;
+	// A swapchain image becomes available through the acquire semaphore and is presented after the frame,
+	// offscreen images stay in their attachment layout
+	if (!isHeadless)
+	{
+		backbufferInfo.m_finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		backbufferInfo.m_waitStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+	}
+
+	const RenderGraphImage backbuffer = m_pRenderGraph->ImportImage("Backbuffer", backbufferInfo);
+	const RenderGraphImage depth = m_pRenderGraph->CreateImage("Depth", { extent, m_depthFormat });
+	// The whole allocation, meshes uploaded through render commands live behind the loaded model
+	const RenderGraphBuffer vertexBuffer = m_pRenderGraph->ImportBuffer("Vertices", m_vertexBuffer, sizeof(Vertex) * m_vertexCapacity);
+	const RenderGraphBuffer indexBuffer = m_pRenderGraph->ImportBuffer("Indices", m_indexBuffer, sizeof(uint32_t) * m_indexCapacity);
 
+	const auto pipeline = m_pipeline.Get();
+	const VkFormat colorFormat = renderTarget->GetImageFormat();
+
+	m_pRenderGraph->AddPass("Forward", [&](CommandBuffer& passCommandBuffer)
+		{
+			// Secondaries are recorded before the rendering scope begins, it has to know whether it executes them
+			std::vector<CommandBuffer> secondaryCommandBuffers = RecordDrawsParallel(*pipeline, extent, colorFormat);
+			for (const auto& secondaryCommandBuffer : secondaryCommandBuffers)
+			{
+				m_frameStatistics.m_issuedStateCalls += secondaryCommandBuffer.GetStatistics().m_issuedStateCalls;
+				m_frameStatistics.m_skippedStateCalls += secondaryCommandBuffer.GetStatistics().m_skippedStateCalls;
+			}
+
+			VkRenderingAttachmentInfo colorAttachment{};
+			colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			colorAttachment.imageView = m_pRenderGraph->GetImageView(backbuffer);
+			colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachment.clearValue.color = { 0.f, 0.f, 0.f, 0.f };
+
+			VkRenderingAttachmentInfo depthAttachment{};
+			depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			depthAttachment.imageView = m_pRenderGraph->GetImageView(depth);
+			depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			depthAttachment.clearValue.color = { 1.f, 0.f };
+
+			VkRenderingInfo renderInfo{};
+			renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+			renderInfo.flags = secondaryCommandBuffers.empty() ? 0 : VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+			renderInfo.renderArea.offset = { 0, 0 };
+			renderInfo.renderArea.extent = extent;
+			renderInfo.layerCount = 1;
+			renderInfo.colorAttachmentCount = 1;
+			renderInfo.pColorAttachments = &colorAttachment;
+			renderInfo.pDepthAttachment = &depthAttachment;
+
+			passCommandBuffer.BeginRendering(&renderInfo);
+
+			if (secondaryCommandBuffers.empty())
+			{
+				RecordDraws(passCommandBuffer, *pipeline, extent, 0, static_cast<uint32_t>(m_draws.size()));
+			}
+			else
+			{
+				std::vector<VkCommandBuffer> vkCommandBuffers;
+				vkCommandBuffers.reserve(secondaryCommandBuffers.size());
+				for (auto& secondaryCommandBuffer : secondaryCommandBuffers)
+				{
+					vkCommandBuffers.push_back(*secondaryCommandBuffer.GetVkPtr());
+				}
+
+				passCommandBuffer.ExecuteCommands(vkCommandBuffers.data(), static_cast<uint32_t>(vkCommandBuffers.size()));
+			}
+
+			passCommandBuffer.EndRendering();
+		})
+		.WriteColorAttachment(backbuffer)
+		.WriteDepthAttachment(depth)
+		.ReadBuffer(vertexBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+		.ReadBuffer(indexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+	m_pRenderGraph->Compile();
+
+	// Uploads acquired from the transfer queue are flushed together with the first pass' barriers
+	m_pUploadManager->RecordAcquireBarriers(commandBuffer);
+	m_pRenderGraph->Execute(commandBuffer);
+
+	if (SupportsGpuTimestamps())
+	{
+		commandBuffer.WriteTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampQueryPool, firstQuery + 1);
+	}
+
+	commandBuffer.EndCommandBuffer();
+
+	m_frameStatistics.m_issuedStateCalls += commandBuffer.GetStatistics().m_issuedStateCalls;
+	m_frameStatistics.m_skippedStateCalls += commandBuffer.GetStatistics().m_skippedStateCalls;
+}
+
+void Renderer::RecordDraws(CommandBuffer& commandBuffer, const Pipeline& pipeline, const VkExtent2D& extent, uint32_t firstDraw, uint32_t drawCount) const
+{
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
@@ -977,7 +1360,7 @@ void Renderer::RecordCommandBuffer(CommandBuffer commandBuffer, uint32_t imageIn
 	scissor.extent = extent;
 	commandBuffer.SetScissor(&scissor);
 
-	commandBuffer.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline->Get());
+	commandBuffer.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.Get());
 
 	VkBuffer vertexBuffers[] = { m_vertexBuffer };
 	VkDeviceSize offsets[] = { 0 };
@@ -986,137 +1369,72 @@ void Renderer::RecordCommandBuffer(CommandBuffer commandBuffer, uint32_t imageIn
 
 	const int descriptorSetIndex = m_currentFrame;
 
-	commandBuffer.BindDescriptorSets(m_pipeline->GetLayout(), &m_descriptorSets[descriptorSetIndex]);
-	commandBuffer.DrawIndexed(static_cast<uint32_t>(indices.size()));
+	commandBuffer.BindDescriptorSets(pipeline.GetLayout(), &m_descriptorSets[descriptorSetIndex]);
 
-	commandBuffer.EndRendering();
-	commandBuffer.EndCommandBuffer();
+	for (uint32_t i = firstDraw; i < firstDraw + drawCount; i++)
+	{
+		const DrawRange& draw = m_draws[i];
+		commandBuffer.DrawIndexed(draw.m_indexCount, draw.m_instanceCount, draw.m_firstIndex, draw.m_vertexOffset, draw.m_firstInstance);
+	}
 }
 
-// Port to command buffer class
-const CommandBuffer& Renderer::BeginSingleTimeCommands() const
+std::vector<CommandBuffer> Renderer::RecordDrawsParallel(const Pipeline& pipeline, const VkExtent2D& extent, VkFormat colorFormat)
 {
-	const QueueType type = QueueType::GRAPHICS;
 	const auto queue = m_pDevice->GetQueue();
+	JobSystem& jobSystem = Core::engine.GetJobSystem();
 
-	const auto& commandBuffer = queue->GetOrCreateCommandBuffer(type, m_currentFrame);
-
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	commandBuffer.BeginCommandBuffer(&beginInfo);
-
-	return commandBuffer;
-}
-
-// Port to command buffer class
-void Renderer::EndSingleTimeCommands(CommandBuffer commandBuffer) const
-{
-	commandBuffer.EndCommandBuffer();
-
-	const QueueType type = QueueType::GRAPHICS;
-
-	const auto vkCommandBuffer = commandBuffer.GetVkPtr();
-
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = vkCommandBuffer;
-
-	auto queue = m_pDevice->GetQueue();
-
-	vkQueueSubmit(queue->GetQueue(type), 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(queue->GetQueue(type));
-}
-
-void Renderer::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) const
-{
-	const CommandBuffer& commandBuffer = BeginSingleTimeCommands();
-
-	VkImageMemoryBarrier barrier{};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = oldLayout;
-	barrier.newLayout = newLayout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-
-	VkPipelineStageFlags sourceStage;
-	VkPipelineStageFlags destStage;
-
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+	const uint32_t drawCount = static_cast<uint32_t>(m_draws.size());
+	const uint32_t jobCount = std::min(drawCount / MIN_DRAWS_PER_RECORDING_JOB, queue->GetRecordingThreadCount());
+	if (jobCount < 2)
 	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		return {};
 	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-	{
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
-	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{};
+	inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+	inheritanceRenderingInfo.colorAttachmentCount = 1;
+	inheritanceRenderingInfo.pColorAttachmentFormats = &colorFormat;
+	inheritanceRenderingInfo.depthAttachmentFormat = m_depthFormat;
+	inheritanceRenderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
-	{
-		barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		barrier.dstAccessMask = 0;
-
-		sourceStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		destStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL)
-	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.pNext = &inheritanceRenderingInfo;
 
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	}
-	else
-	{
-		throw std::runtime_error("Unsupported layout transition");
-	}
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-	if (newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL)
-	{
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	// Disjoint ranges, the first (drawCount % jobCount) jobs get one draw more
+	const uint32_t drawsPerJob = drawCount / jobCount;
+	const uint32_t remainder = drawCount % jobCount;
 
-		if (HasStencilComponent(format))
+	const auto recordJob = [&](uint32_t job, uint32_t threadIndex)
 		{
-			barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-		}
-	}
-	else
+			const uint32_t firstDraw = job * drawsPerJob + std::min(job, remainder);
+			const uint32_t jobDrawCount = drawsPerJob + (job < remainder ? 1 : 0);
+
+			CommandBuffer commandBuffer = queue->GetOrCreateSecondaryCommandBuffer(threadIndex, m_currentFrame);
+			commandBuffer.BeginCommandBuffer(&beginInfo);
+			RecordDraws(commandBuffer, pipeline, extent, firstDraw, jobDrawCount);
+			commandBuffer.EndCommandBuffer();
+
+			return commandBuffer;
+		};
+
+	// Each job records with the pool of the thread it runs on. Waiting runs jobs on the render thread too and only
+	// returns once all of them finished, they reference this function's locals.
+	std::vector<CommandBuffer> commandBuffers(jobCount);
+	JobCounter counter;
+	for (uint32_t job = 0; job < jobCount; job++)
 	{
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		jobSystem.Run([&recordJob, &commandBuffers, job]() { commandBuffers[job] = recordJob(job, JobSystem::GetThreadIndex()); }, &counter);
 	}
 
-	commandBuffer.ImageMemoryBarrier(sourceStage, destStage, 1, &barrier);
+	jobSystem.Wait(counter);
 
-	EndSingleTimeCommands(commandBuffer);
-}
-
-bool Renderer::HasStencilComponent(VkFormat format) const
-{
-	return (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT
-		|| format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT);
+	return commandBuffers;
 }
 
 void FrameContext::Init(std::shared_ptr<Device> device)
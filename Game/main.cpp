@@ -5,26 +5,21 @@
 #include "transform.h"
 #include "renderComponents.h"
 
-#undef APIENTRY
-#include <Windows.h>
+#include "fileIO.h"
 
 #include <filesystem>
 #include <iostream>
 #include <cstdlib>
 
-// TODO: Add cross-platform support
 static void SetWorkingDirectory()
 {
-	char buffer[MAX_PATH] = { 0 };
-	GetModuleFileNameA(nullptr, buffer, MAX_PATH);
-
 	// Vulkan\Game\$(platform)\$(config)\game.exe
-	std::filesystem::path executablePath(buffer);
+	std::filesystem::path executablePath = GetExecutablePath();
 
 	// Vulkan\Game
 	auto gameFolderPath = executablePath.parent_path().parent_path().parent_path();
 
-	SetCurrentDirectoryA(gameFolderPath.string().c_str());
+	std::filesystem::current_path(gameFolderPath);
 }
 
 int main() {
@@ -50,12 +45,19 @@ int main() {
 	Transform& cameraTransform = registry.emplace<Transform>(entity);
 	cameraTransform.SetTranslation(glm::vec3(1, 2, 2));
 
+	// The model is Z-up, it's rotated to stand upright in front of the camera
+	auto model = registry.create();
+	registry.emplace<MeshRenderer>(model);
+	Transform& modelTransform = registry.emplace<Transform>(model);
+	modelTransform.SetTranslation(glm::vec3(1, 2, 5));
+	modelTransform.SetRotation(glm::angleAxis(glm::radians(90.f), glm::vec3(0, 1, 0)) * glm::angleAxis(glm::radians(90.f), glm::vec3(-1, 0, 0)));
+
 	try
 	{
 		while (!glfwWindowShouldClose(engine.GetWindow()))
 		{
 			glfwPollEvents();
-			engine.Update(timer.GetDeltaTime(Unit::MILLI)/1000.f);
+			engine.Update(timer.GetDeltaTime(Unit::SECONDS));
 			engine.Render();
 		}
 	}